@@ -3,56 +3,383 @@
 
 #include "pch.h"
 
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <new>
 #include <mutex>
+#include <span>
 #include <thread>
 #include <condition_variable>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 #include "time_utils.h"
 
 namespace common {
 
+    // what a bounded queue does with a new item when it is full
+    enum class FullPolicy {
+        overwrite,  // discard the oldest item
+        drop,       // discard the new item
+        block       // wait a bounded time for the consumer to make room, then discard the new item
+    };
+
+    constexpr std::size_t cache_line_size = 64;
+
+    /*
+        Backs off from spinning to yielding to short sleeps, used by the waiting
+        paths of the lock-free queues only.
+    */
+    class Backoff {
+    public:
+        void pause() {
+            if (count < spin_limit) {
+                ++count;
+            }
+            else if (count < yield_limit) {
+                ++count;
+                std::this_thread::yield();
+            }
+            else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+
+        void reset() {
+            count = 0;
+        }
+
+    private:
+        static constexpr int spin_limit = 64;
+        static constexpr int yield_limit = 256;
+        int count{ 0 };
+    };
+
+    /*
+        Bounded lock-free single producer single consumer ring buffer.
+
+        Producer and consumer each own one index on its own cache line and keep a cached
+        copy of the other side's index, so push and pop only touch the shared index when
+        the cached one says the ring is full or empty. Push and pop never wait, except for
+        push under FullPolicy::block and the pop variants with a timeout.
+
+        Under FullPolicy::block the producer waits at most block_timeout for room and then drops
+        the item. Until the consumer made room again, further items are dropped without waiting,
+        so a stalled consumer costs the producer one timeout and not one per item.
+
+        With FullPolicy::overwrite the producer discards the oldest item by advancing the
+        consumer index. The consumer then claims its index before reading, so the producer
+        never overwrites a slot which is being read; it waits for at most one in flight read.
+    */
     template <typename T>
     class SpScQueue
     {
     public:
-
-        SpScQueue() = default;
+        explicit SpScQueue(
+            std::size_t capacity = 1024, 
+            FullPolicy policy = FullPolicy::block, 
+            std::chrono::milliseconds block_timeout = std::chrono::milliseconds(100)
+        ) : mask(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1)
+          , policy(policy)
+          , block_timeout(block_timeout)
+          , slots(mask + 1)
+        {}
 
         SpScQueue(const SpScQueue&) = delete;
 
         SpScQueue& operator=(const SpScQueue&) = delete;
 
-        void push(const T& item)
+        bool push(const T& item)
         {
-            std::unique_lock<std::mutex> ul(mutex);
-            queue.push(item);
+            return emplace(item);
+        }
+
+        bool push(T&& item)
+        {
+            return emplace(std::move(item));
+        }
+
+        // pushes the items in order, returns how many were accepted
+        std::size_t push(std::span<const T> items)
+        {
+            if (policy != FullPolicy::drop) {
+                std::size_t n = 0;
+                for (const auto& item : items) {
+                    n += push(item) ? 1 : 0;
+                }
+                return n;
+            }
+            auto t = tail.load(std::memory_order_relaxed);
+            auto free = capacity() - (t - cached_head);
+            if (free < items.size()) {
+                cached_head = head.load(std::memory_order_acquire);
+                free = capacity() - (t - cached_head);
+            }
+            auto n = std::min(free, items.size());
+            for (std::size_t i = 0; i < n; ++i) {
+                slots[(t + i) & mask] = items[i];
+            }
+            tail.store(t + n, std::memory_order_release);
+            dropped.fetch_add(items.size() - n, std::memory_order_relaxed);
+            return n;
         }
 
         bool pop(T& item)
         {
-            std::unique_lock<std::mutex> ul(mutex);
-            if (queue.empty()) {
-                return false;
+            return pop(&item, 1) == 1;
+        }
+
+        template<class R, class P>
+        bool pop(T& item, const std::chrono::duration<R, P>& timeout)
+        {
+            auto until = std::chrono::steady_clock::now() + timeout;
+            Backoff backoff;
+            while (!pop(item)) {
+                if (std::chrono::steady_clock::now() >= until) {
+                    return false;
+                }
+                backoff.pause();
             }
-            item = std::move(queue.front());
-            queue.pop();
             return true;
         }
 
+        // moves up to max_items into out, returns how many were popped
+        std::size_t pop(T* out, std::size_t max_items)
+        {
+            auto h = claim();
+            auto n = std::min(available(h, max_items), max_items);
+            if (n == 0) {
+                release(h);
+                return 0;
+            }
+            for (std::size_t i = 0; i < n; ++i) {
+                out[i] = std::move(slots[(h + i) & mask]);
+            }
+            release(h + n);
+            return n;
+        }
+
+        std::size_t pop(std::span<T> out)
+        {
+            return pop(out.data(), out.size());
+        }
+
+        template<class Op, class R, class P>
+        bool pop_until(Op op, const std::chrono::duration<R, P>& timeout)
+        {
+            auto until = std::chrono::steady_clock::now() + timeout;
+            Backoff backoff;
+            auto done = false;
+            while (!done) {
+                Batch batch;
+                if (pop_construct(batch, 1) == 0) {
+                    if (std::chrono::steady_clock::now() >= until) {
+                        return false;
+                    }
+                    backoff.pause();
+                    continue;
+                }
+                backoff.reset();
+                done = op(batch.items()[0]);
+            }
+            return true;
+        }
+
+        // pops what is available now, the callback runs on moved out items and never delays the producer
+        template<class Op>
+        int pop_all(Op op)
+        {
+            auto n = 0;
+            std::size_t popped;
+            do {
+                Batch batch;
+                popped = pop_construct(batch, batch_size);
+                for (std::size_t i = 0; i < popped; ++i) {
+                    op(batch.items()[i]);
+                }
+                n += (int)popped;
+            } while (popped == batch_size);
+            return n;
+        }
+
+        // keeps only the most recent item
         bool pop_until_last(T& item)
         {
-            std::unique_lock<std::mutex> ul(mutex);
-            if (queue.empty()) {
+            auto h = claim();
+            auto n = available(h, capacity());
+            if (n == 0) {
+                release(h);
                 return false;
             }
-            item = std::move(queue.back());
-            queue.clear();
+            item = std::move(slots[(h + n - 1) & mask]);
+            release(h + n);
             return true;
         }
 
+        std::size_t size() const
+        {
+            auto h = head.load(std::memory_order_acquire) & ~reading;
+            return tail.load(std::memory_order_acquire) - h;
+        }
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        std::size_t capacity() const
+        {
+            return mask + 1;
+        }
+
+        FullPolicy full_policy() const
+        {
+            return policy;
+        }
+
+        // items discarded by the full policy, including the ones given up on under block
+        uint64_t num_dropped() const
+        {
+            return dropped.load(std::memory_order_relaxed);
+        }
+
     private:
-        std::queue<T> queue;
-        std::mutex mutex;
+        static constexpr std::size_t batch_size = 16;
+
+        // flags the consumer index while a read is in flight, indices never get near the top bit
+        static constexpr uint64_t reading = uint64_t(1) << 63;
+
+        // uninitialized storage the popped items are move constructed into, so T needs no default constructor
+        struct Batch {
+            alignas(T) std::byte storage[batch_size * sizeof(T)];
+            std::size_t size{ 0 };
+
+            Batch() = default;
+
+            Batch(const Batch&) = delete;
+
+            Batch& operator=(const Batch&) = delete;
+
+            ~Batch() {
+                std::destroy_n(items(), size);
+            }
+
+            T* items() {
+                return std::launder(reinterpret_cast<T*>(storage));
+            }
+        };
+
+        std::size_t pop_construct(Batch& batch, std::size_t max_items)
+        {
+            auto h = claim();
+            auto n = std::min(available(h, max_items), max_items);
+            auto out = reinterpret_cast<T*>(batch.storage);
+            for (std::size_t i = 0; i < n; ++i) {
+                new (out + i) T(std::move(slots[(h + i) & mask]));
+                ++batch.size;
+            }
+            release(h + n);
+            return n;
+        }
+
+        template<class U>
+        bool emplace(U&& item)
+        {
+            auto t = tail.load(std::memory_order_relaxed);
+            if (t - cached_head == capacity()) {
+                cached_head = head.load(std::memory_order_acquire) & ~reading;
+                if (t - cached_head == capacity() && !make_room(t)) {
+                    return false;
+                }
+            }
+            slots[t & mask] = std::forward<U>(item);
+            tail.store(t + 1, std::memory_order_release);
+            overflowing = false;
+            return true;
+        }
+
+        // called by the producer with a full ring, returns false if the new item is dropped
+        bool make_room(uint64_t t)
+        {
+            Backoff backoff;
+            switch (policy) {
+            case FullPolicy::drop:
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+
+            case FullPolicy::block: {
+                auto until = std::chrono::steady_clock::now() + block_timeout;
+                while (t - cached_head == capacity()) {
+                    if (overflowing || std::chrono::steady_clock::now() >= until) {
+                        overflowing = true;
+                        dropped.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    backoff.pause();
+                    cached_head = head.load(std::memory_order_acquire) & ~reading;
+                }
+                return true;
+            }
+
+            case FullPolicy::overwrite:
+                while (true) {
+                    auto h = head.load(std::memory_order_acquire);
+                    if ((h & ~reading) != t - capacity()) {
+                        cached_head = h & ~reading;
+                        return true;
+                    }
+                    if ((h & reading) == 0 && head.compare_exchange_weak(h, h + 1, std::memory_order_acq_rel)) {
+                        cached_head = h + 1;
+                        dropped.fetch_add(1, std::memory_order_relaxed);
+                        return true;
+                    }
+                    backoff.pause();
+                }
+            }
+            return false;
+        }
+
+        // consumer index at which reading starts, flagged as in flight if the producer may overwrite
+        uint64_t claim()
+        {
+            auto h = head.load(std::memory_order_relaxed);
+            if (policy == FullPolicy::overwrite) {
+                while (!head.compare_exchange_weak(h, h | reading, std::memory_order_acquire)) {}
+            }
+            return h;
+        }
+
+        void release(uint64_t h)
+        {
+            head.store(h, std::memory_order_release);
+        }
+
+        // refreshes the cached producer index only if it shows fewer items than wanted
+        std::size_t available(uint64_t h, std::size_t wanted)
+        {
+            if (cached_tail - h < wanted || policy == FullPolicy::overwrite) {
+                cached_tail = tail.load(std::memory_order_acquire);
+            }
+            return cached_tail - h;
+        }
+
+        // read only after construction
+        const std::size_t mask;
+        const FullPolicy policy;
+        const std::chrono::milliseconds block_timeout;
+        std::vector<T> slots;
+
+        // written by the consumer
+        alignas(cache_line_size) std::atomic<uint64_t> head{ 0 };
+        uint64_t cached_tail{ 0 };
+
+        // written by the producer
+        alignas(cache_line_size) std::atomic<uint64_t> tail{ 0 };
+        uint64_t cached_head{ 0 };
+        bool overflowing{ false };
+        std::atomic<uint64_t> dropped{ 0 };
     };
 
 
@@ -111,16 +438,37 @@ namespace common {
         std::condition_variable cond;
     };
 
+    // how a consumer waits for items of a BlockingTimeoutQueue
+    enum class WaitStrategy {
+        condition_variable,  // park right away, lowest cpu usage
+        spin_then_park,      // spin briefly before parking, for request response round trips
+        busy_spin            // never park, producers never notify, burns a core while waiting
+    };
+
+    inline void cpu_relax()
+    {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
     /*
         Inspired from this
 
             https://codereview.stackexchange.com/questions/39199/multi-producer-consumer-queue-without-boost-in-c11
 
+        Producers append to a pending buffer under the lock. Consumers swap the whole pending
+        buffer into their drain buffer and process it outside of the producer lock, so callbacks
+        never block the producers. Producers only notify if a consumer is parked.
     */
     template<typename T>
     class BlockingTimeoutQueue {
     public:
-        BlockingTimeoutQueue() = default;
+        explicit BlockingTimeoutQueue(WaitStrategy wait_strategy = WaitStrategy::condition_variable)
+            : wait_strategy(wait_strategy)
+        {}
 
         BlockingTimeoutQueue(const BlockingTimeoutQueue&) = delete;
 
@@ -130,71 +478,155 @@ namespace common {
 
         void push(const T& item)
         {
-            std::unique_lock<std::mutex> ul(mutex);
-            queue.push(item);
-            pushed_cond.notify_all();
+            emplace(item);
+        }
+
+        void push(T&& item)
+        {
+            emplace(std::move(item));
         }
 
         bool pop(T& item)
         {
-            std::unique_lock<std::mutex> ul(mutex);
-            if (queue.empty()) {
+            std::unique_lock<std::mutex> cl(consumer_mutex);
+            if (!refill()) {
                 return false;
             }
-            item = std::move(queue.front());
-            queue.pop();
+            item = std::move(drained[next++]);
             return true;
         }
 
         template<class R, class P>
         bool pop(T& item, const std::chrono::duration<R, P>& timeout)
         {
-            std::unique_lock<std::mutex> ul(mutex);
-            if (queue.empty()) {
-                if (!pushed_cond.wait_for(ul, timeout, [this]() { return !this->queue.empty(); })) {
-                    return false;
-                }
+            std::unique_lock<std::mutex> cl(consumer_mutex);
+            if (!wait_until(std::chrono::steady_clock::now() + timeout)) {
+                return false;
             }
-            item = std::move(queue.front());
-            queue.pop();
+            item = std::move(drained[next++]);
             return true;
         }
 
         template<class Op, class R, class P>
         bool pop_until(Op op, const std::chrono::duration<R, P>& timeout)
         {
-            std::unique_lock<std::mutex> ul(mutex);
-            auto now = std::chrono::steady_clock::now();
-            auto until = now + timeout;
+            std::unique_lock<std::mutex> cl(consumer_mutex);
+            auto until = std::chrono::steady_clock::now() + timeout;
             auto done = false;
             while (!done) {
-                if (queue.empty()) {
-                    if (!pushed_cond.wait_until(ul, until, [this]() { return !this->queue.empty(); })) {
-                        return false;
-                    }
+                if (!wait_until(until)) {
+                    return false;
                 }
-                done = op(queue.front());
-                queue.pop();
+                done = op(drained[next++]);
             }
             return true;
         }
 
+        // drains everything pending with a single swap, the callback runs outside of the producer lock
         template<class Op>
-        int pop_all(Op op) {
-           std::unique_lock<std::mutex> ul(mutex);
-           auto n = 0;
-           while (!queue.empty()) {
-              op(queue.front());
-              queue.pop();
-              ++n;
-           }
-           return n;
+        int pop_all(Op op)
+        {
+            std::unique_lock<std::mutex> cl(consumer_mutex);
+            auto n = 0;
+            // a second pass picks up what was left from a previous pop and pushed meanwhile
+            for (int pass = 0; pass < 2 && refill(); ++pass) {
+                while (next < drained.size()) {
+                    op(drained[next++]);
+                    ++n;
+                }
+            }
+            return n;
+        }
+
+        // items pushed but not yet drained by a consumer
+        std::size_t size() const
+        {
+            return pending_size.load(std::memory_order_relaxed);
         }
 
     private:
-        std::queue<T> queue;
+        static constexpr unsigned spin_limit = 4096;
+
+        template<class U>
+        void emplace(U&& item)
+        {
+            bool notify;
+            {
+                std::lock_guard<std::mutex> ul(mutex);
+                pending.push_back(std::forward<U>(item));
+                pending_size.store(pending.size(), std::memory_order_release);
+                notify = parked > 0;
+            }
+            if (notify) {
+                pushed_cond.notify_one();
+            }
+        }
+
+        // called with the consumer lock, true if the drain buffer has items
+        bool refill()
+        {
+            if (next < drained.size()) {
+                return true;
+            }
+            if (pending_size.load(std::memory_order_acquire) == 0) {
+                return false;
+            }
+            std::lock_guard<std::mutex> ul(mutex);
+            swap_pending();
+            return !drained.empty();
+        }
+
+        // called with both locks
+        void swap_pending()
+        {
+            drained.clear();
+            next = 0;
+            std::swap(pending, drained);
+            pending_size.store(0, std::memory_order_relaxed);
+        }
+
+        template<class Clock, class Duration>
+        bool wait_until(const std::chrono::time_point<Clock, Duration>& until)
+        {
+            if (refill()) {
+                return true;
+            }
+
+            if (wait_strategy != WaitStrategy::condition_variable) {
+                for (unsigned i = 0; wait_strategy == WaitStrategy::busy_spin || i < spin_limit; ++i) {
+                    if (refill()) {
+                        return true;
+                    }
+                    if ((i & 63) == 0 && Clock::now() >= until) {
+                        return false;
+                    }
+                    cpu_relax();
+                }
+            }
+
+            std::unique_lock<std::mutex> ul(mutex);
+            ++parked;
+            auto ready = pushed_cond.wait_until(ul, until, [this]() { return !this->pending.empty(); });
+            --parked;
+            if (ready) {
+                swap_pending();
+            }
+            return ready;
+        }
+
+        WaitStrategy wait_strategy;
+
+        // producer side, guarded by mutex
         std::mutex mutex;
         std::condition_variable pushed_cond;
+        std::vector<T> pending;
+        int parked{ 0 };
+        std::atomic<std::size_t> pending_size{ 0 };
+
+        // consumer side, guarded by consumer_mutex
+        std::mutex consumer_mutex;
+        std::vector<T> drained;
+        std::size_t next{ 0 };
     };
 
 
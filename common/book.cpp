@@ -9,25 +9,25 @@ namespace common {
     using namespace std::chrono_literals;
 
     Book::Book()
-        : bids([](const double& x, const double& y) -> bool { return x > y; })
-        , asks([](const double& x, const double& y) -> bool { return x < y; })
-        , precision(TO_POINTS)
+        : bids([](const Price& x, const Price& y) -> bool { return x > y; })
+        , asks([](const Price& x, const Price& y) -> bool { return x < y; })
+        , price_scale(TO_POINTS)
     {}
 
     void Book::set_precision(uint32_t prec) {
-        precision = prec;
+        price_scale = PriceScale(prec);
     }
 
     int32_t Book::get_precision() const {
-       return precision;
+       return static_cast<int32_t>(price_scale.get_tick_scale());
     }
 
-    uint32_t Book::scale(double price) const {
-        return uint32_t(price * precision);
+    Price Book::scale(double price) const {
+        return price_scale.to_price(price);
     }
 
-    double Book::unscale(uint32_t price) const {
-        return price / double(precision);
+    double Book::unscale(const Price& price) const {
+        return price_scale.to_double(price);
     }
 
     void Book::set_timestamp(const std::chrono::nanoseconds& t) {
@@ -115,14 +115,16 @@ namespace common {
         double volume = 0;
         if (is_bid) {
             if (bids.empty()) return 0;
-            for (auto it = bids.begin(); it->first >= price_level && it != bids.end(); ++it) {
+            auto level = scale(price_level);
+            for (auto it = bids.begin(); it != bids.end() && it->first >= level; ++it) {
                 weighted_price += unscale(it->first) * it->second;
                 volume += it->second;
             }
         }
         else {
             if (asks.empty()) return 0;
-            for (auto it = asks.begin(); it->first <= price_level && it != asks.end(); ++it) {
+            auto level = scale(price_level);
+            for (auto it = asks.begin(); it != asks.end() && it->first <= level; ++it) {
                 weighted_price += unscale(it->first) * it->second;
                 volume += it->second;
             }
@@ -38,20 +38,20 @@ namespace common {
 
 		bool is_crossing() const;
 
-		uint32_t scale(double price) const;
+		Price scale(double price) const;
 
-		double unscale(uint32_t price) const;
+		double unscale(const Price& price) const;
 
 		std::string to_string(int levels=1, const std::string& pre="") const;
 
 	protected:
-		typedef std::map<uint32_t, double, std::function<bool(const uint32_t&, const uint32_t&)>> order_book_snapshot_t;
+		typedef std::map<Price, double, std::function<bool(const Price&, const Price&)>> order_book_snapshot_t;
 
 		std::chrono::nanoseconds timestamp{};
 		bool initialized{ false };
 		order_book_snapshot_t bids;
 		order_book_snapshot_t asks;
-		uint32_t precision{ TO_POINTS };
+		PriceScale price_scale{};
 	};
 
 }
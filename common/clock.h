@@ -0,0 +1,119 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "pch.h"
+
+#include <atomic>
+
+#include "time_utils.h"
+
+namespace common {
+
+	/*
+	 * Source of the simulation time in nanoseconds since the unix epoch. The market simulation,
+	 * bars, fills and FIX timestamps all read the time from the same clock so that the simulator
+	 * can run in wall clock time, accelerated or as fast as possible.
+	 */
+	class Clock {
+	public:
+		virtual ~Clock() = default;
+
+		virtual std::chrono::nanoseconds now() const = 0;
+
+		// wall clock time it takes for the clock to advance by the given duration
+		virtual std::chrono::nanoseconds to_wall_duration(const std::chrono::nanoseconds& duration) const = 0;
+
+		// event driven clocks do not advance by themselves, the scheduler moves them to the next due event
+		virtual bool is_event_driven() const {
+			return false;
+		}
+
+		virtual void advance_to(const std::chrono::nanoseconds& time) {}
+	};
+
+	class SystemClock : public Clock {
+	public:
+		std::chrono::nanoseconds now() const override {
+			return get_current_system_clock();
+		}
+
+		std::chrono::nanoseconds to_wall_duration(const std::chrono::nanoseconds& duration) const override {
+			return duration;
+		}
+	};
+
+	// starts at origin and runs speed times faster than the wall clock
+	class AcceleratedClock : public Clock {
+	public:
+		AcceleratedClock(const std::chrono::nanoseconds& origin, double speed)
+			: origin(origin)
+			, speed(speed)
+			, start(std::chrono::steady_clock::now())
+		{
+			if (speed <= 0) {
+				throw std::runtime_error(std::format("AcceleratedClock: invalid speed {}", speed));
+			}
+		}
+
+		std::chrono::nanoseconds now() const override {
+			auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+			return origin + std::chrono::nanoseconds((int64_t)((double)elapsed.count() * speed));
+		}
+
+		std::chrono::nanoseconds to_wall_duration(const std::chrono::nanoseconds& duration) const override {
+			return std::chrono::nanoseconds((int64_t)((double)duration.count() / speed));
+		}
+
+	private:
+		std::chrono::nanoseconds origin;
+		double speed;
+		std::chrono::steady_clock::time_point start;
+	};
+
+	// virtual time which jumps from event to event, the simulation runs as fast as possible
+	class VirtualClock : public Clock {
+	public:
+		explicit VirtualClock(const std::chrono::nanoseconds& origin)
+			: time(origin.count())
+		{}
+
+		std::chrono::nanoseconds now() const override {
+			return std::chrono::nanoseconds(time.load(std::memory_order_acquire));
+		}
+
+		std::chrono::nanoseconds to_wall_duration(const std::chrono::nanoseconds& duration) const override {
+			return std::chrono::nanoseconds(0);
+		}
+
+		bool is_event_driven() const override {
+			return true;
+		}
+
+		// time never goes backwards
+		void advance_to(const std::chrono::nanoseconds& t) override {
+			auto current = time.load(std::memory_order_relaxed);
+			while (current < t.count() && !time.compare_exchange_weak(current, t.count(), std::memory_order_acq_rel)) {}
+		}
+
+	private:
+		std::atomic<int64_t> time;
+	};
+
+	// creates the clock for mode "system", "accelerated" or "virtual"
+	inline std::shared_ptr<Clock> clock_factory(const std::string& mode, const std::chrono::nanoseconds& origin, double speed) {
+		if (mode == "system") {
+			return std::make_shared<SystemClock>();
+		}
+		else if (mode == "accelerated") {
+			return std::make_shared<AcceleratedClock>(origin, speed);
+		}
+		else if (mode == "virtual") {
+			return std::make_shared<VirtualClock>(origin);
+		}
+		else {
+			throw std::runtime_error(std::format("clock_factory: unknown clock mode {}", mode));
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,458 @@
+#pragma once
+
+#include <map>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <format>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bar_builder.h"
+
+namespace common {
+
+	static_assert(std::endian::native == std::endian::little, "columnar format assumes a little endian host");
+
+	/*
+	 * Binary columnar wire format for bar and tick responses, an alternative to the JSON arrays of
+	 * to_json with the same column names. A client asks for it with the Accept header or the query
+	 * parameter format=binary, the response content type tells which format was sent.
+	 *
+	 * Layout, all integers little endian:
+	 *   magic "ZCOL" | uint16 version | uint16 number of columns | uint64 number of rows
+	 *   per column: uint8 type | uint8 name length | name
+	 *   zero padding to a multiple of 8 bytes
+	 *   the columns one after the other, each rows * 8 bytes of float64 or int64
+	 *
+	 * A response body is a sequence of one or more such messages, so that a large result can be
+	 * streamed in chunks of rows. Decoders append the rows of all messages.
+	 */
+	namespace columnar {
+
+		constexpr std::string_view content_type = "application/x-zorro-columnar";
+		constexpr char magic[4] = { 'Z', 'C', 'O', 'L' };
+		constexpr uint16_t version = 1;
+
+		enum class ColumnType : uint8_t {
+			float64 = 0,
+			int64 = 1
+		};
+
+		template<typename T>
+		constexpr ColumnType column_type_of() {
+			static_assert(std::is_same_v<T, double> || std::is_same_v<T, int64_t>, "columns are float64 or int64");
+			return std::is_same_v<T, double> ? ColumnType::float64 : ColumnType::int64;
+		}
+
+		// true if the client asked for the columnar format, with format=binary or in the Accept header
+		inline bool is_requested(std::string_view format_param, std::string_view accept_header) {
+			return format_param == "binary" || accept_header.find(content_type) != std::string_view::npos;
+		}
+
+		inline bool is_columnar(std::string_view response_content_type) {
+			return response_content_type.starts_with(content_type);
+		}
+
+		/*
+		 * Builds a columnar message, declare all columns with add before writing their values with
+		 * the column index returned by add.
+		 */
+		class Writer {
+		public:
+			explicit Writer(size_t rows)
+				: rows(rows)
+			{}
+
+			template<typename T>
+			size_t add(std::string_view name) {
+				if (name.size() > 255) {
+					throw std::runtime_error(std::format("columnar::Writer: column name {} too long", name));
+				}
+				columns.push_back(Column{ std::string(name), column_type_of<T>() });
+				return columns.size() - 1;
+			}
+
+			// allocates the message, must be called after the last add
+			void start() {
+				std::string header(magic, sizeof(magic));
+				append(header, version);
+				append(header, static_cast<uint16_t>(columns.size()));
+				append(header, static_cast<uint64_t>(rows));
+				for (const auto& column : columns) {
+					header.push_back(static_cast<char>(column.type));
+					header.push_back(static_cast<char>(column.name.size()));
+					header.append(column.name);
+				}
+				header.resize((header.size() + 7) & ~size_t(7), '\0');
+				data_offset = header.size();
+				buffer = std::move(header);
+				buffer.resize(data_offset + columns.size() * rows * 8, '\0');
+			}
+
+			template<typename T>
+			void set(size_t column, size_t row, T value) {
+				std::memcpy(buffer.data() + data_offset + (column * rows + row) * 8, &value, 8);
+			}
+
+			std::string release() {
+				return std::move(buffer);
+			}
+
+		private:
+			struct Column {
+				std::string name;
+				ColumnType type;
+			};
+
+			template<typename T>
+			static void append(std::string& s, T value) {
+				s.append(reinterpret_cast<const char*>(&value), sizeof(value));
+			}
+
+			size_t rows;
+			std::vector<Column> columns;
+			size_t data_offset{ 0 };
+			std::string buffer;
+		};
+
+		// typed view of one column in the message buffer, reads unaligned values in place
+		template<typename T>
+		class ColumnView {
+		public:
+			ColumnView(const char* data = nullptr, size_t rows = 0)
+				: data(data)
+				, rows(rows)
+			{}
+
+			size_t size() const {
+				return rows;
+			}
+
+			T operator[](size_t row) const {
+				T value;
+				std::memcpy(&value, data + row * 8, 8);
+				return value;
+			}
+
+		private:
+			const char* data;
+			size_t rows;
+		};
+
+		/*
+		 * Zero copy decoder, validates the header and gives access to the columns in place. The
+		 * message buffer must outlive the view.
+		 */
+		class View {
+		public:
+			explicit View(std::string_view message) {
+				size_t pos = 0;
+				auto read = [&](void* target, size_t n) {
+					if (pos + n > message.size()) {
+						throw std::runtime_error("columnar::View: truncated header");
+					}
+					std::memcpy(target, message.data() + pos, n);
+					pos += n;
+				};
+				char message_magic[sizeof(magic)];
+				uint16_t message_version, num_columns;
+				uint64_t num_rows;
+				read(message_magic, sizeof(message_magic));
+				read(&message_version, sizeof(message_version));
+				if (std::memcmp(message_magic, magic, sizeof(magic)) != 0 || message_version != version) {
+					throw std::runtime_error("columnar::View: not a columnar message or unsupported version");
+				}
+				read(&num_columns, sizeof(num_columns));
+				read(&num_rows, sizeof(num_rows));
+				for (uint16_t i = 0; i < num_columns; ++i) {
+					uint8_t type, length;
+					read(&type, 1);
+					read(&length, 1);
+					if (pos + length > message.size()) {
+						throw std::runtime_error("columnar::View: truncated header");
+					}
+					columns.push_back(Column{ message.substr(pos, length), static_cast<ColumnType>(type) });
+					pos += length;
+				}
+				pos = (pos + 7) & ~size_t(7);
+				if (pos > message.size() || (message.size() - pos) / 8 / std::max<size_t>(num_columns, 1) < num_rows) {
+					throw std::runtime_error(std::format("columnar::View: message too short for {} rows", num_rows));
+				}
+				rows = static_cast<size_t>(num_rows);
+				for (size_t i = 0; i < columns.size(); ++i) {
+					columns[i].data = message.data() + pos + i * rows * 8;
+				}
+				length = pos + columns.size() * rows * 8;
+			}
+
+			size_t size() const {
+				return rows;
+			}
+
+			// number of bytes of the message, a body with several messages continues after it
+			size_t bytes() const {
+				return length;
+			}
+
+			bool has(std::string_view name) const {
+				return find(name) != nullptr;
+			}
+
+			// throws if the column is missing or of another type
+			template<typename T>
+			ColumnView<T> column(std::string_view name) const {
+				auto column = find(name);
+				if (column == nullptr || column->type != column_type_of<T>()) {
+					throw std::runtime_error(std::format("columnar::View: no {} column {}", std::is_same_v<T, double> ? "float64" : "int64", name));
+				}
+				return ColumnView<T>(column->data, rows);
+			}
+
+		private:
+			struct Column {
+				std::string_view name;
+				ColumnType type;
+				const char* data{ nullptr };
+			};
+
+			const Column* find(std::string_view name) const {
+				for (const auto& column : columns) {
+					if (column.name == name)
+						return &column;
+				}
+				return nullptr;
+			}
+
+			std::vector<Column> columns;
+			size_t rows{ 0 };
+			size_t length{ 0 };
+		};
+
+		/*
+		 * Size of the first message in buffer as far as can be told from its header, zero if the
+		 * header is not complete yet. Throws if buffer does not start with a columnar message.
+		 */
+		inline size_t message_size(std::string_view buffer) {
+			constexpr size_t fixed = sizeof(magic) + 2 * sizeof(uint16_t) + sizeof(uint64_t);
+			if (buffer.size() < fixed) {
+				return 0;
+			}
+			if (std::memcmp(buffer.data(), magic, sizeof(magic)) != 0) {
+				throw std::runtime_error("columnar::message_size: not a columnar message");
+			}
+			uint16_t num_columns;
+			uint64_t num_rows;
+			std::memcpy(&num_columns, buffer.data() + sizeof(magic) + sizeof(uint16_t), sizeof(num_columns));
+			std::memcpy(&num_rows, buffer.data() + sizeof(magic) + 2 * sizeof(uint16_t), sizeof(num_rows));
+			size_t pos = fixed;
+			for (uint16_t i = 0; i < num_columns; ++i) {
+				if (pos + 2 > buffer.size()) {
+					return 0;
+				}
+				pos += 2 + static_cast<uint8_t>(buffer[pos + 1]);
+			}
+			pos = (pos + 7) & ~size_t(7);
+			return pos + num_columns * num_rows * 8;
+		}
+
+		// calls op with the view of each message of a complete body
+		template<typename Op>
+		void for_each_message(std::string_view body, Op op) {
+			while (!body.empty()) {
+				View view(body);
+				op(view);
+				body.remove_prefix(view.bytes());
+			}
+		}
+
+		/*
+		 * Incremental decoder for a body received in arbitrary pieces, e.g. a chunked response.
+		 * Only the bytes of the message in progress are buffered.
+		 */
+		class StreamDecoder {
+		public:
+			// calls op with the view of every message completed by the data
+			template<typename Op>
+			void feed(const char* data, size_t size, Op op) {
+				pending.append(data, size);
+				size_t consumed = 0;
+				while (true) {
+					std::string_view rest(pending.data() + consumed, pending.size() - consumed);
+					auto n = message_size(rest);
+					if (n == 0 || n > rest.size()) {
+						break;
+					}
+					View view(rest.substr(0, n));
+					op(view);
+					consumed += n;
+				}
+				pending.erase(0, consumed);
+			}
+
+			// true if no partial message is left over
+			bool complete() const {
+				return pending.empty();
+			}
+
+		private:
+			std::string pending;
+		};
+	}
+
+	inline std::pair<std::string, int> to_columnar(
+		const std::chrono::nanoseconds& from,
+		const std::chrono::nanoseconds& to,
+		const std::map<std::chrono::nanoseconds, Bar>& bars
+	) {
+		std::vector<const Bar*> selected;
+		for (const auto& [key, bar] : bars) {
+			if (from <= bar.end && bar.end <= to) {
+				selected.push_back(&bar);
+			}
+		}
+		auto n = selected.size();
+
+		columnar::Writer writer(n);
+		auto end = writer.add<int64_t>("end");
+		auto open = writer.add<double>("open");
+		auto high = writer.add<double>("high");
+		auto low = writer.add<double>("low");
+		auto close = writer.add<double>("close");
+		writer.start();
+
+		for (size_t row = 0; row < n; ++row) {
+			const auto& bar = *selected[row];
+			writer.set<int64_t>(end, row, bar.end.count());
+			writer.set(open, row, bar.open);
+			writer.set(high, row, bar.high);
+			writer.set(low, row, bar.low);
+			writer.set(close, row, bar.close);
+		}
+
+		return std::make_pair(writer.release(), static_cast<int>(n));
+	}
+
+	inline std::string to_columnar(const std::vector<BidAskBar<double>>& bars) {
+		columnar::Writer writer(bars.size());
+		auto timestamp = writer.add<double>("timestamp");
+		auto bid_open = writer.add<double>("bid_open");
+		auto bid_high = writer.add<double>("bid_high");
+		auto bid_low = writer.add<double>("bid_low");
+		auto bid_close = writer.add<double>("bid_close");
+		auto ask_open = writer.add<double>("ask_open");
+		auto ask_high = writer.add<double>("ask_high");
+		auto ask_low = writer.add<double>("ask_low");
+		auto ask_close = writer.add<double>("ask_close");
+		auto volume = writer.add<double>("volume");
+		writer.start();
+
+		for (size_t row = 0; row < bars.size(); ++row) {
+			const auto& bar = bars[row];
+			writer.set(timestamp, row, bar.timestamp);
+			writer.set(bid_open, row, bar.bid_open);
+			writer.set(bid_high, row, bar.bid_high);
+			writer.set(bid_low, row, bar.bid_low);
+			writer.set(bid_close, row, bar.bid_close);
+			writer.set(ask_open, row, bar.ask_open);
+			writer.set(ask_high, row, bar.ask_high);
+			writer.set(ask_low, row, bar.ask_low);
+			writer.set(ask_close, row, bar.ask_close);
+			writer.set(volume, row, bar.volume);
+		}
+
+		return writer.release();
+	}
+
+	inline std::string to_columnar(const std::vector<Quote<double>>& quotes) {
+		columnar::Writer writer(quotes.size());
+		auto timestamp = writer.add<double>("timestamp");
+		auto bid = writer.add<double>("bid");
+		auto ask = writer.add<double>("ask");
+		writer.start();
+
+		for (size_t row = 0; row < quotes.size(); ++row) {
+			writer.set(timestamp, row, quotes[row].timestamp);
+			writer.set(bid, row, quotes[row].bid);
+			writer.set(ask, row, quotes[row].ask);
+		}
+
+		return writer.release();
+	}
+
+	inline void append_columnar(const columnar::View& view, std::map<std::chrono::nanoseconds, Bar>& bars) {
+		auto end = view.column<int64_t>("end");
+		auto open = view.column<double>("open");
+		auto high = view.column<double>("high");
+		auto low = view.column<double>("low");
+		auto close = view.column<double>("close");
+
+		for (size_t i = 0; i < view.size(); ++i) {
+			bars.try_emplace(
+				bars.end(),
+				std::chrono::nanoseconds(end[i]),
+				std::chrono::nanoseconds(end[i]),
+				open[i],
+				high[i],
+				low[i],
+				close[i]
+			);
+		}
+	}
+
+	inline void append_columnar(const columnar::View& view, std::vector<BidAskBar<double>>& bars) {
+		auto timestamp = view.column<double>("timestamp");
+		auto bid_open = view.column<double>("bid_open");
+		auto bid_high = view.column<double>("bid_high");
+		auto bid_low = view.column<double>("bid_low");
+		auto bid_close = view.column<double>("bid_close");
+		auto ask_open = view.column<double>("ask_open");
+		auto ask_high = view.column<double>("ask_high");
+		auto ask_low = view.column<double>("ask_low");
+		auto ask_close = view.column<double>("ask_close");
+		auto volume = view.column<double>("volume");
+
+		bars.reserve(bars.size() + view.size());
+		for (size_t i = 0; i < view.size(); ++i) {
+			bars.emplace_back(
+				timestamp[i],
+				bid_open[i],
+				bid_high[i],
+				bid_low[i],
+				bid_close[i],
+				ask_open[i],
+				ask_high[i],
+				ask_low[i],
+				ask_close[i],
+				volume[i]
+			);
+		}
+	}
+
+	inline void append_columnar(const columnar::View& view, std::vector<Quote<double>>& quotes) {
+		auto timestamp = view.column<double>("timestamp");
+		auto bid = view.column<double>("bid");
+		auto ask = view.column<double>("ask");
+
+		quotes.reserve(quotes.size() + view.size());
+		for (size_t i = 0; i < view.size(); ++i) {
+			quotes.emplace_back(
+				timestamp[i],
+				bid[i],
+				ask[i]
+			);
+		}
+	}
+
+	// decodes a complete body, which may consist of several messages
+	template<typename Container>
+	void from_columnar(std::string_view body, Container& container) {
+		container.clear();
+		columnar::for_each_message(body, [&container](const columnar::View& view) { append_columnar(view, container); });
+	}
+}
@@ -206,6 +206,8 @@ namespace common {
 		return ostream << report.to_string();
 	}
 
+	StatusExecReport::StatusExecReport() {}
+
 	StatusExecReport::StatusExecReport(
 		const std::string& symbol,
 		const std::string& ord_id,
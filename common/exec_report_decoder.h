@@ -0,0 +1,236 @@
+#ifndef EXEC_REPORT_DECODER_H
+#define EXEC_REPORT_DECODER_H
+
+#include <charconv>
+#include <cstdint>
+#include <string_view>
+
+#include "quickfix/FieldNumbers.h"
+#include "quickfix/Message.h"
+
+#include "exec_report.h"
+
+namespace common::fix {
+
+	/*
+	 * Flat view of an ExecutionReport, the strings refer to the decoded buffer or message and
+	 * are only valid as long as it is alive and unmodified. Use assign to copy into an ExecReport.
+	 */
+	struct ExecReportFields {
+		enum Flag : uint32_t {
+			has_symbol = 1u << 0,
+			has_exec_id = 1u << 1,
+			has_exec_type = 1u << 2,
+			has_ord_id = 1u << 3,
+			has_cl_ord_id = 1u << 4,
+			has_ord_status = 1u << 5,
+			has_ord_type = 1u << 6,
+			has_side = 1u << 7,
+			has_tif = 1u << 8,
+			has_price = 1u << 9,
+			has_avg_px = 1u << 10,
+			has_order_qty = 1u << 11,
+			has_last_qty = 1u << 12,
+			has_last_px = 1u << 13,
+			has_cum_qty = 1u << 14,
+			has_leaves_qty = 1u << 15,
+			has_text = 1u << 16,
+			has_mass_status_req_id = 1u << 17,
+			has_tot_num_reports = 1u << 18,
+			has_last_rpt_requested = 1u << 19,
+			has_custom = 1u << 20
+		};
+
+		// the fields an ExecutionReport on an order must carry
+		static constexpr uint32_t required_order_fields = has_symbol | has_exec_id | has_exec_type | has_ord_id
+			| has_cl_ord_id | has_ord_status | has_side | has_tif | has_price | has_avg_px | has_order_qty
+			| has_last_qty | has_last_px | has_cum_qty | has_leaves_qty;
+
+		std::string_view symbol{};
+		std::string_view ord_id{};
+		std::string_view cl_ord_id{};
+		std::string_view exec_id{};
+		std::string_view mass_status_req_id{};
+		std::string_view text{};
+		std::string_view custom{};
+		char exec_type{};
+		char ord_type{};
+		char ord_status{};
+		char side{};
+		char tif{};
+		double price{};
+		double avg_px{};
+		double order_qty{};
+		double last_qty{};
+		double last_px{};
+		double cum_qty{};
+		double leaves_qty{};
+		int tot_num_reports{};
+		bool last_rpt_requested{ true };
+		uint32_t present{};
+
+		bool has(uint32_t flags) const {
+			return (present & flags) == flags;
+		}
+
+		// copies into an existing report so that its string capacity is reused
+		void assign(ExecReport& report) const {
+			report.symbol.assign(symbol);
+			report.ord_id.assign(ord_id);
+			report.cl_ord_id.assign(cl_ord_id);
+			report.exec_id.assign(exec_id);
+			report.exec_type = exec_type;
+			report.ord_type = ord_type;
+			report.ord_status = ord_status;
+			report.side = side;
+			report.tif = tif;
+			report.price = price;
+			report.avg_px = avg_px;
+			report.order_qty = order_qty;
+			report.last_qty = last_qty;
+			report.last_px = last_px;
+			report.cum_qty = cum_qty;
+			report.leaves_qty = leaves_qty;
+			report.text.assign(text);
+			report.custom_1.assign(custom);
+			report.custom_2.clear();
+			report.custom_3.clear();
+		}
+
+		void assign(StatusExecReport& report) const {
+			report.symbol.assign(symbol);
+			report.ord_id.assign(ord_id);
+			report.cl_ord_id.assign(cl_ord_id);
+			report.exec_id.assign(exec_id);
+			report.mass_status_req_id.assign(mass_status_req_id);
+			report.exec_type = exec_type;
+			report.ord_type = ord_type;
+			report.ord_status = ord_status;
+			report.side = side;
+			report.tif = tif;
+			report.price = price;
+			report.avg_px = avg_px;
+			report.order_qty = order_qty;
+			report.last_qty = last_qty;
+			report.last_px = last_px;
+			report.cum_qty = cum_qty;
+			report.leaves_qty = leaves_qty;
+			report.text.assign(text);
+			report.tot_num_reports = tot_num_reports;
+			report.last_rpt_requested = last_rpt_requested;
+			report.custom_1.assign(custom);
+			report.custom_2.clear();
+			report.custom_3.clear();
+		}
+	};
+
+	/*
+	 * Decodes an ExecutionReport in a single pass over its fields, without QuickFIX field objects,
+	 * field lookups or allocation. Either walks a raw tag=value buffer, e.g. a message as received
+	 * or logged, or the body fields of an already parsed FIX::Message as handed to the application
+	 * callbacks. A venue specific string field such as a position id can be captured as custom.
+	 *
+	 * Fields of repeating groups are ignored for messages, for raw buffers the first occurrence
+	 * of a tag wins. Malformed values leave their field unset, check the presence flags with has.
+	 */
+	class ExecReportDecoder {
+	public:
+		explicit ExecReportDecoder(int custom_tag = 0)
+			: custom_tag(custom_tag)
+		{}
+
+		// the views refer to raw, the fields are separated by SOH
+		const ExecReportFields& decode_raw(std::string_view raw) {
+			fields = ExecReportFields();
+			size_t pos = 0;
+			while (pos < raw.size()) {
+				auto end = raw.find('\x1', pos);
+				if (end == std::string_view::npos)
+					end = raw.size();
+				auto field = raw.substr(pos, end - pos);
+				auto eq = field.find('=');
+				int tag = 0;
+				if (eq != std::string_view::npos && std::from_chars(field.data(), field.data() + eq, tag).ec == std::errc()) {
+					on_field(tag, field.substr(eq + 1), true);
+				}
+				pos = end + 1;
+			}
+			return fields;
+		}
+
+		// the views refer to the field values of message
+		const ExecReportFields& decode(const FIX::Message& message) {
+			fields = ExecReportFields();
+			for (auto it = message.begin(); it != message.end(); ++it) {
+				on_field(it->getTag(), it->getString(), false);
+			}
+			return fields;
+		}
+
+		const ExecReportFields& get() const {
+			return fields;
+		}
+
+	private:
+		void on_field(int tag, std::string_view value, bool first_wins) {
+			switch (tag) {
+				case FIX::FIELD::Symbol: set(fields.symbol, ExecReportFields::has_symbol, value, first_wins); break;
+				case FIX::FIELD::ExecID: set(fields.exec_id, ExecReportFields::has_exec_id, value, first_wins); break;
+				case FIX::FIELD::OrderID: set(fields.ord_id, ExecReportFields::has_ord_id, value, first_wins); break;
+				case FIX::FIELD::ClOrdID: set(fields.cl_ord_id, ExecReportFields::has_cl_ord_id, value, first_wins); break;
+				case FIX::FIELD::Text: set(fields.text, ExecReportFields::has_text, value, first_wins); break;
+				case FIX::FIELD::MassStatusReqID: set(fields.mass_status_req_id, ExecReportFields::has_mass_status_req_id, value, first_wins); break;
+				case FIX::FIELD::ExecType: set(fields.exec_type, ExecReportFields::has_exec_type, value, first_wins); break;
+				case FIX::FIELD::OrdStatus: set(fields.ord_status, ExecReportFields::has_ord_status, value, first_wins); break;
+				case FIX::FIELD::OrdType: set(fields.ord_type, ExecReportFields::has_ord_type, value, first_wins); break;
+				case FIX::FIELD::Side: set(fields.side, ExecReportFields::has_side, value, first_wins); break;
+				case FIX::FIELD::TimeInForce: set(fields.tif, ExecReportFields::has_tif, value, first_wins); break;
+				case FIX::FIELD::Price: set(fields.price, ExecReportFields::has_price, value, first_wins); break;
+				case FIX::FIELD::AvgPx: set(fields.avg_px, ExecReportFields::has_avg_px, value, first_wins); break;
+				case FIX::FIELD::OrderQty: set(fields.order_qty, ExecReportFields::has_order_qty, value, first_wins); break;
+				case FIX::FIELD::LastQty: set(fields.last_qty, ExecReportFields::has_last_qty, value, first_wins); break;
+				case FIX::FIELD::LastPx: set(fields.last_px, ExecReportFields::has_last_px, value, first_wins); break;
+				case FIX::FIELD::CumQty: set(fields.cum_qty, ExecReportFields::has_cum_qty, value, first_wins); break;
+				case FIX::FIELD::LeavesQty: set(fields.leaves_qty, ExecReportFields::has_leaves_qty, value, first_wins); break;
+				case FIX::FIELD::TotNumReports: set(fields.tot_num_reports, ExecReportFields::has_tot_num_reports, value, first_wins); break;
+				case FIX::FIELD::LastRptRequested:
+					if (claim(ExecReportFields::has_last_rpt_requested, first_wins))
+						fields.last_rpt_requested = value == "Y";
+					break;
+				default:
+					if (tag == custom_tag && custom_tag != 0)
+						set(fields.custom, ExecReportFields::has_custom, value, first_wins);
+			}
+		}
+
+		bool claim(uint32_t flag, bool first_wins) {
+			if (first_wins && (fields.present & flag))
+				return false;
+			fields.present |= flag;
+			return true;
+		}
+
+		void set(std::string_view& target, uint32_t flag, std::string_view value, bool first_wins) {
+			if (claim(flag, first_wins))
+				target = value;
+		}
+
+		void set(char& target, uint32_t flag, std::string_view value, bool first_wins) {
+			if (value.size() == 1 && claim(flag, first_wins))
+				target = value[0];
+		}
+
+		template<typename T>
+		void set(T& target, uint32_t flag, std::string_view value, bool first_wins) {
+			T parsed{};
+			auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), parsed);
+			if (ec == std::errc() && ptr == value.data() + value.size() && claim(flag, first_wins))
+				target = parsed;
+		}
+
+		int custom_tag;
+		ExecReportFields fields;
+	};
+}
+
+#endif
@@ -4,6 +4,9 @@
 #include "quickfix/FixFields.h"
 #include "quickfix/FixValues.h"
 #include "quickfix/Message.h"
+#include "quickfix/FieldTypes.h"
+
+#include <chrono>
 
 namespace common::fix {
 
@@ -28,6 +31,23 @@ namespace common::fix {
 		return msg_type == FIX::MsgType_ExecutionReport;
 	}
 
+	// FIX date time of a timestamp in nanoseconds since the unix epoch
+	inline FIX::DateTime to_date_time(const std::chrono::nanoseconds& t) {
+		auto days = std::chrono::floor<std::chrono::days>(t);
+		auto time_of_day = std::chrono::duration_cast<std::chrono::nanoseconds>(t - days);
+		return FIX::DateTime((int)(FIX::DateTime::JULIAN_19700101 + days.count()), time_of_day.count());
+	}
+
+	// timestamp in nanoseconds since the unix epoch from a separate FIX date and time of day, e.g. MDEntryDate and MDEntryTime
+	inline std::chrono::nanoseconds to_nanoseconds(const FIX::DateTime& date, const FIX::DateTime& time) {
+		auto days = std::chrono::days(date.getJulianDate() - FIX::DateTime::JULIAN_19700101);
+		auto time_of_day = std::chrono::hours(time.getHour()) 
+			+ std::chrono::minutes(time.getMinute())
+			+ std::chrono::seconds(time.getSecond())
+			+ std::chrono::nanoseconds(time.getNanosecond());
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(days) + time_of_day;
+	}
+
 }
 
 #endif 
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <sstream>
+#include <atomic>
 
 class IDGenerator
 {
@@ -30,10 +31,11 @@ public:
 	}
 
 private:
-	long m_genID;
-	long m_orderID;
-	long m_executionID;
-	long m_mdReqID;
+	// atomic since ids are generated from concurrent market update workers
+	std::atomic<long> m_genID;
+	std::atomic<long> m_orderID;
+	std::atomic<long> m_executionID;
+	std::atomic<long> m_mdReqID;
 };
 
 #endif
@@ -0,0 +1,120 @@
+#ifndef INSTRUMENT_REGISTRY_H
+#define INSTRUMENT_REGISTRY_H
+
+#include "pch.h"
+
+#include <deque>
+#include <optional>
+#include <shared_mutex>
+
+#include "interner.h"
+
+namespace common {
+
+	// static attributes of a tradable instrument, zero if the source does not provide them
+	struct Instrument {
+		uint32_t id{ 0 };
+		std::string symbol{};
+		std::string currency{};
+		double tick_size{ 0 };
+		int precision{ 0 };
+		double min_quantity{ 0 };
+		double max_quantity{ 0 };
+		double contract_multiplier{ 1 };
+
+		std::string to_string() const {
+			return std::format(
+				"Instrument[id={}, symbol={}, currency={}, tick_size={}, precision={}, min_quantity={}, max_quantity={}, contract_multiplier={}]",
+				id, symbol, currency, tick_size, precision, min_quantity, max_quantity, contract_multiplier
+			);
+		}
+	};
+
+	/*
+	 * Process wide registry of instruments with dense integer ids. The ids are the handles of the
+	 * symbol interner, so they agree with Order::get_symbol_id, and are never reused. Hot path
+	 * structures resolve a symbol once and then index arrays by id instead of hashing strings.
+	 *
+	 * Seeded from the FXCM security list and from the simulator market config, symbols seen
+	 * elsewhere first are registered on demand without attributes.
+	 */
+	class InstrumentRegistry {
+	public:
+		// registers or updates the attributes of an instrument, returns its id
+		uint32_t register_instrument(const Instrument& instrument) {
+			auto id = symbol_interner().intern(instrument.symbol);
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			auto& entry = slot(id);
+			entry = instrument;
+			entry->id = id;
+			return id;
+		}
+
+		// the id of the symbol, registers it without attributes on first use
+		uint32_t id(std::string_view symbol) {
+			auto id = symbol_interner().intern(symbol);
+			{
+				std::shared_lock<std::shared_mutex> lock(mutex);
+				if (id < instruments.size() && instruments[id].has_value())
+					return id;
+			}
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			auto& entry = slot(id);
+			if (!entry.has_value()) {
+				entry = Instrument{ .id = id, .symbol = std::string(symbol) };
+			}
+			return id;
+		}
+
+		std::optional<uint32_t> find(std::string_view symbol) const {
+			return symbol_interner().find(symbol);
+		}
+
+		const std::string& symbol(uint32_t id) const {
+			return symbol_interner().lookup(id);
+		}
+
+		std::optional<Instrument> get(uint32_t id) const {
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			return id < instruments.size() ? instruments[id] : std::optional<Instrument>();
+		}
+
+		std::optional<Instrument> get(std::string_view symbol) const {
+			auto id = find(symbol);
+			return id.has_value() ? get(id.value()) : std::optional<Instrument>();
+		}
+
+		// upper bound of the ids handed out so far, for sizing id indexed arrays
+		size_t capacity() const {
+			return symbol_interner().size();
+		}
+
+		std::vector<Instrument> all() const {
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			std::vector<Instrument> result;
+			for (const auto& instrument : instruments) {
+				if (instrument.has_value())
+					result.push_back(instrument.value());
+			}
+			return result;
+		}
+
+	private:
+		// called with the lock
+		std::optional<Instrument>& slot(uint32_t id) {
+			if (id >= instruments.size())
+				instruments.resize(id + 1);
+			return instruments[id];
+		}
+
+		mutable std::shared_mutex mutex;
+		std::deque<std::optional<Instrument>> instruments;
+	};
+
+	inline InstrumentRegistry& instrument_registry() {
+		static InstrumentRegistry registry;
+		return registry;
+	}
+}
+
+#endif
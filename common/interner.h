@@ -0,0 +1,75 @@
+#ifndef INTERNER_H
+#define INTERNER_H
+
+#include "pch.h"
+
+#include <deque>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace common {
+
+	/*
+	 * Maps strings such as symbols or FIX session comp ids to dense 32 bit handles.
+	 * Interned strings are never released, references returned by lookup stay valid.
+	 */
+	class Interner {
+	public:
+		uint32_t intern(std::string_view value) {
+			{
+				std::shared_lock<std::shared_mutex> lock(mutex);
+				auto it = ids.find(value);
+				if (it != ids.end()) {
+					return it->second;
+				}
+			}
+
+			std::unique_lock<std::shared_mutex> lock(mutex);
+			auto it = ids.find(value);
+			if (it != ids.end()) {
+				return it->second;
+			}
+			auto id = static_cast<uint32_t>(strings.size());
+			const auto& str = strings.emplace_back(value);
+			ids.emplace(std::string_view(str), id);
+			return id;
+		}
+
+		std::optional<uint32_t> find(std::string_view value) const {
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			auto it = ids.find(value);
+			return it != ids.end() ? std::optional<uint32_t>(it->second) : std::optional<uint32_t>();
+		}
+
+		const std::string& lookup(uint32_t id) const {
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			if (id >= strings.size()) {
+				throw std::runtime_error(std::format("Interner::lookup: invalid handle {}", id));
+			}
+			return strings[id];
+		}
+
+		size_t size() const {
+			std::shared_lock<std::shared_mutex> lock(mutex);
+			return strings.size();
+		}
+
+	private:
+		mutable std::shared_mutex mutex;
+		std::deque<std::string> strings;
+		std::unordered_map<std::string_view, uint32_t> ids;
+	};
+
+	inline Interner& symbol_interner() {
+		static Interner interner;
+		return interner;
+	}
+
+	inline Interner& session_interner() {
+		static Interner interner;
+		return interner;
+	}
+}
+
+#endif
@@ -4,21 +4,24 @@
 
 #include "market.h"
 #include "json.h"
+#include "columnar.h"
 #include "time_utils.h"
 
 namespace common {
 
     Market::Market(
         const std::shared_ptr<PriceSampler>& price_sampler,
+        const std::shared_ptr<Clock>& clock,
         const TopOfBook& current,
+        const PriceScale& price_scale,
         const std::chrono::nanoseconds& bar_period,
         const std::chrono::nanoseconds& history_age,
         const std::chrono::nanoseconds& history_sample_period,
-        bool prune_bars,
-        std::mutex& mutex
-    ) : OrderMatcher(mutex)
+        bool prune_bars
+    ) : OrderMatcher(price_scale)
         , symbol(price_sampler->get_symbol())
         , price_sampler(price_sampler)
+        , clock(clock)
         , bar_period(bar_period)
         , history_age(history_age)
         , history_sample_period(history_sample_period)
@@ -36,7 +39,7 @@ namespace common {
         , oldest(current)
         , quoting(false)
         , bid_order(
-            std::format("quote_ord_id_0"),
+            0,
             std::format("quote_cl_ord_id_0"),
             symbol,
             OWNER_MARKET_SIMULATOR,
@@ -47,7 +50,7 @@ namespace common {
             (long)current.bid_volume
         )
         , ask_order(
-            std::format("quote_ord_id_1"),
+            0,
             std::format("quote_cl_ord_id_1"),
             symbol,
             OWNER_MARKET_SIMULATOR,
@@ -64,8 +67,8 @@ namespace common {
     }
 
     void Market::simulate_next() {
-        std::lock_guard<std::mutex> ul(mutex);
-        auto now = get_current_system_clock();
+        std::lock_guard<std::mutex> ul(market_data_mutex);
+        auto now = clock->now();
         previous = current;
         current = price_sampler->sample(current, now);
         top_of_books.insert(std::make_pair(now, current));
@@ -106,17 +109,17 @@ namespace common {
     }
 
     TopOfBook Market::get_current_top_of_book() const {
-        std::lock_guard<std::mutex> ul(mutex);
+        std::lock_guard<std::mutex> ul(market_data_mutex);
         return current;
     }
 
     std::pair<TopOfBook, TopOfBook> Market::get_current_and_previous_top_of_book() const {
-        std::lock_guard<std::mutex> ul(mutex);
+        std::lock_guard<std::mutex> ul(market_data_mutex);
         return std::make_pair(current, previous);
     }
 
     std::tuple<std::chrono::nanoseconds, std::chrono::nanoseconds, size_t> Market::get_bar_range() const {
-        std::lock_guard<std::mutex> ul(mutex);
+        std::lock_guard<std::mutex> ul(market_data_mutex);
         std::chrono::nanoseconds from, to;
         if (!bars.empty()) {
             from = bars.begin()->second.end;
@@ -126,7 +129,7 @@ namespace common {
     }
 
     void Market::extend_bar_history(const std::chrono::nanoseconds& past) {
-        std::lock_guard<std::mutex> ul(mutex);
+        std::lock_guard<std::mutex> ul(market_data_mutex);
         auto until = round_down(past, bar_period);
         spdlog::info("====> extend_bar_history from {} until {}", common::to_string(oldest.timestamp), common::to_string(until));
         auto t = oldest.timestamp;
@@ -142,9 +145,18 @@ namespace common {
         if (bars_from > from) {
             extend_bar_history(from);
         }
-        std::lock_guard<std::mutex> ul(mutex);
+        std::lock_guard<std::mutex> ul(market_data_mutex);
         return to_json(from, to, bars); 
     }
+
+    std::pair<std::string, int> Market::get_bars_as_columnar(const std::chrono::nanoseconds& from, const std::chrono::nanoseconds& to) {
+        auto [bars_from, bars_to, num_bars] = get_bar_range();
+        if (bars_from > from) {
+            extend_bar_history(from);
+        }
+        std::lock_guard<std::mutex> ul(market_data_mutex);
+        return to_columnar(from, to, bars);
+    }
 }
 
 
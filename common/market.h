@@ -15,6 +15,7 @@
 #include "market_data.h"
 #include "price_sampler.h"
 #include "bar_builder.h"
+#include "clock.h"
 #include "json.h"
 
 namespace common {
@@ -26,12 +27,13 @@ namespace common {
 	public:
 		explicit Market(
 			const std::shared_ptr<PriceSampler>& price_sampler,
+			const std::shared_ptr<Clock>& clock,
 			const TopOfBook& current,
+			const PriceScale& price_scale,
 			const std::chrono::nanoseconds& bar_period,
 			const std::chrono::nanoseconds& history_age,
 			const std::chrono::nanoseconds& histroy_sample_period,
-			bool prune_bars,
-			std::mutex& mutex
+			bool prune_bars
 		);
 
 		Market(const Market&) = delete;
@@ -50,15 +52,25 @@ namespace common {
 
 		std::pair<nlohmann::json, int> get_bars_as_json(const std::chrono::nanoseconds& from, const std::chrono::nanoseconds& to);
 
+		std::pair<std::string, int> get_bars_as_columnar(const std::chrono::nanoseconds& from, const std::chrono::nanoseconds& to);
+
 		const Order& get_bid_order() const;
 
 		const Order& get_ask_order() const;
 
 		OrderInsertResult quote(const Order& order_ins);
 
+		template<MatchListener Listener>
+		bool quote(const Order& order_ins, Listener& listener);
+
 	private:
+		// guards the simulated market data and bar history, the order book has its own lock 
+		// in OrderMatcher so that history requests do not block matching
+		mutable std::mutex market_data_mutex;
+
 		std::string symbol;
 		std::shared_ptr<PriceSampler> price_sampler;
+		std::shared_ptr<Clock> clock;
 		std::chrono::nanoseconds bar_period;
 		std::chrono::nanoseconds history_age;
 		std::chrono::nanoseconds history_sample_period;
@@ -78,6 +90,19 @@ namespace common {
 		Order bid_order, ask_order;
 	};
 
+	template<MatchListener Listener>
+	inline bool Market::quote(const Order& order_ins, Listener& listener) {
+		auto success = insert(order_ins, listener);
+		if (success) {
+			if (order_ins.get_side() == Order::Side::buy) {
+				bid_order = order_ins;
+			}
+			else {
+				ask_order = order_ins;
+			}
+		}
+		return success;
+	}
 }
 
 #endif
@@ -4,12 +4,10 @@
 #include "pch.h"
 
 #include "time_utils.h"
+#include "price.h"
 
 namespace common {
 
-	const uint32_t TO_PIPS = 10000;
-	const uint32_t TO_POINTS = 10 * TO_PIPS;
-
 	struct BookLevel {
 		double bid_price{ NAN };
 		double bid_volume{0};
@@ -50,6 +48,14 @@ namespace common {
 			return ask_price - bid_price;
 		}
 
+		Price bid_ticks(const PriceScale& scale) const {
+			return scale.to_price(bid_price);
+		}
+
+		Price ask_ticks(const PriceScale& scale) const {
+			return scale.to_price(ask_price);
+		}
+
 		std::string symbol{};
 		std::chrono::nanoseconds timestamp{ 0 };
 		double bid_price{ 0 };
@@ -17,7 +17,7 @@ namespace common {
 		}
 	}
 
-	std::optional<Order> Markets::find(const std::string& symbol, const std::string& ord_id, Order::Side side)
+	std::optional<Order> Markets::find(const std::string& symbol, uint64_t ord_id, Order::Side side)
 	{
 		auto it = markets.find(symbol);
 		if (it != markets.end()) {
@@ -28,7 +28,7 @@ namespace common {
 		}
 	}
 
-	std::optional<Order> Markets::erase(const std::string& symbol, const std::string& ord_id, Order::Side side) {
+	std::optional<Order> Markets::erase(const std::string& symbol, uint64_t ord_id, Order::Side side) {
 		auto it = markets.find(symbol);
 		if (it != markets.end()) {
 			return it->second.erase(ord_id, side);
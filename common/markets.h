@@ -19,9 +19,15 @@ namespace common {
 
 		OrderInsertResult insert(const Order& order);
 
-		std::optional<Order> find(const std::string& symbol, const std::string& ord_id, Order::Side side);
+		template<MatchListener Listener>
+		bool insert(const Order& order, Listener& listener);
 
-		std::optional<Order> erase(const std::string& symbol, const std::string& ord_id, Order::Side side);
+		std::optional<Order> find(const std::string& symbol, uint64_t ord_id, Order::Side side);
+
+		std::optional<Order> erase(const std::string& symbol, uint64_t ord_id, Order::Side side);
+
+		template<MatchListener Listener>
+		bool erase(const std::string& symbol, uint64_t ord_id, Order::Side side, Listener& listener);
 
 		std::optional<TopOfBook> get_current_top_of_book(const std::string& symbol) const;
 
@@ -32,6 +38,31 @@ namespace common {
 		market_map_t& markets;
 	};
 
+	template<MatchListener Listener>
+	inline bool Markets::insert(const Order& order, Listener& listener)
+	{
+		auto it = markets.find(order.get_symbol());
+		if (it != markets.end()) {
+			return it->second.insert(order, listener);
+		}
+		else {
+			listener.on_reject(order);
+			return false;
+		}
+	}
+
+	template<MatchListener Listener>
+	inline bool Markets::erase(const std::string& symbol, uint64_t ord_id, Order::Side side, Listener& listener) 
+	{
+		auto it = markets.find(symbol);
+		if (it != markets.end()) {
+			return it->second.erase(ord_id, side, listener);
+		}
+		else {
+			return false;
+		}
+	}
+
 }
 
 #endif
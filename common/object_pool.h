@@ -0,0 +1,70 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include "pch.h"
+
+namespace common {
+
+	/*
+	 * Slab allocator handing out fixed size slots from chunks of ChunkSize objects.
+	 * Released slots are recycled through a free list so that steady state creation
+	 * does not allocate. Not thread safe, the owner has to synchronize access. Objects 
+	 * which are not trivially destructible have to be destroyed before the pool.
+	 */
+	template<typename T, size_t ChunkSize = 1024>
+	class ObjectPool {
+		union Slot {
+			Slot* next;
+			alignas(T) std::byte storage[sizeof(T)];
+		};
+
+	public:
+		ObjectPool() = default;
+
+		ObjectPool(const ObjectPool&) = delete;
+
+		ObjectPool& operator= (const ObjectPool&) = delete;
+
+		template<typename... Args>
+		T* create(Args&&... args) {
+			if (free_list == nullptr) {
+				grow();
+			}
+			auto slot = free_list;
+			free_list = slot->next;
+			++count;
+			return new (slot->storage) T(std::forward<Args>(args)...);
+		}
+
+		void destroy(T* object) {
+			object->~T();
+			auto slot = reinterpret_cast<Slot*>(object);
+			slot->next = free_list;
+			free_list = slot;
+			--count;
+		}
+
+		size_t size() const {
+			return count;
+		}
+
+		size_t capacity() const {
+			return chunks.size() * ChunkSize;
+		}
+
+	private:
+		void grow() {
+			auto& chunk = chunks.emplace_back(std::make_unique<Slot[]>(ChunkSize));
+			for (size_t i = ChunkSize; i > 0; --i) {
+				chunk[i - 1].next = free_list;
+				free_list = &chunk[i - 1];
+			}
+		}
+
+		std::vector<std::unique_ptr<Slot[]>> chunks;
+		Slot* free_list{ nullptr };
+		size_t count{ 0 };
+	};
+}
+
+#endif
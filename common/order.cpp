@@ -3,11 +3,12 @@
 #include "spdlog/spdlog.h"
 
 #include "order.h"
+#include "interner.h"
 
 namespace common {
 
 	Order::Order(
-		const std::string& ord_id,
+		uint64_t ord_id,
 		const std::string& cl_ord_id,
 		const std::string& symbol,
 		const std::string& owner,
@@ -16,34 +17,77 @@ namespace common {
 		Type type,
 		double price,
 		long quantity
+	) : Order(
+		ord_id,
+		std::string_view(cl_ord_id),
+		symbol_interner().intern(symbol),
+		session_interner().intern(owner),
+		session_interner().intern(target),
+		side,
+		type,
+		price,
+		quantity
+	  )
+	{}
+
+	Order::Order(
+		uint64_t ord_id,
+		std::string_view cl_ord_id,
+		uint32_t symbol_id,
+		uint32_t owner_id,
+		uint32_t target_id,
+		Side side,
+		Type type,
+		double price,
+		long quantity
 	) : ord_id(ord_id)
-	  , cl_ord_id(cl_ord_id)
-	  , symbol(symbol)
-	  , owner(owner)
-	  , target(target)
-	  , side(side)
-	  , type(type)
 	  , price(price)
+	  , symbol_id(symbol_id)
+	  , owner_id(owner_id)
+	  , target_id(target_id)
 	  , quantity(quantity)
+	  , side(side)
+	  , type(type)
 	{
 		open_quantity = quantity;
 		executed_quantity = 0;
 		avg_executed_price = 0;
 		last_executed_price = 0;
 		last_executed_quantity = 0;
+		set_cl_ord_id(cl_ord_id);
+	}
+
+	uint64_t Order::get_ord_id() const { return ord_id; }
+
+	std::string_view Order::get_cl_ord_id() const { 
+		if (!long_cl_ord_id.empty()) {
+			return long_cl_ord_id;
+		}
+		return std::string_view(cl_ord_id.data(), cl_ord_id_length); 
+	}
+
+	void Order::set_cl_ord_id(std::string_view new_cl_ord_id) { 
+		if (new_cl_ord_id.size() > inline_cl_ord_id_length) {
+			long_cl_ord_id.assign(new_cl_ord_id);
+			cl_ord_id_length = 0;
+			return;
+		}
+		long_cl_ord_id.clear();
+		std::copy(new_cl_ord_id.begin(), new_cl_ord_id.end(), cl_ord_id.begin());
+		cl_ord_id_length = static_cast<uint8_t>(new_cl_ord_id.size());
 	}
 
-	const std::string& Order::get_ord_id() const { return ord_id; }
+	uint32_t Order::get_symbol_id() const { return symbol_id; }
 
-	const std::string& Order::get_cl_ord_id() const { return cl_ord_id; }
+	uint32_t Order::get_owner_id() const { return owner_id; }
 
-	void Order::set_cl_ord_id(const std::string& new_cl_ord_id) { cl_ord_id = new_cl_ord_id; }
+	uint32_t Order::get_target_id() const { return target_id; }
 
-	const std::string& Order::get_symbol() const { return symbol; }
+	const std::string& Order::get_symbol() const { return symbol_interner().lookup(symbol_id); }
 
-	const std::string& Order::get_owner() const { return owner; }
+	const std::string& Order::get_owner() const { return session_interner().lookup(owner_id); }
 
-	const std::string& Order::get_target() const { return target; }
+	const std::string& Order::get_target() const { return session_interner().lookup(target_id); }
 
 	Order::Side Order::get_side() const { return side; }
 
@@ -51,6 +95,10 @@ namespace common {
 
 	double Order::get_price() const { return price; }
 
+	const Price& Order::get_tick_price() const { return tick_price; }
+
+	void Order::set_tick_price(const Price& new_tick_price) { tick_price = new_tick_price; }
+
 	long Order::get_quantity() const { return quantity; }
 
 	long Order::get_open_quantity() const { return open_quantity; }
@@ -92,13 +140,25 @@ namespace common {
 		open_quantity = 0;
 	}
 
+	void Order::amend(long new_quantity)
+	{
+		if (new_quantity < executed_quantity) {
+			throw std::runtime_error(std::format(
+				"Order::amend: {} new quantity={} less than executed quantity", to_string(), new_quantity
+			));
+		}
+
+		quantity = new_quantity;
+		open_quantity = quantity - executed_quantity;
+	}
+
 	std::string Order::to_string() const {
 		return std::string("Order[") +
-			"symbol=" + symbol + ", " +
-			"ord_id=" + ord_id + ", " +
-			"cl_ord_id=" + cl_ord_id + ", " +
-			"owner=" + owner + ", " +
-			"target=" + target + ", " +
+			"symbol=" + get_symbol() + ", " +
+			"ord_id=" + std::to_string(ord_id) + ", " +
+			"cl_ord_id=" + std::string(get_cl_ord_id()) + ", " +
+			"owner=" + get_owner() + ", " +
+			"target=" + get_target() + ", " +
 			"side=" + std::to_string(side) + ", " +
 			"type=" + std::to_string(type) + ", " +
 			"price=" + std::to_string(price) + ", " +
@@ -2,21 +2,33 @@
 #define ORDER_H
 
 #include <string>
+#include <string_view>
+#include <array>
 #include <iomanip>
 #include <ostream>
 
+#include "price.h"
+
 namespace common {
 
+	/*
+	 * Compact order representation. The order id is numeric, symbol and sessions are 
+	 * interned handles and client order ids of up to inline_cl_ord_id_length characters 
+	 * are stored inline, so that copying an order does not allocate. Longer client order 
+	 * ids are kept in a separate string. Strings are only materialized at the FIX boundary.
+	 */
 	class Order
 	{
 		friend std::ostream& operator<<(std::ostream&, const Order&);
 
 	public:
-		enum Side { buy, sell };
-		enum Type { market, limit };
+		enum Side : uint8_t { buy, sell };
+		enum Type : uint8_t { market, limit };
+
+		static constexpr size_t inline_cl_ord_id_length = 31;
 
 		Order(
-			const std::string& ord_id,
+			uint64_t ord_id,
 			const std::string& cl_ord_id,
 			const std::string& symbol,
 			const std::string& owner,
@@ -27,15 +39,33 @@ namespace common {
 			long quantity
 		);
 
-		const std::string& get_ord_id() const;
-		const std::string& get_cl_ord_id() const;
-		void set_cl_ord_id(const std::string& new_cl_ord_id);
+		Order(
+			uint64_t ord_id,
+			std::string_view cl_ord_id,
+			uint32_t symbol_id,
+			uint32_t owner_id,
+			uint32_t target_id,
+			Side side,
+			Type type,
+			double price,
+			long quantity
+		);
+
+		uint64_t get_ord_id() const;
+		std::string_view get_cl_ord_id() const;
+		void set_cl_ord_id(std::string_view new_cl_ord_id);
+		uint32_t get_symbol_id() const;
+		uint32_t get_owner_id() const;
+		uint32_t get_target_id() const;
 		const std::string& get_symbol() const;
 		const std::string& get_owner() const;
 		const std::string& get_target() const;
 		Side get_side() const;
 		Type get_type() const;
 		double get_price() const;
+		// the price in ticks of the symbol's price scale, only set once the matcher accepted the order
+		const Price& get_tick_price() const;
+		void set_tick_price(const Price& tick_price);
 		long get_quantity() const;
 
 		long get_open_quantity() const;
@@ -51,23 +81,28 @@ namespace common {
 
 		void cancel();
 
+		void amend(long new_quantity);
+
 		std::string to_string() const;
 
 	private:
-		std::string ord_id;
-		std::string cl_ord_id;
-		std::string symbol;
-		std::string owner;
-		std::string target;
-		Side side;
-		Type type;
+		uint64_t ord_id;
+		Price tick_price{};
 		double price;
+		double avg_executed_price;
+		double last_executed_price;
+		uint32_t symbol_id;
+		uint32_t owner_id;
+		uint32_t target_id;
 		long quantity;
 		long open_quantity;
 		long executed_quantity;
-		double avg_executed_price;
-		double last_executed_price;
 		long last_executed_quantity;
+		Side side;
+		Type type;
+		uint8_t cl_ord_id_length;
+		std::array<char, inline_cl_ord_id_length> cl_ord_id;
+		std::string long_cl_ord_id;
 	};
 
 	std::string to_string(const Order::Side& side);
@@ -1,5 +1,7 @@
 #include "pch.h"
 
+#include <bit>
+
 #include "order_matcher.h"
 
 #include "spdlog/spdlog.h"
@@ -17,191 +19,285 @@ namespace common {
       , error(error)
     {}
 
-    OrderMatcher::OrderMatcher(std::mutex& mutex) : mutex(mutex) {}
+    void PriceLevel::push_back(OrderNode* node)
+    {
+        node->level = this;
+        node->prev = tail;
+        node->next = nullptr;
+        if (tail != nullptr)
+            tail->next = node;
+        else
+            head = node;
+        tail = node;
+        ++count;
+        quantity += node->order.get_quantity();
+        open_quantity += node->order.get_open_quantity();
+    }
 
-    OrderInsertResult OrderMatcher::insert(const Order& order)
+    void PriceLevel::unlink(OrderNode* node)
     {
-        std::lock_guard<std::mutex> ul(mutex);
-        auto error = false;
-        auto order_processed = order;
-        std::vector<Order> matched;
-        std::optional<Order> resting_order;
+        if (node->prev != nullptr)
+            node->prev->next = node->next;
+        else
+            head = node->next;
+        if (node->next != nullptr)
+            node->next->prev = node->prev;
+        else
+            tail = node->prev;
+        node->prev = nullptr;
+        node->next = nullptr;
+        node->level = nullptr;
+        --count;
+        quantity -= node->order.get_quantity();
+        open_quantity -= node->order.get_open_quantity();
+    }
+
+    OrderIndex::OrderIndex(size_t bucket_count)
+        : buckets(std::bit_ceil(std::max<size_t>(bucket_count, 16)), nullptr)
+        , mask(buckets.size() - 1)
+    {}
 
-        if (order_processed.get_type() == Order::Type::market) {
-            auto vwap = vwap_price(order.get_side(), order.get_open_quantity(), order.get_owner());
-            order_processed.execute(vwap, order.get_open_quantity());
-            matched.push_back(order_processed);
+    size_t OrderIndex::bucket(uint64_t ord_id) const {
+        // fibonacci hashing spreads sequential order ids over the buckets
+        return static_cast<size_t>((ord_id * 11400714819323198485ull) >> 32) & mask;
+    }
 
-            spdlog::debug("OrderMatcher::insert: matched market order: vwap={} order_processed={}", vwap, order_processed.to_string());
+    OrderNode* OrderIndex::find(uint64_t ord_id) const {
+        for (auto node = buckets[bucket(ord_id)]; node != nullptr; node = node->hash_next) {
+            if (node->order.get_ord_id() == ord_id)
+                return node;
         }
-        else if (order_processed.get_type() == Order::Type::limit) {
-            const auto& price = order_processed.get_price();
-            if (order_processed.get_side() == Order::buy) {
-                auto it = ask_orders.begin();
-                if (it != ask_orders.end() && price >= it->second.get_price()) {
-                    match(order_processed, matched);
-                }
-                if (!order_processed.is_closed()) {
-                    bid_orders.insert(std::make_pair(price, order_processed));
-                    resting_order = std::make_optional(order_processed);
-                }
-            }
-            else {
-                auto it = bid_orders.begin();
-                if (it != bid_orders.end() && price <= it->second.get_price()) {
-                    match(order_processed, matched);
-                }
-                if (!order_processed.is_closed()) {
-                    ask_orders.insert(std::make_pair(price, order_processed));
-                    resting_order = std::make_optional(order_processed);
-                }
+        return nullptr;
+    }
+
+    bool OrderIndex::contains(uint64_t ord_id) const {
+        return find(ord_id) != nullptr;
+    }
+
+    void OrderIndex::insert(OrderNode* node) {
+        if (count + 1 > buckets.size()) {
+            rehash(2 * buckets.size());
+        }
+        auto& head = buckets[bucket(node->order.get_ord_id())];
+        node->hash_next = head;
+        head = node;
+        ++count;
+    }
+
+    void OrderIndex::erase(OrderNode* node) {
+        auto link = &buckets[bucket(node->order.get_ord_id())];
+        while (*link != nullptr) {
+            if (*link == node) {
+                *link = node->hash_next;
+                node->hash_next = nullptr;
+                --count;
+                return;
             }
+            link = &(*link)->hash_next;
         }
+    }
 
-        return OrderInsertResult(resting_order, std::move(matched));
+    size_t OrderIndex::size() const {
+        return count;
     }
 
-    std::optional<Order> OrderMatcher::erase(const std::string& ord_id, const Order::Side& side)
+    void OrderIndex::rehash(size_t bucket_count) {
+        std::vector<OrderNode*> old(bucket_count, nullptr);
+        old.swap(buckets);
+        mask = buckets.size() - 1;
+        for (auto head : old) {
+            while (head != nullptr) {
+                auto next = head->hash_next;
+                auto& slot = buckets[bucket(head->order.get_ord_id())];
+                head->hash_next = slot;
+                slot = head;
+                head = next;
+            }
+        }
+    }
+
+    OrderMatcher::OrderMatcher(const PriceScale& price_scale) 
+        : price_scale(price_scale)
+    {}
+
+    OrderMatcher::~OrderMatcher()
     {
-        std::lock_guard<std::mutex> ul(mutex);
-        if (side == Order::buy)
-        {
-            for (auto it = bid_orders.begin(); it != bid_orders.end(); ++it) {
-                if (it->second.get_ord_id() == ord_id) {
-                    auto order = std::optional<Order>(it->second);
-                    bid_orders.erase(it);
-                    return order;
-                }
+        // the order nodes own the client order ids which do not fit inline
+        for (auto& [price, level] : bid_levels) {
+            for (auto node = level.head; node != nullptr;) {
+                auto next = node->next;
+                nodes.destroy(node);
+                node = next;
+            }
+        }
+        for (auto& [price, level] : ask_levels) {
+            for (auto node = level.head; node != nullptr;) {
+                auto next = node->next;
+                nodes.destroy(node);
+                node = next;
             }
         }
-        else if (side == Order::sell)
-        {
-            for (auto it = ask_orders.begin(); it != ask_orders.end(); ++it) {
-                if (it->second.get_ord_id() == ord_id) {
-                    auto order = std::optional<Order>(it->second);
-                    ask_orders.erase(it);
-                    return order;
+    }
+
+    const PriceScale& OrderMatcher::get_price_scale() const {
+        return price_scale;
+    }
+
+    namespace {
+
+        // collects the match events of a single insert into an OrderInsertResult
+        struct OrderInsertResultCollector {
+            void on_accept(const Order& order) {
+                resting_order = order;
+            }
+
+            void on_fill(const Fill& fill) {
+                if (fill.maker != nullptr) {
+                    matched.push_back(*fill.maker);
                 }
+                matched.push_back(*fill.taker);
+            }
+
+            void on_cancel(const Order& order) {}
+
+            void on_reject(const Order& order) {
+                spdlog::error("OrderMatcher::insert: rejected order with duplicate ord_id={}", order.get_ord_id());
+                error = true;
             }
+
+            std::optional<Order> resting_order;
+            std::vector<Order> matched;
+            bool error{ false };
+        };
+    }
+
+    OrderInsertResult OrderMatcher::insert(const Order& order)
+    {
+        OrderInsertResultCollector collector;
+        insert(order, collector);
+        return OrderInsertResult(collector.resting_order, std::move(collector.matched), collector.error);
+    }
+
+    void OrderMatcher::remove(OrderNode* node)
+    {
+        auto level = node->level;
+        auto price = level->price;
+        auto side = node->order.get_side();
+        touch(side, price);
+        level->unlink(node);
+        if (level->empty()) {
+            if (side == Order::buy)
+                bid_levels.erase(price);
+            else
+                ask_levels.erase(price);
         }
+        index.erase(node);
+        nodes.destroy(node);
+    }
 
-        return std::optional<Order>();
+    std::optional<Order> OrderMatcher::erase(uint64_t ord_id, const Order::Side& side)
+    {
+        std::lock_guard<std::mutex> ul(mutex);
+        auto node = index.find(ord_id);
+        if (node == nullptr || node->order.get_side() != side) {
+            return std::optional<Order>();
+        }
+
+        auto order = std::optional<Order>(node->order);
+        remove(node);
+        return order;
     }
 
-    void OrderMatcher::match(Order& order, std::vector<Order>& orders)
+    std::optional<Order> OrderMatcher::amend(uint64_t ord_id, long quantity)
     {
-        const auto& price = order.get_price();
-        if (order.get_side() == Order::Side::buy) {
-            auto it = ask_orders.begin();
-            while (it != ask_orders.end() && it->second.get_price() <= price) {
-                auto& ask = it->second;
-                const auto& exec_price = ask.get_price();
-                long quantity = std::min(ask.get_open_quantity(), order.get_open_quantity());
-                ask.execute(exec_price, quantity);
-                order.execute(exec_price, quantity);
-                orders.push_back(ask);
-                orders.push_back(order);
-
-                spdlog::debug("OrderMatcher::match: ask side match: ask={} order_processed={}", ask.to_string(), order.to_string());
-
-                if (ask.is_closed())
-                    it = ask_orders.erase(it);
-                else
-                    ++it;
-            }
+        std::lock_guard<std::mutex> ul(mutex);
+        auto node = index.find(ord_id);
+        if (node == nullptr) {
+            return std::optional<Order>();
         }
-        else {
-            auto it = bid_orders.begin();
-            while (it != bid_orders.end() && it->second.get_price() >= price) {
-                auto& bid = it->second;
-                const auto& exec_price = bid.get_price();
-                long quantity = std::min(bid.get_open_quantity(), order.get_open_quantity());
-                bid.execute(exec_price, quantity);
-                order.execute(exec_price, quantity);
-                orders.push_back(bid);
-                orders.push_back(order);
-
-                spdlog::debug("OrderMatcher::match: bid side match: ask={} order_processed={}", bid.to_string(), order.to_string());
-
-                if (bid.is_closed())
-                    it = bid_orders.erase(it);
-                else
-                    ++it;
-            }
+
+        auto previous_quantity = node->order.get_quantity();
+        auto open_quantity = node->order.get_open_quantity();
+        node->order.amend(quantity);
+        node->level->amended(node->order.get_quantity() - previous_quantity, node->order.get_open_quantity() - open_quantity);
+        touch(node->order.get_side(), node->level->price);
+        auto order = std::optional<Order>(node->order);
+
+        if (node->order.is_closed()) {
+            remove(node);
+        }
+        else if (node->order.get_open_quantity() > open_quantity) {
+            // increasing the quantity loses time priority
+            auto level = node->level;
+            level->unlink(node);
+            level->push_back(node);
         }
+
+        return order;
     }
 
-    double OrderMatcher::vwap_price(const Order::Side& side, long total_quantity, const std::string& owner) {
-        double vwap = 0;
-        long cum_quantity = 0;
+    double OrderMatcher::vwap_price(const Order::Side& side, long total_quantity, uint32_t owner_id) {
         if (side == Order::Side::buy) {
-            auto it = ask_orders.begin();
-            while (it != ask_orders.end() && cum_quantity < total_quantity) {
-                if (it->second.get_owner() != owner) {
-                    auto price = it->second.get_price();
-                    long missing_quantity = total_quantity - cum_quantity;
-                    long quantity = std::min(it->second.get_open_quantity(), missing_quantity);
-                    vwap =
-                        ((quantity * price) + (vwap * cum_quantity))
-                        / (quantity + cum_quantity);
-                    cum_quantity += quantity;
-                }
-                ++it;
-            }
+            return level_vwap_price(ask_levels, total_quantity, owner_id);
         }
         else {
-            auto it = bid_orders.begin();
-            while (it != bid_orders.end() && cum_quantity < total_quantity) {
-                if (it->second.get_owner() != owner) {
-                    auto price = it->second.get_price();
+            return level_vwap_price(bid_levels, total_quantity, owner_id);
+        }
+    }
+
+    template<typename LevelMap>
+    double OrderMatcher::level_vwap_price(const LevelMap& levels, long total_quantity, uint32_t owner_id) const {
+        double vwap = 0;
+        long cum_quantity = 0;
+        for (auto it = levels.begin(); it != levels.end() && cum_quantity < total_quantity; ++it) {
+            auto price = price_scale.to_double(it->first);
+            for (auto node = it->second.head; node != nullptr && cum_quantity < total_quantity; node = node->next) {
+                if (node->order.get_owner_id() != owner_id) {
                     long missing_quantity = total_quantity - cum_quantity;
-                    long quantity = std::min(it->second.get_open_quantity(), missing_quantity);
+                    long quantity = std::min(node->order.get_open_quantity(), missing_quantity);
                     vwap =
                         ((quantity * price) + (vwap * cum_quantity))
                         / (quantity + cum_quantity);
                     cum_quantity += quantity;
                 }
-                ++it;
             }
         }
         return vwap;
     }
 
-
-    std::optional<Order> OrderMatcher::find(const std::string& ord_id, Order::Side side)
+    std::optional<Order> OrderMatcher::find(uint64_t ord_id, Order::Side side)
     {
         std::lock_guard<std::mutex> ul(mutex);
-        if (side == Order::buy)
-        {
-            bid_order_map_t::iterator i;
-            for (i = bid_orders.begin(); i != bid_orders.end(); ++i)
-                if (i->second.get_ord_id() == ord_id) return std::make_optional(i->second);
-        }
-        else if (side == Order::sell)
-        {
-            ask_order_map_t::iterator i;
-            for (i = ask_orders.begin(); i != ask_orders.end(); ++i)
-                if (i->second.get_ord_id() == ord_id) return std::make_optional(i->second);
+        auto node = index.find(ord_id);
+        if (node != nullptr && node->order.get_side() == side) {
+            return std::make_optional(node->order);
         }
         return std::optional<Order>();
-        throw std::runtime_error(std::format(
-            "OrderMatcher::find: could not find order_processed with ord_id={}, side={}",
-            ord_id, side == Order::buy ? "buy" : "sell"
-        ));
     }
 
     std::pair<typename OrderMatcher::bid_order_map_t, typename OrderMatcher::ask_order_map_t> OrderMatcher::get_orders() const {
         std::lock_guard<std::mutex> ul(mutex);
-        return std::make_pair(bid_orders, ask_orders);
+        bid_order_map_t bids;
+        ask_order_map_t asks;
+        for (const auto& [price, level] : bid_levels) {
+            for (auto node = level.head; node != nullptr; node = node->next) 
+                bids.insert(std::make_pair(price_scale.to_double(price), node->order));
+        }
+        for (const auto& [price, level] : ask_levels) {
+            for (auto node = level.head; node != nullptr; node = node->next)
+                asks.insert(std::make_pair(price_scale.to_double(price), node->order));
+        }
+        return std::make_pair(bids, asks);
     }
 
-
     typename OrderMatcher::bid_map_t OrderMatcher::bid_map(const std::function<double(const Order&)>& f) const 
     {
         std::lock_guard<std::mutex> ul(mutex);
         bid_map_t bids;
-        for (auto it = bid_orders.begin(); it != bid_orders.end(); ++it) {
-            bids[it->first] += f(it->second);
+        for (const auto& [price, level] : bid_levels) {
+            auto& value = bids[price_scale.to_double(price)];
+            for (auto node = level.head; node != nullptr; node = node->next)
+                value += f(node->order);
         }
         return bids;
     }
@@ -210,62 +306,129 @@ namespace common {
     {
         std::lock_guard<std::mutex> ul(mutex);
         ask_map_t asks;
-        for (auto it = ask_orders.begin(); it != ask_orders.end(); ++it) {
-            asks[it->first] += f(it->second);
+        for (const auto& [price, level] : ask_levels) {
+            auto& value = asks[price_scale.to_double(price)];
+            for (auto node = level.head; node != nullptr; node = node->next)
+                value += f(node->order);
         }
         return asks;
     }
 
+    namespace {
+
+        // zips the bid and ask levels side by side into book levels
+        template<typename BidLevels, typename AskLevels, typename Value>
+        void zip_levels(const BidLevels& bids, const AskLevels& asks, size_t max_levels, Value value, const PriceScale& price_scale, typename OrderMatcher::level_vector_t& levels) {
+            levels.clear();
+            auto bit = bids.begin();
+            auto ait = asks.begin();
+            while ((bit != bids.end() || ait != asks.end()) && (max_levels == 0 || levels.size() < max_levels)) {
+                BookLevel level;
+                if (bit != bids.end()) {
+                    level.bid_price = price_scale.to_double(bit->first);
+                    level.bid_volume = value(bit->second);
+                    ++bit;
+                }
+                if (ait != asks.end()) {
+                    level.ask_price = price_scale.to_double(ait->first);
+                    level.ask_volume = value(ait->second);
+                    ++ait;
+                }
+                levels.emplace_back(level);
+            }
+        }
+    }
+
     void OrderMatcher::book_levels(const std::function<double(const Order&)>& f, typename OrderMatcher::level_vector_t& levels) const {
-        bid_map_t bids = bid_map(f);
-        ask_map_t asks = ask_map(f);
+        std::lock_guard<std::mutex> ul(mutex);
+        zip_levels(bid_levels, ask_levels, 0, [&f](const PriceLevel& level) {
+            double value = 0;
+            for (auto node = level.head; node != nullptr; node = node->next)
+                value += f(node->order);
+            return value;
+        }, price_scale, levels);
+    }
+
+    void OrderMatcher::book_levels(typename OrderMatcher::level_vector_t& levels, size_t max_levels) const {
+        std::lock_guard<std::mutex> ul(mutex);
+        zip_levels(bid_levels, ask_levels, max_levels, [](const PriceLevel& level) {
+            return (double)level.open_quantity;
+        }, price_scale, levels);
+    }
+
+    template<typename LevelMap>
+    long OrderMatcher::level_open_quantity(const LevelMap& levels, const Price& price) const {
+        auto it = levels.find(price);
+        return it != levels.end() ? it->second.open_quantity : 0;
+    }
+
+    void OrderMatcher::depth(size_t max_levels, std::vector<DepthLevel>& levels) const {
+        std::lock_guard<std::mutex> ul(mutex);
         levels.clear();
+        for_each_level(bid_levels, max_levels, [&levels](const PriceLevel& level) {
+            levels.push_back(DepthLevel{ Order::Side::buy, level.price, level.open_quantity });
+        });
+        for_each_level(ask_levels, max_levels, [&levels](const PriceLevel& level) {
+            levels.push_back(DepthLevel{ Order::Side::sell, level.price, level.open_quantity });
+        });
+    }
 
-        if (bids.empty() && asks.empty()) {
-            return;
+    size_t OrderMatcher::level_aggregates(Order::Side side, std::span<LevelAggregate> levels) const {
+        size_t n = 0;
+        if (levels.empty()) {
+            return n;
         }
+        for_each_level(side, levels.size(), [&levels, &n](const PriceLevel& level) {
+            levels[n++] = LevelAggregate{ level.price, level.quantity, level.open_quantity, level.count };
+        });
+        return n;
+    }
 
-        auto bit = bids.begin();
-        auto ait = asks.begin();
-        while (true) {
-            BookLevel level;
-            if (bit != bids.end()) {
-                level.bid_price = bit->first;
-                level.bid_volume = bit->second;
-                ++bit;
-            }
-            if (ait != asks.end()) {
-                level.ask_price = ait->first;
-                level.ask_volume = ait->second;
-                ++ait;
-            }
-            levels.emplace_back(level);
-            if (bit == bids.end() && ait == asks.end()) {
-                break;
+    void OrderMatcher::track_level_changes(bool enabled) {
+        std::lock_guard<std::mutex> ul(mutex);
+        tracking_level_changes = enabled;
+        touched_levels.clear();
+    }
+
+    void OrderMatcher::drain_level_changes(std::vector<DepthLevel>& changes) {
+        std::lock_guard<std::mutex> ul(mutex);
+        changes.clear();
+        std::sort(touched_levels.begin(), touched_levels.end());
+        auto last = std::unique(touched_levels.begin(), touched_levels.end());
+        for (auto it = touched_levels.begin(); it != last; ++it) {
+            const auto& [side, price] = *it;
+            auto open_quantity = side == Order::Side::buy 
+                ? level_open_quantity(bid_levels, price) 
+                : level_open_quantity(ask_levels, price);
+            changes.push_back(DepthLevel{ side, price, open_quantity });
+        }
+        touched_levels.clear();
+    }
+
+    namespace {
+
+        void append_orders(std::string& rows, double price, const PriceLevel& level) {
+            for (auto node = level.head; node != nullptr; node = node->next) {
+                const auto& o = node->order;
+                auto side = o.get_side() == Order::Side::buy ? "bid" : "ask";
+                rows += std::format(
+                    "[{}] : symbol={}, owner={}, ord_id={}, cl_ord_id={}, price={:8.5f}, side={}, quantity={}, open_quantity={}, executed_quantity={}, avg_executed_price={:8.5f}, last_executed_price={:8.5f}, last_executed_quantity={}\n",
+                    price, o.get_symbol(), o.get_owner(), o.get_ord_id(), o.get_cl_ord_id(), o.get_price(), side, o.get_quantity(), o.get_open_quantity(), o.get_executed_quantity(), o.get_avg_executed_price(), o.get_last_executed_price(), o.get_last_executed_quantity()
+                );
             }
         }
     }
 
     std::string OrderMatcher::to_string() const {
-        auto [bids, asks] = get_orders();  
+        std::lock_guard<std::mutex> ul(mutex);
         std::string rows;
         rows += "OrderMatcher[\n";
-        for (auto ait = asks.begin(); ait != asks.end(); ++ait) {
-            const auto& o = ait->second;
-            auto side = o.get_side() == Order::Side::buy ? "bid" : "ask";
-            rows += std::format(
-                "[{}] : symbol={}, owner={}, ord_id={}, cl_ord_id={}, price={:8.5f}, side={}, quantity={}, open_quantity={}, executed_quantity={}, avg_executed_price={:8.5f}, last_executed_price={:8.5f}, last_executed_quantity={}\n",
-                ait->first, o.get_symbol(), o.get_owner(), o.get_ord_id(), o.get_cl_ord_id(), o.get_price(), side, o.get_quantity(), o.get_open_quantity(), o.get_executed_quantity(), o.get_avg_executed_price(), o.get_last_executed_price(), o.get_last_executed_quantity()
-            );
+        for (const auto& [price, level] : ask_levels) {
+            append_orders(rows, price_scale.to_double(price), level);
         }
         rows += "------------------------------------\n";
-        for (auto bit = bids.begin(); bit != bids.end(); ++bit) {
-            const auto& o = bit->second;
-            auto side = o.get_side() == Order::Side::buy ? "bid" : "ask";
-            rows += std::format(
-                "[{}] : symbol={}, owner={}, ord_id={}, cl_ord_id={}, price={:8.5f}, side={}, quantity={}, open_quantity={}, executed_quantity={}, avg_executed_price={:8.5f}, last_executed_price={:8.5f}, last_executed_quantity={}\n",
-                bit->first, o.get_symbol(), o.get_owner(), o.get_ord_id(), o.get_cl_ord_id(), o.get_price(), side, o.get_quantity(), o.get_open_quantity(), o.get_executed_quantity(), o.get_avg_executed_price(), o.get_last_executed_price(), o.get_last_executed_quantity()
-            );
+        for (const auto& [price, level] : bid_levels) {
+            append_orders(rows, price_scale.to_double(price), level);
         }
         rows += "]";
         return rows;
@@ -3,7 +3,10 @@
 
 #include "pch.h"
 
+#include <span>
+
 #include "order.h"
+#include "object_pool.h"
 #include "market_data.h"
 
 namespace common {
@@ -19,6 +22,121 @@ namespace common {
 		bool error;
 	};
 
+	/*
+	 * Resting orders are kept per price level in an intrusive FIFO queue, which implements
+	 * price time priority. The order nodes come from a slab pool and are linked into an 
+	 * intrusive hash index on the order id so that find, erase and amend do not have to 
+	 * walk the book and resting an order does not allocate.
+	 */
+	struct PriceLevel;
+
+	struct OrderNode {
+		explicit OrderNode(const Order& order) : order(order) {}
+
+		Order order;
+		OrderNode* prev{ nullptr };
+		OrderNode* next{ nullptr };
+		OrderNode* hash_next{ nullptr };
+		PriceLevel* level{ nullptr };
+	};
+
+	class OrderIndex {
+	public:
+		explicit OrderIndex(size_t bucket_count = 1024);
+
+		OrderNode* find(uint64_t ord_id) const;
+
+		bool contains(uint64_t ord_id) const;
+
+		void insert(OrderNode* node);
+
+		void erase(OrderNode* node);
+
+		size_t size() const;
+
+	private:
+		size_t bucket(uint64_t ord_id) const;
+
+		void rehash(size_t bucket_count);
+
+		std::vector<OrderNode*> buckets;
+		size_t mask;
+		size_t count{ 0 };
+	};
+
+	/*
+	 * The level keeps the totals of its orders up to date on every change, 
+	 * so that depth queries do not have to walk the orders.
+	 */
+	struct PriceLevel {
+		explicit PriceLevel(const Price& price) : price(price) {}
+
+		void push_back(OrderNode* node);
+
+		void unlink(OrderNode* node);
+
+		// an order of the level executed the given quantity
+		void executed(long quantity) { open_quantity -= quantity; }
+
+		// an order of the level changed its quantity and open quantity by the given deltas
+		void amended(long quantity_delta, long open_quantity_delta) {
+			quantity += quantity_delta;
+			open_quantity += open_quantity_delta;
+		}
+
+		bool empty() const { return head == nullptr; }
+
+		Price price;
+		OrderNode* head{ nullptr };
+		OrderNode* tail{ nullptr };
+		size_t count{ 0 };
+		long quantity{ 0 };
+		long open_quantity{ 0 };
+	};
+
+	// copy of the totals of a price level
+	struct LevelAggregate {
+		Price price;
+		long quantity;
+		long open_quantity;
+		size_t count;
+	};
+
+	/*
+	 * Fill record reported to match listeners. The orders point into the matcher and are only 
+	 * valid during the callback. The maker is null for market orders executed at the book vwap.
+	 */
+	struct Fill {
+		const Order* maker;
+		const Order* taker;
+		Price price;
+		double exec_price;
+		long quantity;
+	};
+
+	/*
+	 * Aggregated open quantity of a price level. As a level change an open quantity of zero 
+	 * reports that the level was removed.
+	 */
+	struct DepthLevel {
+		Order::Side side;
+		Price price;
+		long open_quantity;
+	};
+
+	/*
+	 * Receives acks, fills, cancels and rejects of the matcher while its lock is held, so a 
+	 * listener should only record the events and act on them after the call returned. 
+	 * A limit order that rests is acknowledged after its fills with its state after matching.
+	 */
+	template<typename T>
+	concept MatchListener = requires(T listener, const Order& order, const Fill& fill) {
+		listener.on_accept(order);
+		listener.on_fill(fill);
+		listener.on_cancel(order);
+		listener.on_reject(order);
+	};
+
 	class OrderMatcher
 	{
 	public:
@@ -31,7 +149,12 @@ namespace common {
 		typedef std::map<double, double, std::less<double>> ask_map_t;
 		typedef std::vector<BookLevel> level_vector_t;
 
-		explicit OrderMatcher(std::mutex& mutex);
+		typedef std::map<Price, PriceLevel, std::greater<Price>> bid_level_map_t;
+		typedef std::map<Price, PriceLevel, std::less<Price>> ask_level_map_t;
+
+		explicit OrderMatcher(const PriceScale& price_scale);
+
+		~OrderMatcher();
 
 		OrderMatcher(const OrderMatcher&) = delete;
 
@@ -39,11 +162,20 @@ namespace common {
 
 		OrderInsertResult insert(const Order& order);
 
-		std::optional<Order> find(const std::string& ord_id, Order::Side side);
+		template<MatchListener Listener>
+		bool insert(const Order& order, Listener& listener);
+
+		std::optional<Order> find(uint64_t ord_id, Order::Side side);
+
+		std::optional<Order> erase(uint64_t ord_id, const Order::Side& side);
+
+		template<MatchListener Listener>
+		bool erase(uint64_t ord_id, const Order::Side& side, Listener& listener);
 
-		std::optional<Order> erase(const std::string& ord_id, const Order::Side& side);
+		// amends the total quantity of a resting order, reducing it keeps time priority
+		std::optional<Order> amend(uint64_t ord_id, long quantity);
 
-		double vwap_price(const Order::Side& side, long quantity, const std::string& owner);
+		double vwap_price(const Order::Side& side, long quantity, uint32_t owner_id);
 
 		std::pair<bid_order_map_t, ask_order_map_t> get_orders() const;
 
@@ -53,24 +185,185 @@ namespace common {
 
 		void book_levels(const std::function<double(const Order&)> &f, level_vector_t& levels) const;
 
+		// book levels of the open quantity from the level totals, zero max_levels for the full book
+		void book_levels(level_vector_t& levels, size_t max_levels = 0) const;
+
+		// best max_levels bid levels followed by the best max_levels ask levels, zero for the full book
+		void depth(size_t max_levels, std::vector<DepthLevel>& levels) const;
+
+		// copies the totals of the best levels of a side into the caller's buffer, returns the number of levels written
+		size_t level_aggregates(Order::Side side, std::span<LevelAggregate> levels) const;
+
+		// calls op with each of the best max_levels levels of a side, zero for all, while the lock is held
+		template<typename Op>
+		void for_each_level(Order::Side side, size_t max_levels, Op op) const;
+
+		// records the price levels touched by inserts, fills, amends and cancels
+		void track_level_changes(bool enabled);
+
+		// current aggregates of the levels touched since the last call, replaces the content of changes
+		void drain_level_changes(std::vector<DepthLevel>& changes);
+
 		static int by_quantity(const Order& o);
 		
 		static int by_open_quantity(const Order& o);
 
 		static int by_last_exec_quantity(const Order& o);
 
+		const PriceScale& get_price_scale() const;
+
 		std::string to_string() const;
 
 	protected:
-		std::mutex& mutex;
+		mutable std::mutex mutex;
+		PriceScale price_scale;
 
 	private:
-		void match(Order& order, std::vector<Order>&);
+		template<typename RestingLevels, typename MatchingLevels, typename Crosses, typename Listener>
+		void insert_limit(RestingLevels& resting, MatchingLevels& matching, Order& order, Crosses crosses, Listener& listener);
+
+		template<typename LevelMap, typename Crosses, typename Listener>
+		void match_levels(LevelMap& levels, Order& order, Crosses crosses, Listener& listener);
+
+		template<typename LevelMap>
+		double level_vwap_price(const LevelMap& levels, long total_quantity, uint32_t owner_id) const;
+
+		template<typename LevelMap>
+		void rest(LevelMap& levels, const Order& order);
 
-		bid_order_map_t bid_orders;
-		ask_order_map_t ask_orders;
+		void remove(OrderNode* node);
+
+		void touch(Order::Side side, const Price& price);
+
+		template<typename LevelMap>
+		long level_open_quantity(const LevelMap& levels, const Price& price) const;
+
+		template<typename LevelMap, typename Op>
+		static void for_each_level(const LevelMap& levels, size_t max_levels, Op op);
+
+		bid_level_map_t bid_levels;
+		ask_level_map_t ask_levels;
+		ObjectPool<OrderNode> nodes;
+		OrderIndex index;
+		bool tracking_level_changes{ false };
+		std::vector<std::pair<Order::Side, Price>> touched_levels;
 	};
 
+	template<MatchListener Listener>
+	inline bool OrderMatcher::insert(const Order& order, Listener& listener) {
+		std::lock_guard<std::mutex> ul(mutex);
+		auto order_processed = order;
+
+		if (order_processed.get_type() == Order::Type::market) {
+			auto vwap = vwap_price(order.get_side(), order.get_open_quantity(), order.get_owner_id());
+			order_processed.execute(vwap, order.get_open_quantity());
+			listener.on_fill(Fill{ nullptr, &order_processed, price_scale.to_price(vwap), vwap, order_processed.get_last_executed_quantity() });
+			return true;
+		}
+
+		if (index.contains(order_processed.get_ord_id())) {
+			listener.on_reject(order_processed);
+			return false;
+		}
+
+		order_processed.set_tick_price(price_scale.to_price(order_processed.get_price()));
+		const auto& price = order_processed.get_tick_price();
+		if (order_processed.get_side() == Order::buy) {
+			insert_limit(bid_levels, ask_levels, order_processed, [&price](const Price& level_price) { return level_price <= price; }, listener);
+		}
+		else {
+			insert_limit(ask_levels, bid_levels, order_processed, [&price](const Price& level_price) { return level_price >= price; }, listener);
+		}
+		return true;
+	}
+
+	template<MatchListener Listener>
+	inline bool OrderMatcher::erase(uint64_t ord_id, const Order::Side& side, Listener& listener) {
+		std::lock_guard<std::mutex> ul(mutex);
+		auto node = index.find(ord_id);
+		if (node == nullptr || node->order.get_side() != side) {
+			return false;
+		}
+
+		listener.on_cancel(node->order);
+		remove(node);
+		return true;
+	}
+
+	template<typename RestingLevels, typename MatchingLevels, typename Crosses, typename Listener>
+	inline void OrderMatcher::insert_limit(RestingLevels& resting, MatchingLevels& matching, Order& order, Crosses crosses, Listener& listener) {
+		match_levels(matching, order, crosses, listener);
+
+		if (!order.is_closed()) {
+			rest(resting, order);
+			listener.on_accept(order);
+		}
+	}
+
+	template<typename LevelMap, typename Crosses, typename Listener>
+	inline void OrderMatcher::match_levels(LevelMap& levels, Order& order, Crosses crosses, Listener& listener) {
+		auto it = levels.begin();
+		while (it != levels.end() && crosses(it->first) && !order.is_closed()) {
+			auto& level = it->second;
+			auto exec_price = price_scale.to_double(it->first);
+			auto node = level.head;
+			while (node != nullptr && !order.is_closed()) {
+				auto next = node->next;
+				auto& maker = node->order;
+				long quantity = std::min(maker.get_open_quantity(), order.get_open_quantity());
+				maker.execute(exec_price, quantity);
+				order.execute(exec_price, quantity);
+				level.executed(quantity);
+				touch(maker.get_side(), it->first);
+				listener.on_fill(Fill{ &maker, &order, it->first, exec_price, quantity });
+
+				if (maker.is_closed()) {
+					level.unlink(node);
+					index.erase(node);
+					nodes.destroy(node);
+				}
+				node = next;
+			}
+
+			if (level.empty())
+				it = levels.erase(it);
+			else
+				++it;
+		}
+	}
+
+	template<typename LevelMap>
+	inline void OrderMatcher::rest(LevelMap& levels, const Order& order) {
+		auto node = nodes.create(order);
+		index.insert(node);
+		auto [lit, created] = levels.try_emplace(order.get_tick_price(), order.get_tick_price());
+		lit->second.push_back(node);
+		touch(order.get_side(), order.get_tick_price());
+	}
+
+	inline void OrderMatcher::touch(Order::Side side, const Price& price) {
+		if (tracking_level_changes) {
+			touched_levels.emplace_back(side, price);
+		}
+	}
+
+	template<typename Op>
+	inline void OrderMatcher::for_each_level(Order::Side side, size_t max_levels, Op op) const {
+		std::lock_guard<std::mutex> ul(mutex);
+		if (side == Order::Side::buy)
+			for_each_level(bid_levels, max_levels, op);
+		else
+			for_each_level(ask_levels, max_levels, op);
+	}
+
+	template<typename LevelMap, typename Op>
+	inline void OrderMatcher::for_each_level(const LevelMap& levels, size_t max_levels, Op op) {
+		size_t n = 0;
+		for (auto it = levels.begin(); it != levels.end() && (max_levels == 0 || n < max_levels); ++it, ++n) {
+			op(it->second);
+		}
+	}
+
 	std::string to_string(const typename OrderMatcher::level_vector_t& levels);
 
 	template<typename Op>
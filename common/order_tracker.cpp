@@ -1,14 +1,90 @@
 #include "pch.h"
 
+#include <charconv>
+
 #include "order_tracker.h"
+#include "interner.h"
 
 #include "spdlog/spdlog.h"
 
 namespace common {
 
+	namespace {
+
+		// quotes a field of the spill file if it contains a separator, a quote or a line break
+		std::string csv_field(const std::string& value) {
+			if (value.find_first_of(",\"\r\n") == std::string::npos) {
+				return value;
+			}
+			std::string quoted = "\"";
+			for (auto c : value) {
+				if (c == '"') {
+					quoted += '"';
+				}
+				quoted += c;
+			}
+			quoted += '"';
+			return quoted;
+		}
+
+		// parses the whole field as a double, false for an empty, partial or out of range number
+		bool parse_double(const std::string& field, double& value) {
+			auto end = field.data() + field.size();
+			auto [ptr, ec] = std::from_chars(field.data(), end, value);
+			return ec == std::errc() && ptr == end;
+		}
+
+		// reads the next record written with csv_field, quoted fields may span lines
+		bool read_csv_record(std::istream& in, std::vector<std::string>& cols) {
+			cols.clear();
+			std::string line;
+			if (!std::getline(in, line)) {
+				return false;
+			}
+			std::string col;
+			auto quoted = false;
+			size_t i = 0;
+			while (true) {
+				if (i == line.size()) {
+					if (quoted && std::getline(in, line)) {
+						col += '\n';
+						i = 0;
+						continue;
+					}
+					break;
+				}
+				auto c = line[i++];
+				if (quoted) {
+					if (c == '"' && i < line.size() && line[i] == '"') {
+						col += '"';
+						++i;
+					}
+					else if (c == '"') {
+						quoted = false;
+					}
+					else {
+						col += c;
+					}
+				}
+				else if (c == '"') {
+					quoted = true;
+				}
+				else if (c == ',') {
+					cols.push_back(std::move(col));
+					col.clear();
+				}
+				else {
+					col += c;
+				}
+			}
+			cols.push_back(std::move(col));
+			return true;
+		}
+	}
+
 	OrderReport::OrderReport(
 		const ExecReport& report
-	) : symbol(report.symbol)
+	) : symbol_id(symbol_interner().intern(report.symbol))
 	  , ord_id(report.ord_id)
 	  , cl_ord_id(report.cl_ord_id)
 	  , ord_type(report.ord_type)
@@ -20,9 +96,7 @@ namespace common {
 	  , order_qty(report.order_qty)
 	  , cum_qty(report.cum_qty)
 	  , leaves_qty(report.leaves_qty)
-      , custom_1(report.custom_1)
-	  , custom_2(report.custom_2)
-	  , custom_3(report.custom_3)
+	  , custom_1(report.custom_1)
 	{}
 
 	OrderReport::OrderReport(
@@ -38,7 +112,7 @@ namespace common {
 		double order_qty,
 		double cum_qty,
 		double leaves_qty
-	) : symbol(symbol)
+	) : symbol_id(symbol_interner().intern(symbol))
 	  , ord_id(ord_id)
 	  , cl_ord_id(cl_ord_id)
 	  , ord_type(ord_type)
@@ -53,6 +127,10 @@ namespace common {
 	{}
 
 
+	const std::string& OrderReport::get_symbol() const {
+		return symbol_interner().lookup(symbol_id);
+	}
+
 	bool OrderReport::is_sell() const {
 		return side == FIX::Side_SELL;
 	}
@@ -69,13 +147,18 @@ namespace common {
 		return ord_status == FIX::OrdStatus_CANCELED;
 	}
 
+	bool OrderReport::is_terminal() const {
+		return ord_status == FIX::OrdStatus_FILLED
+			|| ord_status == FIX::OrdStatus_CANCELED
+			|| ord_status == FIX::OrdStatus_REJECTED
+			|| ord_status == FIX::OrdStatus_EXPIRED;
+	}
+
 	std::string OrderReport::to_string(const std::string& c1, const std::string& c2, const std::string& c3) const {
 		std::stringstream ss;	
 		auto h1 = c1 == "" ? "custom_1=" : (c1 + "=");
-		auto h2 = c2 == "" ? "custom_2=" : (c2 + "=");
-		auto h3 = c3 == "" ? "custom_3=" : (c3 + "=");
 		ss << "OrderReport[" 
-		   << "symbol=" << symbol << ", "
+		   << "symbol=" << get_symbol() << ", "
 		   << "ord_id=" << ord_id << ", "
 		   << "cl_ord_id=" << cl_ord_id << ", "
 		   << "ord_status=" << ord_status_string(ord_status) << ", "
@@ -87,9 +170,7 @@ namespace common {
 		   << "order_qty=" << std::to_string(order_qty) << ", "
 		   << "cum_qty=" << std::to_string(cum_qty) << ", "
 		   << "leaves_qty=" << std::to_string(leaves_qty) << ", "
-		   << h1 << custom_1 << ", "
-		   << h2 << custom_2 << ", "
-		   << h3 << custom_3
+		   << h1 << custom_1
 		   << "]";
 		return ss.str();
 	}
@@ -148,7 +229,14 @@ namespace common {
 		return ostream << pos.to_string();
 	}
 
-	OrderTracker::OrderTracker(const std::string& account) : account(account) {}
+	OrderTracker::OrderTracker(
+		const std::string& account,
+		size_t max_terminal_orders,
+		const std::string& spill_file
+	) : account(account)
+	  , max_terminal_orders(max_terminal_orders)
+	  , spill_file(spill_file)
+	{}
 
 	NetPosition& OrderTracker::get_net_position(const std::string& symbol) {
 		auto it = position_by_symbol.find(symbol);
@@ -171,9 +259,23 @@ namespace common {
 		return position_by_symbol;
 	}
 
-	std::pair<typename OrderTracker::const_iterator, bool> OrderTracker::get_order(const std::string& ord_id) const {
+	std::pair<typename OrderTracker::const_iterator, bool> OrderTracker::get_order(const std::string& ord_id) {
 		auto it = orders_by_ord_id.find(ord_id);
-		return std::make_pair(it, it != orders_by_ord_id.end());
+		if (it != orders_by_ord_id.end()) {
+			return std::make_pair(it, true);
+		}
+
+		auto evicted = find_evicted_order(ord_id);
+		if (!evicted.has_value()) {
+			return std::make_pair(orders_by_ord_id.cend(), false);
+		}
+
+		// retained again until the next eviction, the limit is enforced when the next order becomes terminal
+		it = orders_by_ord_id.emplace(ord_id, std::move(evicted.value())).first;
+		terminal_ord_ids.push_back(ord_id);
+		restored_ord_ids.insert(ord_id);
+		++num_terminal;
+		return std::make_pair(it, true);
 	}
 
 	int OrderTracker::num_order_reports() const {
@@ -184,12 +286,115 @@ namespace common {
 		return static_cast<int>(position_by_symbol.size());
 	}
 
+	int OrderTracker::num_terminal_orders() const {
+		return static_cast<int>(num_terminal);
+	}
+
+	int OrderTracker::num_evicted_orders() const {
+		return static_cast<int>(num_spilled);
+	}
+
+	void OrderTracker::update_order(const ExecReport& report) {
+		auto it = orders_by_ord_id.find(report.ord_id);
+		auto was_terminal = false;
+		if (it == orders_by_ord_id.end()) {
+			it = orders_by_ord_id.emplace(report.ord_id, OrderReport(report)).first;
+		}
+		else {
+			was_terminal = it->second.is_terminal();
+			it->second = OrderReport(report);
+		}
+
+		if (!was_terminal && it->second.is_terminal()) {
+			terminal_ord_ids.push_back(report.ord_id);
+			++num_terminal;
+			evict_terminal_orders();
+		}
+		else if (was_terminal && !it->second.is_terminal()) {
+			// rare, e.g. a restated order, so the linear removal does not matter
+			--num_terminal;
+			std::erase(terminal_ord_ids, report.ord_id);
+			restored_ord_ids.erase(report.ord_id);
+		}
+	}
+
+	void OrderTracker::evict_terminal_orders() {
+		while (num_terminal > max_terminal_orders && !terminal_ord_ids.empty()) {
+			auto ord_id = std::move(terminal_ord_ids.front());
+			terminal_ord_ids.pop_front();
+			--num_terminal;
+			auto it = orders_by_ord_id.find(ord_id);
+			if (it == orders_by_ord_id.end()) {
+				continue;
+			}
+
+			// an order read back from the spill file is still in there
+			auto restored = restored_ord_ids.erase(ord_id) > 0;
+			if (!spill_file.empty() && !restored) {
+				if (!spill.is_open()) {
+					spill.open(spill_file, std::ios::out | std::ios::app);
+				}
+				const auto& order = it->second;
+				spill << std::format(
+					"{},{},{},{},{},{},{},{},{},{},{},{},{}\n",
+					csv_field(order.ord_id), csv_field(order.cl_ord_id), csv_field(order.get_symbol()), 
+					order.ord_type, order.ord_status, order.side, order.tif,
+					order.price, order.avg_px, order.order_qty, order.cum_qty, order.leaves_qty, csv_field(order.custom_1)
+				);
+				spill.flush();
+			}
+
+			orders_by_ord_id.erase(it);
+			if (!restored) {
+				++num_spilled;
+			}
+		}
+	}
+
+	std::optional<OrderReport> OrderTracker::find_evicted_order(const std::string& ord_id) const {
+		if (spill_file.empty()) {
+			return std::optional<OrderReport>();
+		}
+
+		std::ifstream in(spill_file);
+		std::vector<std::string> cols;
+		while (read_csv_record(in, cols)) {
+			if (cols.empty() || cols[0] != ord_id) {
+				continue;
+			}
+			if (cols.size() < 12 || cols[3].size() != 1 || cols[4].size() != 1 || cols[5].size() != 1 || cols[6].size() != 1) {
+				continue;
+			}
+			// a damaged row, e.g. from a crash while writing, must not fail the lookup of the order
+			double values[5];
+			auto parsed = true;
+			for (size_t i = 0; i < 5 && parsed; ++i) {
+				parsed = parse_double(cols[7 + i], values[i]);
+			}
+			if (!parsed) {
+				spdlog::warn("OrderTracker[{}]::find_evicted_order: skipping damaged spill row of ord_id={}", account, ord_id);
+				continue;
+			}
+			OrderReport order(
+				cols[2], cols[0], cols[1], cols[3][0], cols[4][0], cols[5][0], cols[6][0],
+				values[0], values[1], values[2], values[3], values[4]
+			);
+			if (cols.size() > 12) {
+				order.custom_1 = cols[12];
+			}
+			return order;
+		}
+		return std::optional<OrderReport>();
+	}
+
 	bool OrderTracker::process(const ExecReport& report) {
 		if (report.exec_type == 'I') {
 			return false;
 		}
 
-		spdlog::debug("OrderTracker[{}]::process: processing report {}", account, report.to_string());
+		if (spdlog::should_log(spdlog::level::debug)) {
+			spdlog::debug("OrderTracker[{}]::process: processing report {}", account, report.to_string());
+		}
 
 		switch (report.exec_type) {
 			case FIX::ExecType_PENDING_NEW: {
@@ -206,19 +411,20 @@ namespace common {
 
 			case FIX::ExecType_NEW: {
 				pending_orders_by_cl_ord_id.erase(report.cl_ord_id);
-				auto [_, inserted] = orders_by_ord_id.emplace(report.ord_id, std::move(OrderReport(report)));
-				if (!inserted) {
+				if (orders_by_ord_id.contains(report.ord_id)) {
 					spdlog::error(
 						"OrderTracker[{}]::process[FIX::ExecType_NEW]: failed to insert ord_id={} report={}", 
 						account, report.ord_id, report.to_string()
 					);
 					return false;
 				}
+				update_order(report);
 				return true;
 			}
 
 			case FIX::ExecType_TRADE: {
-				orders_by_ord_id.insert_or_assign(report.ord_id, std::move(OrderReport(report)));
+				pending_orders_by_cl_ord_id.erase(report.cl_ord_id);
+				update_order(report);
 				if (report.ord_status == FIX::OrdStatus_FILLED || report.ord_status == FIX::OrdStatus_PARTIALLY_FILLED) {
 					auto& position = get_net_position(report.symbol);
 					if (report.side == FIX::Side_BUY) {
@@ -243,21 +449,22 @@ namespace common {
 			}
 
 			case FIX::ExecType_PENDING_CANCEL: {
-				orders_by_ord_id.insert_or_assign(report.ord_id, std::move(OrderReport(report)));
+				update_order(report);
 				return true;
 			}
 
 			case FIX::ExecType_REPLACED: {
-				orders_by_ord_id.insert_or_assign(report.ord_id, std::move(OrderReport(report)));
+				update_order(report);
 				return true;
 			}
 
 			case FIX::ExecType_CANCELED: {
-				orders_by_ord_id.insert_or_assign(report.ord_id, std::move(OrderReport(report)));
+				update_order(report);
 				return true;
 			}
 
 			case FIX::ExecType_REJECTED: {
+				pending_orders_by_cl_ord_id.erase(report.cl_ord_id);
 				spdlog::warn("OrderTracker[{}]::process[FIX::ExecType_REJECTED]: rejected {}", account, report.to_string());
 				return true;
 			}
@@ -286,9 +493,22 @@ namespace common {
 				rows += std::format("    cl_ord_id={} order={}\n", cl_ord_id, order.to_string(c1, c2, c3));
 			}
 		}
+		// open orders and only the most recent terminal ones, the output must not grow with the session
+		constexpr size_t max_terminal_shown = 10;
 		rows += "  orders:\n";
 		for (auto& [ord_id, order] : orders_by_ord_id) {
-			rows += std::format("    ord_id={} order={}\n", ord_id, order.to_string(c1, c2, c3));
+			if (!order.is_terminal()) {
+				rows += std::format("    ord_id={} order={}\n", ord_id, order.to_string(c1, c2, c3));
+			}
+		}
+		rows += std::format("  terminal orders: retained={} evicted={}\n", num_terminal, num_spilled);
+		size_t shown = 0;
+		for (auto it = terminal_ord_ids.rbegin(); it != terminal_ord_ids.rend() && shown < max_terminal_shown; ++it) {
+			auto oit = orders_by_ord_id.find(*it);
+			if (oit != orders_by_ord_id.end() && oit->second.is_terminal()) {
+				rows += std::format("    ord_id={} order={}\n", *it, oit->second.to_string(c1, c2, c3));
+				++shown;
+			}
 		}
 		rows += "  positions:\n";
 		for (auto& [symbol, pos] : position_by_symbol) {
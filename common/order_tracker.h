@@ -1,10 +1,14 @@
 #ifndef ORDER_TRACKER_H
 #define ORDER_TRACKER_H
 
+#include <deque>
 #include <string>
 #include <iomanip>
 #include <ostream>
+#include <fstream>
+#include <optional>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "quickfix/FixValues.h"
 
@@ -12,6 +16,10 @@
 
 namespace common {
 
+	/*
+	 * Compact order state, the symbol is interned and only the first custom field of the exec
+	 * report, e.g. the FXCM position id, is kept.
+	 */
 	class OrderReport
 	{
 		friend std::ostream& operator<<(std::ostream&, const OrderReport&);
@@ -37,7 +45,7 @@ namespace common {
 			double leaves_qty
 		);
 
-		std::string symbol{};
+		uint32_t symbol_id{};
 		std::string ord_id{};
 		std::string cl_ord_id{};
 		char ord_type{ FIX::OrdType_MARKET };
@@ -49,9 +57,9 @@ namespace common {
 		double order_qty{ 0 };
 		double cum_qty{ 0 };
 		double leaves_qty{ 0 };
-		std::string custom_1{} ;
-		std::string custom_2{};
-		std::string custom_3{};
+		std::string custom_1{};
+
+		const std::string& get_symbol() const;
 
 		bool is_buy() const;
 
@@ -61,6 +69,9 @@ namespace common {
 
 		bool is_cancelled() const;
 
+		// filled, canceled, rejected or expired, no further exec reports are expected
+		bool is_terminal() const;
+
 		std::string to_string(const std::string& c1 = "", const std::string& c2 = "", const std::string& c3 = "") const;
 	};
 
@@ -107,16 +118,40 @@ namespace common {
 
 	std::ostream& operator<<(std::ostream&, const Position&);
 
+	/*
+	 * Tracks orders and net positions from exec reports. Open order and position lookups are O(1).
+	 * Only the most recent max_terminal_orders terminal orders are retained, older ones are
+	 * evicted in the order they became terminal and, if a spill file is given, appended to it
+	 * as a CSV line so that memory stays flat however long the session runs. A lookup of an
+	 * evicted order reads it back from the spill file and retains it again.
+	 */
 	class OrderTracker {
 		std::string account;
+		size_t max_terminal_orders;
+		std::string spill_file;
 		std::unordered_map<std::string, NetPosition> position_by_symbol;
 		std::unordered_map<std::string, OrderReport> pending_orders_by_cl_ord_id;
 		std::unordered_map<std::string, OrderReport> orders_by_ord_id;
+		std::deque<std::string> terminal_ord_ids; // exactly the retained terminal orders, oldest first
+		std::unordered_set<std::string> restored_ord_ids; // read back from the spill file, not spilled again
+		std::ofstream spill;
+		size_t num_terminal{ 0 };
+		size_t num_spilled{ 0 };
+
+		void update_order(const ExecReport& report);
+
+		void evict_terminal_orders();
 
 	public:
 		typedef typename std::unordered_map<std::string, OrderReport>::const_iterator const_iterator;
 
-		OrderTracker(const std::string& account);
+		static constexpr size_t default_max_terminal_orders = 10000;
+
+		OrderTracker(
+			const std::string& account,
+			size_t max_terminal_orders = default_max_terminal_orders,
+			const std::string& spill_file = ""
+		);
 
 		void set_account(const std::string& account);
 
@@ -126,7 +161,8 @@ namespace common {
 
 		std::pair<typename OrderTracker::const_iterator, bool> get_pending_order(const std::string& ord_id) const;
 
-		std::pair<typename OrderTracker::const_iterator, bool> get_order(const std::string& ord_id) const;
+		// falls back to the spill file for evicted orders
+		std::pair<typename OrderTracker::const_iterator, bool> get_order(const std::string& ord_id);
 
 		const std::unordered_map<std::string, OrderReport>& get_orders() const;
 
@@ -136,6 +172,15 @@ namespace common {
 
 		int num_net_positions() const;
 
+		// terminal orders currently retained in memory
+		int num_terminal_orders() const;
+
+		// terminal orders evicted so far
+		int num_evicted_orders() const;
+
+		// scans the spill file, only meant for the rare lookup of an evicted order
+		std::optional<OrderReport> find_evicted_order(const std::string& ord_id) const;
+
 		bool process(const ExecReport& report);
 
 		std::string to_string(const std::string& c1 = "", const std::string& c2 = "", const std::string& c3 = "") const;
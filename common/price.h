@@ -0,0 +1,71 @@
+#ifndef PRICE_H
+#define PRICE_H
+
+#include "pch.h"
+
+namespace common {
+
+	const uint32_t TO_PIPS = 10000;
+	const uint32_t TO_POINTS = 10 * TO_PIPS;
+
+	/*
+	 * Fixed point price expressed as an integer number of ticks.
+	 */
+	class Price {
+	public:
+		constexpr Price() = default;
+
+		constexpr explicit Price(int64_t ticks) : ticks(ticks) {}
+
+		constexpr int64_t get_ticks() const { return ticks; }
+
+		constexpr auto operator<=>(const Price&) const = default;
+
+		constexpr Price operator+(const Price& other) const { return Price(ticks + other.ticks); }
+
+		constexpr Price operator-(const Price& other) const { return Price(ticks - other.ticks); }
+
+		std::string to_string() const {
+			return std::to_string(ticks);
+		}
+
+	private:
+		int64_t ticks{ 0 };
+	};
+
+	/*
+	 * Converts floating point prices to ticks and back using the per symbol tick_scale,
+	 * which is the inverse of the tick_size. Prices are rounded to the nearest tick.
+	 */
+	class PriceScale {
+	public:
+		constexpr PriceScale() = default;
+
+		constexpr explicit PriceScale(double tick_scale) : tick_scale(tick_scale) {}
+
+		static PriceScale from_tick_size(double tick_size) {
+			return PriceScale(std::round(1.0 / tick_size));
+		}
+
+		Price to_price(double price) const {
+			return Price(std::llround(price * tick_scale));
+		}
+
+		double to_double(const Price& price) const {
+			return static_cast<double>(price.get_ticks()) / tick_scale;
+		}
+
+		double round(double price) const {
+			return to_double(to_price(price));
+		}
+
+		double get_tick_scale() const { return tick_scale; }
+
+		double get_tick_size() const { return 1.0 / tick_scale; }
+
+	private:
+		double tick_scale{ TO_POINTS };
+	};
+}
+
+#endif
@@ -16,13 +16,14 @@ namespace common {
     protected:
 
        std::string symbol;
-       std::mt19937& gen;
+       std::mt19937 gen;
 
     public:
 
         typedef std::map<std::chrono::nanoseconds, TopOfBook> history_t;
 
-        PriceSampler(const std::string& symbol, std::mt19937& gen) : symbol(symbol), gen(gen) {}
+        // each sampler owns its generator seeded from the shared one so that markets can sample concurrently
+        PriceSampler(const std::string& symbol, std::mt19937& seed_gen) : symbol(symbol), gen(seed_gen()) {}
 
         const std::string& get_symbol() const {
            return symbol;
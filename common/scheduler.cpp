@@ -0,0 +1,168 @@
+#include "pch.h"
+
+#include "scheduler.h"
+
+#include "spdlog/spdlog.h"
+
+namespace common {
+
+    std::chrono::nanoseconds Scheduler::TaskStatistics::avg_duration() const {
+        return runs > 0 ? total_duration / static_cast<int64_t>(runs) : std::chrono::nanoseconds(0);
+    }
+
+    std::string Scheduler::TaskStatistics::to_string() const {
+        using namespace std::chrono;
+        return std::format(
+            "{}: period={}ms runs={} skipped={} avg={}us max={}us last={}us max_lag={}us",
+            name,
+            duration_cast<milliseconds>(period).count(),
+            runs,
+            skipped,
+            duration_cast<microseconds>(avg_duration()).count(),
+            duration_cast<microseconds>(max_duration).count(),
+            duration_cast<microseconds>(last_duration).count(),
+            duration_cast<microseconds>(max_lag).count()
+        );
+    }
+
+    Scheduler::Scheduler(size_t num_workers, const std::shared_ptr<Clock>& clock)
+        : worker_count(std::max<size_t>(num_workers, 1))
+        , clock(clock)
+    {}
+
+    Scheduler::~Scheduler() {
+        stop();
+    }
+
+    size_t Scheduler::add(const std::string& name, std::chrono::nanoseconds period, task_t task) {
+        std::lock_guard<std::mutex> ul(mutex);
+        if (running) {
+            throw std::runtime_error(std::format("Scheduler::add: cannot add task {} while running", name));
+        }
+        if (period <= std::chrono::nanoseconds(0)) {
+            throw std::runtime_error(std::format("Scheduler::add: invalid period for task {}", name));
+        }
+        tasks.emplace_back(Task{ name, period, std::move(task), TaskStatistics{ name, period } });
+        return tasks.size() - 1;
+    }
+
+    void Scheduler::start() {
+        std::lock_guard<std::mutex> ul(mutex);
+        if (running) {
+            return;
+        }
+        running = true;
+        auto now = clock->now();
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            due.emplace(now + tasks[i].period, i);
+        }
+        for (size_t i = 0; i < worker_count; ++i) {
+            workers.emplace_back(&Scheduler::run_worker, this);
+        }
+    }
+
+    void Scheduler::stop() {
+        {
+            std::lock_guard<std::mutex> ul(mutex);
+            if (!running) {
+                return;
+            }
+            running = false;
+        }
+        cond.notify_all();
+        for (auto& worker : workers) {
+            if (worker.joinable())
+                worker.join();
+        }
+        workers.clear();
+        due = decltype(due)();
+    }
+
+    bool Scheduler::is_running() const {
+        std::lock_guard<std::mutex> ul(mutex);
+        return running;
+    }
+
+    size_t Scheduler::num_workers() const {
+        return worker_count;
+    }
+
+    const std::shared_ptr<Clock>& Scheduler::get_clock() const {
+        return clock;
+    }
+
+    std::vector<Scheduler::TaskStatistics> Scheduler::get_statistics(bool reset) {
+        std::lock_guard<std::mutex> ul(mutex);
+        std::vector<TaskStatistics> statistics;
+        statistics.reserve(tasks.size());
+        for (auto& task : tasks) {
+            statistics.push_back(task.statistics);
+            if (reset) {
+                task.statistics = TaskStatistics{ task.name, task.period };
+            }
+        }
+        return statistics;
+    }
+
+    void Scheduler::run_worker() {
+        std::unique_lock<std::mutex> ul(mutex);
+        while (running) {
+            if (due.empty()) {
+                cond.wait(ul);
+                continue;
+            }
+
+            auto [at, index] = due.top();
+            auto now = clock->now();
+            if (now < at) {
+                if (!clock->is_event_driven()) {
+                    cond.wait_for(ul, clock->to_wall_duration(at - now));
+                }
+                else if (active == 0) {
+                    // nothing runs which could still schedule an earlier event
+                    clock->advance_to(at);
+                    cond.notify_all();
+                }
+                else {
+                    cond.wait(ul);
+                }
+                continue;
+            }
+            due.pop();
+            ++active;
+
+            // the task is off the queue until it is rescheduled below, hence no other
+            // worker can run it concurrently and the task vector is fixed while running
+            auto& task = tasks[index];
+            ul.unlock();
+
+            auto start = std::chrono::steady_clock::now();
+            try {
+                task.task();
+            }
+            catch (std::exception& e) {
+                spdlog::error("Scheduler::run_worker: task {} exception={}", task.name, e.what());
+            }
+            auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+            auto finish = clock->now();
+
+            ul.lock();
+            --active;
+            auto& statistics = task.statistics;
+            auto lag = now - at;
+            ++statistics.runs;
+            statistics.last_duration = duration;
+            statistics.total_duration += duration;
+            statistics.max_duration = std::max(statistics.max_duration, duration);
+            statistics.max_lag = std::max(statistics.max_lag, lag);
+
+            auto next = at + task.period;
+            while (next <= finish) {
+                next += task.period;
+                ++statistics.skipped;
+            }
+            due.emplace(next, index);
+            cond.notify_one();
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "pch.h"
+
+#include <thread>
+#include <condition_variable>
+
+#include "clock.h"
+
+namespace common {
+
+	/*
+	 * Runs periodic tasks such as the per symbol market updates on a pool of worker threads.
+	 * Every task has its own period and never runs concurrently with itself, so independent
+	 * tasks proceed in parallel while a single task keeps its sequential semantics.
+	 * Ticks which are missed because a task took longer than its period are skipped.
+	 * Periods and due times are in the time of the clock, durations are measured in wall time.
+	 * An event driven clock is advanced to the next due time once all running tasks completed.
+	 */
+	class Scheduler {
+	public:
+		typedef std::function<void()> task_t;
+
+		struct TaskStatistics {
+			std::string name;
+			std::chrono::nanoseconds period{ 0 };
+			uint64_t runs{ 0 };
+			uint64_t skipped{ 0 };
+			std::chrono::nanoseconds last_duration{ 0 };
+			std::chrono::nanoseconds max_duration{ 0 };
+			std::chrono::nanoseconds total_duration{ 0 };
+			std::chrono::nanoseconds max_lag{ 0 };
+
+			std::chrono::nanoseconds avg_duration() const;
+
+			std::string to_string() const;
+		};
+
+		explicit Scheduler(
+			size_t num_workers = std::thread::hardware_concurrency(),
+			const std::shared_ptr<Clock>& clock = std::make_shared<SystemClock>()
+		);
+
+		Scheduler(const Scheduler&) = delete;
+
+		Scheduler& operator= (const Scheduler&) = delete;
+
+		~Scheduler();
+
+		size_t add(const std::string& name, std::chrono::nanoseconds period, task_t task);
+
+		void start();
+
+		void stop();
+
+		bool is_running() const;
+
+		size_t num_workers() const;
+
+		const std::shared_ptr<Clock>& get_clock() const;
+
+		std::vector<TaskStatistics> get_statistics(bool reset = false);
+
+	private:
+		struct Task {
+			std::string name;
+			std::chrono::nanoseconds period;
+			task_t task;
+			TaskStatistics statistics;
+		};
+
+		typedef std::pair<std::chrono::nanoseconds, size_t> due_t;
+
+		void run_worker();
+
+		size_t worker_count;
+		std::shared_ptr<Clock> clock;
+		std::vector<Task> tasks;
+		std::priority_queue<due_t, std::vector<due_t>, std::greater<due_t>> due;
+		std::vector<std::thread> workers;
+		mutable std::mutex mutex;
+		std::condition_variable cond;
+		size_t active{ 0 };
+		bool running{ false };
+	};
+}
+
+#endif
@@ -30,12 +30,192 @@ namespace common {
         return std::chrono::duration_cast<std::chrono::nanoseconds>(us);
     }
 
-    // parsing datetime string for example "2017-09-15 13:11:34.356648"
-    inline nanoseconds parse_datetime(const std::string& d) {
-       std::istringstream in(d);
-       time_point<system_clock>  tp;
-       in >> parse("%F %T", tp);
-       return duration_cast<nanoseconds>(tp.time_since_epoch());
+    // days since 1970-01-01 of a proleptic Gregorian calendar date, see http://howardhinnant.github.io/date_algorithms.html
+    constexpr int64_t days_from_civil(int64_t y, unsigned m, unsigned d) {
+        y -= m <= 2;
+        const int64_t era = (y >= 0 ? y : y - 399) / 400;
+        const unsigned yoe = static_cast<unsigned>(y - era * 400);
+        const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+        const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        return era * 146097 + static_cast<int64_t>(doe) - 719468;
+    }
+
+    // inverse of days_from_civil
+    constexpr void civil_from_days(int64_t z, int64_t& y, unsigned& m, unsigned& d) {
+        z += 719468;
+        const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+        const unsigned doe = static_cast<unsigned>(z - era * 146097);
+        const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        const unsigned mp = (5 * doy + 2) / 153;
+        d = doy - (153 * mp + 2) / 5 + 1;
+        m = mp < 10 ? mp + 3 : mp - 9;
+        y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+    }
+
+    namespace detail {
+
+        // parses exactly n decimal digits starting at pos
+        constexpr bool parse_digits(std::string_view s, size_t pos, size_t n, int& value) {
+            if (pos + n > s.size())
+                return false;
+            int v = 0;
+            for (size_t i = pos; i < pos + n; ++i) {
+                const char c = s[i];
+                if (c < '0' || c > '9')
+                    return false;
+                v = v * 10 + (c - '0');
+            }
+            value = v;
+            return true;
+        }
+
+        // parses an optional fraction of a second ".f" with 1 to 9 digits which must end the string
+        constexpr bool parse_fraction(std::string_view s, size_t pos, int64_t& nanos) {
+            nanos = 0;
+            if (pos == s.size())
+                return true;
+            if (s[pos] != '.' || pos + 1 == s.size() || s.size() - pos - 1 > 9)
+                return false;
+            int64_t scale = 1000000000;
+            for (size_t i = pos + 1; i < s.size(); ++i) {
+                const char c = s[i];
+                if (c < '0' || c > '9')
+                    return false;
+                scale /= 10;
+                nanos += (c - '0') * scale;
+            }
+            return true;
+        }
+
+        constexpr bool parse_date(std::string_view s, size_t pos, bool separated, nanoseconds& t) {
+            int y = 0, m = 0, d = 0;
+            const size_t dm = separated ? 5 : 4, dd = separated ? 8 : 6;
+            if (separated && (s.size() < pos + 10 || s[pos + 4] != '-' || s[pos + 7] != '-'))
+                return false;
+            if (!parse_digits(s, pos, 4, y) || !parse_digits(s, pos + dm, 2, m) || !parse_digits(s, pos + dd, 2, d))
+                return false;
+            if (m < 1 || m > 12 || d < 1 || d > 31)
+                return false;
+            t = days(days_from_civil(y, static_cast<unsigned>(m), static_cast<unsigned>(d)));
+            return true;
+        }
+
+        // "HH:MM:SS[.f]" at pos up to the end of the string, seconds up to 60 for leap seconds
+        constexpr bool parse_time(std::string_view s, size_t pos, nanoseconds& t) {
+            int h = 0, m = 0, sec = 0;
+            int64_t nanos = 0;
+            if (s.size() < pos + 8 || s[pos + 2] != ':' || s[pos + 5] != ':')
+                return false;
+            if (!parse_digits(s, pos, 2, h) || !parse_digits(s, pos + 3, 2, m) || !parse_digits(s, pos + 6, 2, sec))
+                return false;
+            if (h > 23 || m > 59 || sec > 60 || !parse_fraction(s, pos + 8, nanos))
+                return false;
+            t = hours(h) + minutes(m) + seconds(sec) + nanoseconds(nanos);
+            return true;
+        }
+
+        inline char* write_digits(char* out, int64_t value, int n) {
+            for (int i = n - 1; i >= 0; --i) {
+                out[i] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            }
+            return out + n;
+        }
+    }
+
+    /*
+     * Allocation free parsers for the FIX UTCDate "YYYYMMDD", UTCTimeOnly "HH:MM:SS[.sss[sss[sss]]]"
+     * and UTCTimestamp "YYYYMMDD-HH:MM:SS[.sss[sss[sss]]]" formats, the result is in nanoseconds
+     * since the unix epoch or since midnight for UTCTimeOnly. They return false on malformed input.
+     */
+    constexpr bool parse_utc_date(std::string_view s, nanoseconds& t) {
+        return s.size() == 8 && detail::parse_date(s, 0, false, t);
+    }
+
+    constexpr bool parse_utc_time_only(std::string_view s, nanoseconds& t) {
+        return detail::parse_time(s, 0, t);
+    }
+
+    constexpr bool parse_utc_timestamp(std::string_view s, nanoseconds& t) {
+        nanoseconds date{ 0 }, time{ 0 };
+        if (s.size() < 17 || s[8] != '-' || !detail::parse_date(s, 0, false, date) || !detail::parse_time(s, 9, time))
+            return false;
+        t = date + time;
+        return true;
+    }
+
+    // a FIX UTCTimestamp from a separate UTCDate and UTCTimeOnly, e.g. MDEntryDate and MDEntryTime
+    constexpr bool parse_utc_date_and_time(std::string_view date, std::string_view time, nanoseconds& t) {
+        nanoseconds d{ 0 }, tod{ 0 };
+        if (!parse_utc_date(date, d) || !parse_utc_time_only(time, tod))
+            return false;
+        t = d + tod;
+        return true;
+    }
+
+    // buffer sizes including the longest fraction
+    constexpr size_t utc_date_length = 8;
+    constexpr size_t utc_time_only_max_length = 18;
+    constexpr size_t utc_timestamp_max_length = 27;
+
+    /*
+     * Formats the time of day of t as FIX UTCTimeOnly with precision 0, 3, 6 or 9 fractional digits,
+     * the buffer needs room for utc_time_only_max_length chars. Returns the number of chars written.
+     */
+    inline size_t format_utc_time_only(const nanoseconds& t, char* out, int precision = 3) {
+        auto tod = (t - floor<days>(t)).count();
+        auto start = out;
+        const auto nanos = tod % 1000000000;
+        tod /= 1000000000;
+        out = detail::write_digits(out, tod / 3600, 2);
+        *out++ = ':';
+        out = detail::write_digits(out, tod / 60 % 60, 2);
+        *out++ = ':';
+        out = detail::write_digits(out, tod % 60, 2);
+        if (precision == 3 || precision == 6 || precision == 9) {
+            *out++ = '.';
+            out = detail::write_digits(out, nanos / (precision == 3 ? 1000000 : precision == 6 ? 1000 : 1), precision);
+        }
+        return out - start;
+    }
+
+    // formats the date of t as FIX UTCDate, the buffer needs room for utc_date_length chars
+    inline size_t format_utc_date(const nanoseconds& t, char* out) {
+        int64_t y = 0;
+        unsigned m = 0, d = 0;
+        civil_from_days(floor<days>(t).count(), y, m, d);
+        out = detail::write_digits(out, y, 4);
+        out = detail::write_digits(out, m, 2);
+        detail::write_digits(out, d, 2);
+        return utc_date_length;
+    }
+
+    // formats t as FIX UTCTimestamp, the buffer needs room for utc_timestamp_max_length chars
+    inline size_t format_utc_timestamp(const nanoseconds& t, char* out, int precision = 3) {
+        format_utc_date(t, out);
+        out[utc_date_length] = '-';
+        return utc_date_length + 1 + format_utc_time_only(t, out + utc_date_length + 1, precision);
+    }
+
+    inline std::string to_utc_timestamp(const nanoseconds& t, int precision = 3) {
+        char buffer[utc_timestamp_max_length];
+        return std::string(buffer, format_utc_timestamp(t, buffer, precision));
+    }
+
+    /*
+     * Parses a datetime string, for example "2017-09-15 13:11:34.356648", also accepts a 'T' separator
+     * or a date only. Returns the epoch on malformed input.
+     */
+    inline nanoseconds parse_datetime(std::string_view d) {
+        nanoseconds date{ 0 }, time{ 0 };
+        if (!detail::parse_date(d, 0, true, date))
+            return nanoseconds(0);
+        if (d.size() == 10)
+            return date;
+        if ((d[10] != ' ' && d[10] != 'T') || !detail::parse_time(d, 11, time))
+            return nanoseconds(0);
+        return date + time;
     }
 
     inline nanoseconds get_current_system_clock() {
@@ -0,0 +1,149 @@
+#ifndef TOP_OF_BOOK_STORE_H
+#define TOP_OF_BOOK_STORE_H
+
+#include "pch.h"
+
+#include <atomic>
+#include <memory>
+
+#include "market_data.h"
+#include "blocking_queue.h"
+#include "instrument_registry.h"
+
+namespace common {
+
+	/*
+	 * Latest top of book per symbol, conflated instead of queued. Slots are indexed by the
+	 * instrument id of the symbol, cache line aligned and guarded by a seqlock, so the writer overwrites
+	 * the quote in place and readers always get the freshest quote in O(1) without allocation
+	 * or locks. Updates a reader does not get to see in time are simply superseded.
+	 *
+	 * Each symbol must be published by a single writer thread, any number of threads can read.
+	 */
+	class TopOfBookStore {
+	public:
+		explicit TopOfBookStore(size_t max_symbols = 4096)
+			: max_symbols(max_symbols)
+			, slots(std::make_unique<Slot[]>(max_symbols))
+		{}
+
+		TopOfBookStore(const TopOfBookStore&) = delete;
+
+		TopOfBookStore& operator=(const TopOfBookStore&) = delete;
+
+		// returns the instrument id of the symbol, registers it on first use, called once on subscribe
+		size_t register_symbol(const std::string& symbol) {
+			auto id = instrument_registry().id(symbol);
+			if (id >= max_symbols) {
+				throw std::runtime_error(std::format("TopOfBookStore: cannot register {}, instrument id {} exceeds {} slots", symbol, id, max_symbols));
+			}
+			return id;
+		}
+
+		std::optional<size_t> find(const std::string& symbol) const {
+			auto id = instrument_registry().find(symbol);
+			return id.has_value() && id.value() < max_symbols ? std::optional<size_t>(id.value()) : std::optional<size_t>();
+		}
+
+		const std::string& symbol(size_t id) const {
+			return instrument_registry().symbol(static_cast<uint32_t>(id));
+		}
+
+		void publish(size_t id, const TopOfBook& top) {
+			auto& slot = slots[id];
+			auto seq = slot.seq.load(std::memory_order_relaxed);
+			slot.seq.store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			slot.timestamp.store(top.timestamp.count(), std::memory_order_relaxed);
+			slot.bid_price.store(top.bid_price, std::memory_order_relaxed);
+			slot.bid_volume.store(top.bid_volume, std::memory_order_relaxed);
+			slot.ask_price.store(top.ask_price, std::memory_order_relaxed);
+			slot.ask_volume.store(top.ask_volume, std::memory_order_relaxed);
+			slot.seq.store(seq + 2, std::memory_order_release);
+		}
+
+		// number of quotes published for the symbol so far, zero if none yet
+		uint64_t version(size_t id) const {
+			return slots[id].seq.load(std::memory_order_acquire) / 2;
+		}
+
+		uint64_t version(const std::string& symbol) const {
+			auto id = find(symbol);
+			return id.has_value() ? version(id.value()) : 0;
+		}
+
+		// reads the latest quote without the symbol, returns its version or zero if none was published yet
+		uint64_t get(size_t id, TopOfBook& top) const {
+			const auto& slot = slots[id];
+			while (true) {
+				auto seq = slot.seq.load(std::memory_order_acquire);
+				if (seq & 1) {
+					continue;
+				}
+				top.timestamp = std::chrono::nanoseconds(slot.timestamp.load(std::memory_order_relaxed));
+				top.bid_price = slot.bid_price.load(std::memory_order_relaxed);
+				top.bid_volume = slot.bid_volume.load(std::memory_order_relaxed);
+				top.ask_price = slot.ask_price.load(std::memory_order_relaxed);
+				top.ask_volume = slot.ask_volume.load(std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if (slot.seq.load(std::memory_order_relaxed) == seq) {
+					return seq / 2;
+				}
+			}
+		}
+
+		// reads the latest quote including the symbol, false if the symbol has no quote yet
+		bool get(const std::string& symbol, TopOfBook& top) const {
+			auto id = find(symbol);
+			if (!id.has_value() || get(id.value(), top) == 0) {
+				return false;
+			}
+			if (top.symbol != symbol) {
+				top.symbol = symbol;
+			}
+			return true;
+		}
+
+		/*
+		 * Waits until the symbol has a quote newer than the given version and updates the version.
+		 * To wait for the first quote of a subscription pass the version read before subscribing,
+		 * the slot still holds the last quote of an earlier subscription of the symbol.
+		 */
+		template<class R, class P>
+		bool wait(const std::string& symbol, uint64_t& version, TopOfBook& top, const std::chrono::duration<R, P>& timeout) const {
+			auto until = std::chrono::steady_clock::now() + timeout;
+			Backoff backoff;
+			std::optional<size_t> id;
+			while (true) {
+				if (!id.has_value()) {
+					id = find(symbol);
+				}
+				if (id.has_value() && this->version(id.value()) > version) {
+					version = get(id.value(), top);
+					top.symbol = symbol;
+					return true;
+				}
+				if (std::chrono::steady_clock::now() >= until) {
+					return false;
+				}
+				backoff.pause();
+			}
+		}
+
+	private:
+		// the quote fields are relaxed atomics so that the optimistic reads of the seqlock are race free
+		struct alignas(cache_line_size) Slot {
+			std::atomic<uint64_t> seq{ 0 };
+			std::atomic<int64_t> timestamp{ 0 };
+			std::atomic<double> bid_price{ 0 };
+			std::atomic<double> bid_volume{ 0 };
+			std::atomic<double> ask_price{ 0 };
+			std::atomic<double> ask_volume{ 0 };
+		};
+
+		size_t max_symbols;
+		std::unique_ptr<Slot[]> slots;
+	};
+}
+
+#endif
@@ -20,7 +20,7 @@ namespace common {
       double tick_scale;
 
       double round_to_tick(double value) {
-          auto scaled = trunc(value * tick_scale);
+          auto scaled = std::round(value * tick_scale);
           auto res = scaled / tick_scale;
           return res;
       }
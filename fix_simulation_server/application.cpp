@@ -2,6 +2,8 @@
 #pragma warning( disable : 4503 4355 4786 )
 #endif
 
+#include <charconv>
+
 #include "spdlog/spdlog.h"
 
 #include "application.h"
@@ -9,6 +11,8 @@
 #include "common/market.h"
 #include "common/market_data.h"
 #include "common/time_utils.h"
+#include "common/fix.h"
+#include "common/interner.h"
 
 #include "quickfix/config.h"
 #include "quickfix/Session.h"
@@ -24,117 +28,196 @@ std::string fix_string(const FIX::Message& msg) {
 	return s;
 }
 
-void Application::run_market_data_update() {
+void Application::run_market_data_update(const std::string& symbol, Market& market, fix_sim::MarketDepth& depth) {
 	bool quote = true;
+	ExecutionReportListener listener{ *this, market.get_price_scale() };
 
-	while (!done) {
-		std::this_thread::sleep_for(market_update_period);
-
-		auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch());
+	spdlog::debug("Application::run_market_data_update: symbol={}", symbol);
 
-		for (auto& [symbol, market] : markets.markets) {
-			spdlog::debug("Application::run_market_data_update: symbol={}", symbol);
+	try {
+		market.simulate_next();
+
+		auto top = market.get_current_and_previous_top_of_book();
+		const auto& scale = market.get_price_scale();
+
+		if (quote) {
+			if (top.first.bid_ticks(scale) != top.second.bid_ticks(scale)) {
+				const auto& bid_order = market.get_bid_order();
+				market.erase(bid_order.get_ord_id(), bid_order.get_side());
+				auto order = Order(
+					next_ord_id(),
+					generate_id("quote_cl_ord_id"),
+					bid_order.get_symbol_id(),
+					bid_order.get_owner_id(),
+					bid_order.get_target_id(),
+					Order::Side::buy,
+					Order::Type::limit,
+					top.first.bid_price,
+					(long)top.first.bid_volume
+				);
+				market.quote(order, listener);
+				listener.flush();
+				spdlog::debug("Application::run_market_data_update: bid side quote price={}", top.first.bid_price);
+			}
 
-			try {
-				market.simulate_next();
+			if (top.first.ask_ticks(scale) != top.second.ask_ticks(scale)) {
+				const auto& ask_order = market.get_ask_order();
+				market.erase(ask_order.get_ord_id(), ask_order.get_side());
+				auto order = Order(
+					next_ord_id(),
+					generate_id("quote_cl_ord_id"),
+					ask_order.get_symbol_id(),
+					ask_order.get_owner_id(),
+					ask_order.get_target_id(),
+					Order::Side::sell,
+					Order::Type::limit,
+					top.first.ask_price,
+					(long)top.first.ask_volume
+				);
+				market.quote(order, listener);
+				listener.flush();
+				spdlog::debug("Application::run_market_data_update: ask side quote price={}", top.first.ask_price);
+			}
+		}
 
-				// send market data to subscribers only
-				auto top = market.get_current_and_previous_top_of_book();
-				auto it = market_data_subscriptions.find(symbol);
-				if (it != market_data_subscriptions.end()) {
-					auto message = get_update_message(it->second.first, it->second.second, top);
-					if (message) {
-						FIX::Session::sendToTarget(message.value());
-					}
-				}
+		// the depth includes the new quotes, market data is sent to subscribers only
+		depth.update(market);
+		auto subscriptions = market_data_subscriptions.get(symbol);
+		if (subscriptions && !subscriptions->empty()) {
+			publish_market_data(symbol, market, top, depth, *subscriptions);
+		}
+	}
+	catch (std::exception& e) {
+		spdlog::error("Application::run_market_data_update: symbol={} exception={}", symbol, e.what());
+	}
 
-				if (quote) {
-					if (top.first.bid_price != top.second.bid_price) {
-						const auto& bid_order = market.get_bid_order();
-						market.erase(bid_order.get_ord_id(), bid_order.get_side());
-						auto order = Order(
-							generate_id("quote_ord_id"),
-							generate_id("quote_cl_ord_id"),
-							symbol,
-							OWNER_MARKET_SIMULATOR,
-							"",
-							Order::Side::buy,
-							Order::Type::limit,
-							top.first.bid_price,
-							(long)top.first.bid_volume
-						);
-						auto result = market.quote(order);
-						spdlog::debug("Application::run_market_data_update: bid side quote price={}", top.first.bid_price);
-
-						for (const auto& fill : result.matched)
-						{
-							fill_order(fill);
-							spdlog::debug("Application::run_market_data_update: bid side fill order={}", fill.to_string());
-						}
-					}
-
-					if (top.first.ask_price != top.second.ask_price) {
-						const auto& ask_order = market.get_ask_order();
-						market.erase(ask_order.get_ord_id(), ask_order.get_side());
-						auto order = Order(
-							generate_id("quote_ord_id"),
-							generate_id("quote_cl_ord_id"),
-							symbol,
-							OWNER_MARKET_SIMULATOR,
-							"",
-							Order::Side::sell,
-							Order::Type::limit,
-							top.first.ask_price,
-							(long)top.first.ask_volume
-						);
-						auto result = market.quote(order);
-						spdlog::debug("Application::run_market_data_update: ask side quote price={}", top.first.ask_price);
-
-						for (const auto& fill : result.matched)
-						{
-							fill_order(fill);
-							spdlog::debug("Application::run_market_data_update: ask side fill order={}", fill.to_string());
-						}
-					}
-				}
-			}
-			catch (std::exception& e) {
-				spdlog::error("Application::run_market_data_update: exception={}", e.what());
-			}
+	spdlog::debug("Application::run_market_data_update: completed symbol={}", symbol);
+}
 
-			spdlog::debug("Application::run_market_data_update: completed symbol={}", symbol);
+void Application::report_market_data_update_statistics() {
+	uint64_t runs = 0;
+	uint64_t skipped = 0;
+	std::chrono::nanoseconds total_duration{ 0 };
+	const Scheduler::TaskStatistics* slowest = nullptr;
+
+	auto all_statistics = scheduler.get_statistics(true);
+	for (const auto& statistics : all_statistics) {
+		spdlog::debug("Application::report_market_data_update_statistics: {}", statistics.to_string());
+		runs += statistics.runs;
+		skipped += statistics.skipped;
+		total_duration += statistics.total_duration;
+		if (slowest == nullptr || statistics.max_duration > slowest->max_duration) {
+			slowest = &statistics;
 		}
 	}
+
+	if (slowest != nullptr) {
+		spdlog::info(
+			"Application::report_market_data_update_statistics: tasks={} runs={} skipped={} avg={}us slowest={}",
+			all_statistics.size(),
+			runs,
+			skipped,
+			runs > 0 ? std::chrono::duration_cast<std::chrono::microseconds>(total_duration).count() / (int64_t)runs : 0,
+			slowest->to_string()
+		);
+	}
 }
 
 void Application::start_market_data_updates() {
-	spdlog::info("====> starting market data updates");
-	thread = std::thread(&Application::run_market_data_update, this);
+	spdlog::info(
+		"====> starting market data updates with {} workers at clock time {}", 
+		scheduler.num_workers(), 
+		common::to_string(clock->now())
+	);
+	for (auto& [symbol, market] : markets.markets) {
+		auto it = market_update_periods.find(symbol);
+		if (it == market_update_periods.end()) {
+			throw std::runtime_error(std::format("no market update period for symbol={}", symbol));
+		}
+
+		// the published depth starts from the current book and then follows its level changes
+		auto& depth = market_depths[symbol];
+		std::vector<DepthLevel> levels;
+		market.track_level_changes(true);
+		market.depth(0, levels);
+		depth.apply(levels);
+
+		scheduler.add(symbol, it->second, [this, &symbol, &market, &depth]() {
+			run_market_data_update(symbol, market, depth);
+		});
+	}
+	if (market_update_statistics_period.count() > 0) {
+		scheduler.add("statistics", market_update_statistics_period, [this]() {
+			report_market_data_update_statistics();
+		});
+	}
+	scheduler.start();
 }
 
 void Application::stop_market_data_updates() {
 	spdlog::info("====> stopping market data updates");
-	if (!started)
-		return;
-	started = false;
-	done = true;
-	if (thread.joinable())
-		thread.join();
+	scheduler.stop();
 }
 
-void Application::subscribe_market_data(const std::string& symbol, const std::string& senderCompID, const std::string& targetCompID) {
-	market_data_subscriptions.insert_or_assign(symbol, std::make_pair(senderCompID, targetCompID));
+void Application::subscribe_market_data(const std::string& symbol, const fix_sim::MarketDataSubscription& subscription) {
+	market_data_subscriptions.subscribe(symbol, subscription);
 }
 
-void Application::unsubscribe_market_data(const std::string& symbol) {
-	auto it = market_data_subscriptions.find(symbol);
-	if (it != market_data_subscriptions.end())
-		market_data_subscriptions.erase(it);
+void Application::unsubscribe_market_data(const std::string& md_req_id, const std::string& senderCompID, const std::string& targetCompID) {
+	auto n = market_data_subscriptions.unsubscribe(md_req_id, senderCompID, targetCompID);
+	spdlog::info("Application::unsubscribe_market_data: removed {} subscriptions for md_req_id={}", n, md_req_id);
 }
 
 bool Application::subscribed_to_market_data(const std::string& symbol) {
-	auto it = market_data_subscriptions.find(symbol);
-	return it != market_data_subscriptions.end();
+	return market_data_subscriptions.has_subscribers(symbol);
+}
+
+void Application::publish_market_data(
+	const std::string& symbol,
+	const Market& market,
+	const std::pair<TopOfBook, TopOfBook>& topOfBook,
+	fix_sim::MarketDepth& depth,
+	const fix_sim::MarketDataSubscriptions::subscriptions_t& subscriptions
+) {
+	std::map<size_t, std::optional<FIX::Message>> messages;
+	std::set<size_t> depths;
+	std::vector<fix_sim::DepthEntry> entries;
+
+	for (const auto& subscription : subscriptions) {
+		auto market_depth = subscription.market_depth;
+		auto [it, inserted] = messages.try_emplace(market_depth);
+		if (inserted) {
+			if (market_depth == 1) {
+				it->second = get_update_message(topOfBook);
+			}
+			else if (market_depth == 0) {
+				it->second = get_depth_update_message(symbol, market.get_price_scale(), depth.full_depth_updates());
+			}
+			else {
+				depth.depth_updates(market_depth, entries);
+				it->second = get_depth_update_message(symbol, market.get_price_scale(), entries);
+				depths.insert(market_depth);
+			}
+		}
+		if (it->second) {
+			send_market_data(it->second.value(), subscription);
+		}
+	}
+
+	depth.retain(depths);
+}
+
+void Application::send_market_data(FIX::Message& message, const fix_sim::MarketDataSubscription& subscription) {
+	auto& header = message.getHeader();
+	message.setField(FIX::MDReqID(subscription.md_req_id));
+	header.setField(FIX::SenderCompID(subscription.sender_comp_id));
+	header.setField(FIX::TargetCompID(subscription.target_comp_id));
+	try {
+		FIX::Session::sendToTarget(message);
+	}
+	catch (FIX::SessionNotFound& e) {
+		spdlog::error("Application::send_market_data: session not found {}", e.what());
+	}
 }
 
 void Application::onCreate(const FIX::SessionID&)
@@ -148,20 +231,12 @@ void Application::onLogout(const FIX::SessionID& sessionID)
 	try {
 		auto senderCompID = sessionID.getSenderCompID().getString();
 		auto targetCompID = sessionID.getTargetCompID().getString();
-		auto it = market_data_subscriptions.begin();
 		spdlog::info(
 			"====> removing market data subscriptions for sender_comp_id = {} target_comp_id = {}",
 			senderCompID, targetCompID
 		);
-		while (it != market_data_subscriptions.end()) {
-			if (senderCompID == it->second.first && targetCompID == it->second.second) {
-				spdlog::info("removing subscription for symbol={}", it->first);
-				it = market_data_subscriptions.erase(it);
-			}
-			else {
-				++it;
-			}
-		}
+		auto n = market_data_subscriptions.unsubscribe_session(senderCompID, targetCompID);
+		spdlog::info("removed {} subscriptions", n);
 	}
 	catch (std::exception& e) {
 		spdlog::error("Application::onLogon: {}", e.what());
@@ -218,9 +293,14 @@ void Application::onMessage(const FIX44::NewOrderSingle& message, const FIX::Ses
 
 	try
 	{
+		// the symbol is interned by the order, only configured markets are accepted so that the interner stays bounded
+		if (markets.markets.find(symbol.getValue()) == markets.markets.end()) {
+			throw std::runtime_error(std::format("invalid market symbol={}", symbol.getValue()));
+		}
+
 		if (timeInForce == FIX::TimeInForce_GOOD_TILL_CANCEL || timeInForce == FIX::TimeInForce_DAY) {
 			Order order(
-				generate_id("ord_id"), 
+				next_ord_id(), 
 				cl_ord_id, symbol, 
 				sender_comp_id, 
 				target_comp_id, 
@@ -287,6 +367,24 @@ void Application::onMessage(const FIX44::MarketDataRequest& message, const FIX::
 	message.get(market_depth);
 	message.get(no_related_sym);
 
+	auto depth = subscription_request_type == FIX::SubscriptionRequestType_DISABLE_PREVIOUS_SNAPSHOT
+		? std::optional<size_t>(1)
+		: fix_sim::to_market_depth(market_depth.getValue());
+
+	if (!depth.has_value()) {
+		auto text = std::format("invalid MarketDepth={}", market_depth.getValue());
+		spdlog::error("Application::onMessage[MarketDataRequest]: md_req_id={} rejected, {}", md_req_id.getValue(), text);
+		auto reject = get_market_data_request_reject_message(
+			md_req_id.getValue(),
+			target_comp_id.getValue(),
+			sender_comp_id.getValue(),
+			FIX::MDReqRejReason_UNSUPPORTED_MARKET_DEPTH,
+			text
+		);
+		FIX::Session::sendToTarget(reject);
+		return;
+	}
+
 	if (subscription_request_type == FIX::SubscriptionRequestType_SNAPSHOT ||
 		subscription_request_type == FIX::SubscriptionRequestType_SNAPSHOT_AND_UPDATES) { 
 
@@ -301,34 +399,70 @@ void Application::onMessage(const FIX44::MarketDataRequest& message, const FIX::
 				const auto& market = it->second;
 
 				// flip to send back target->sender and sender->target 
-				auto snapshot = get_snapshot_message(
-					target_comp_id.getValue(),
-					sender_comp_id.getValue(),
-					market.get_current_and_previous_top_of_book().first
-				);
-				FIX::Session::sendToTarget(snapshot);
+				if (*depth == 1) {
+					auto snapshot = get_snapshot_message(
+						md_req_id.getValue(),
+						target_comp_id.getValue(),
+						sender_comp_id.getValue(),
+						market.get_current_and_previous_top_of_book().first
+					);
+					FIX::Session::sendToTarget(snapshot);
+				}
+				else {
+					std::vector<DepthLevel> levels;
+					market.depth(*depth, levels);
+					auto snapshot = get_depth_snapshot_message(
+						md_req_id.getValue(),
+						target_comp_id.getValue(),
+						sender_comp_id.getValue(),
+						symbol.getValue(),
+						market.get_price_scale(),
+						levels
+					);
+					FIX::Session::sendToTarget(snapshot);
+				}
 
 				if (subscription_request_type == FIX::SubscriptionRequestType_SNAPSHOT_AND_UPDATES) {
-					subscribe_market_data(symbol.getValue(), target_comp_id.getValue(), sender_comp_id.getValue());
+					subscribe_market_data(
+						symbol.getValue(), 
+						fix_sim::MarketDataSubscription{ 
+							md_req_id.getValue(), 
+							target_comp_id.getValue(), 
+							sender_comp_id.getValue(), 
+							*depth
+						}
+					);
 				}
 			}
 			else {
-				throw std::runtime_error(std::format("invalid market symbol={}", symbol.getString()));
+				auto reject = get_market_data_request_reject_message(
+					md_req_id.getValue(),
+					target_comp_id.getValue(),
+					sender_comp_id.getValue(),
+					FIX::MDReqRejReason_UNKNOWN_SYMBOL,
+					std::format("invalid market symbol={}", symbol.getString())
+				);
+				FIX::Session::sendToTarget(reject);
 			}
 		}
 	} 
+	else if (subscription_request_type == FIX::SubscriptionRequestType_DISABLE_PREVIOUS_SNAPSHOT) {
+		// subscriptions are keyed from the simulator's point of view as when subscribing
+		unsubscribe_market_data(md_req_id.getValue(), target_comp_id.getValue(), sender_comp_id.getValue());
+	}
 }
 
 FIX::Message Application::get_snapshot_message(
+	const std::string& mdReqID,
 	const std::string& senderCompID, 
 	const std::string& targetCompID, 
 	const TopOfBook& top
 ) {
-	FIX::DateTime now = FIX::DateTime::nowUtc();
+	FIX::DateTime now = common::fix::to_date_time(clock->now());
 
 	FIX44::MarketDataSnapshotFullRefresh message;
 	message.set(FIX::Symbol(top.symbol));
-	message.set(FIX::MDReqID(generator.genMarketDataID()));
+	message.set(FIX::MDReqID(mdReqID));
 
 	FIX44::MarketDataSnapshotFullRefresh::NoMDEntries group;
 
@@ -353,18 +487,13 @@ FIX::Message Application::get_snapshot_message(
 	return message;
 }
 
-std::optional<FIX::Message> Application::get_update_message(
-	const std::string& senderCompID, 
-	const std::string& targetCompID, 
-	const std::pair<TopOfBook, TopOfBook>& topOfBookChange
-) {
+std::optional<FIX::Message> Application::get_update_message(const std::pair<TopOfBook, TopOfBook>& topOfBookChange) {
 	const auto& [current, previous] = topOfBookChange;
 	auto n = 0;
 
-	FIX::DateTime now = FIX::DateTime::nowUtc();
+	FIX::DateTime now = common::fix::to_date_time(clock->now());
 
 	FIX44::MarketDataIncrementalRefresh message;
-	message.set(FIX::MDReqID(generator.genMarketDataID()));
 
 	FIX44::MarketDataIncrementalRefresh::NoMDEntries group;
 	if (current.bid_price != previous.bid_price) {
@@ -438,55 +567,127 @@ std::optional<FIX::Message> Application::get_update_message(
 		return std::optional<FIX::Message>();
 	}
 	else {
-		auto& header = message.getHeader();
-		header.setField(FIX::SenderCompID(senderCompID));
-		header.setField(FIX::TargetCompID(targetCompID));
 		return std::optional<FIX::Message>(message);
 	}
 } 
 
-void Application::update_order(const Order& order, char exec_status, char ord_status, const std::string& text)
-{
-	// do not reply back to the FIX client about the other side of 
-	// the order, i.e. owned/generated by the market simulator
-	if (order.get_owner() == OWNER_MARKET_SIMULATOR) {
-		return;
+FIX::Message Application::get_depth_snapshot_message(
+	const std::string& mdReqID,
+	const std::string& senderCompID,
+	const std::string& targetCompID,
+	const std::string& symbol,
+	const PriceScale& scale,
+	const std::vector<DepthLevel>& levels
+) {
+	FIX::DateTime now = common::fix::to_date_time(clock->now());
+
+	FIX44::MarketDataSnapshotFullRefresh message;
+	message.set(FIX::Symbol(symbol));
+	message.set(FIX::MDReqID(mdReqID));
+
+	FIX44::MarketDataSnapshotFullRefresh::NoMDEntries group;
+	for (const auto& level : levels) {
+		group.set(FIX::MDEntryType(level.side == Order::Side::buy ? FIX::MDEntryType_BID : FIX::MDEntryType_OFFER));
+		group.set(FIX::MDEntryPx(scale.to_double(level.price)));
+		group.set(FIX::MDEntrySize(level.open_quantity));
+		group.set(FIX::MDEntryDate(now));
+		group.set(FIX::MDEntryTime(now));
+		message.addGroup(group);
 	}
 
-	FIX::TargetCompID targetCompID(order.get_owner());
-	FIX::SenderCompID senderCompID(order.get_target());
+	auto& header = message.getHeader();
+	header.setField(FIX::SenderCompID(senderCompID));
+	header.setField(FIX::TargetCompID(targetCompID));
+
+	return message;
+}
+
+FIX::Message Application::get_market_data_request_reject_message(
+	const std::string& mdReqID,
+	const std::string& senderCompID,
+	const std::string& targetCompID,
+	char reason,
+	const std::string& text
+) {
+	FIX44::MarketDataRequestReject message(FIX::MDReqID{ mdReqID });
+	message.set(FIX::MDReqRejReason(reason));
+	message.set(FIX::Text(text));
+
+	auto& header = message.getHeader();
+	header.setField(FIX::SenderCompID(senderCompID));
+	header.setField(FIX::TargetCompID(targetCompID));
+
+	return message;
+}
+
+std::optional<FIX::Message> Application::get_depth_update_message(
+	const std::string& symbol,
+	const PriceScale& scale,
+	const std::vector<fix_sim::DepthEntry>& entries
+) {
+	if (entries.empty()) {
+		return std::optional<FIX::Message>();
+	}
+
+	FIX::DateTime now = common::fix::to_date_time(clock->now());
+
+	FIX44::MarketDataIncrementalRefresh message;
+	FIX44::MarketDataIncrementalRefresh::NoMDEntries group;
+	for (const auto& entry : entries) {
+		group.set(FIX::Symbol(symbol));
+		group.set(FIX::MDEntryType(entry.side == Order::Side::buy ? FIX::MDEntryType_BID : FIX::MDEntryType_OFFER));
+		group.set(FIX::MDEntryPx(scale.to_double(entry.price)));
+		group.set(FIX::MDEntrySize(entry.quantity));
+		group.set(FIX::MDUpdateAction(entry.action));
+		group.set(FIX::MDEntryDate(now));
+		group.set(FIX::MDEntryTime(now));
+		message.addGroup(group);
+	}
+
+	return std::optional<FIX::Message>(message);
+}
+
+void Application::update_order(const ExecutionEvent& event, const ExecutionEvents& events, const PriceScale& scale, const std::string& text)
+{
+	FIX::TargetCompID targetCompID(session_interner().lookup(event.owner_id));
+	FIX::SenderCompID senderCompID(session_interner().lookup(event.target_id));
 
 	FIX44::ExecutionReport fixOrder(
-		FIX::OrderID(order.get_ord_id()),
+		FIX::OrderID(std::to_string(event.ord_id)),
 		FIX::ExecID(generator.genExecutionID()),
-		FIX::ExecType(exec_status),
-		FIX::OrdStatus(ord_status),
-		FIX::Side(convert(order.get_side())),
-		FIX::LeavesQty(order.get_open_quantity()),
-		FIX::CumQty(order.get_executed_quantity()),
-		FIX::AvgPx(order.get_avg_executed_price())
+		FIX::ExecType(event.exec_type),
+		FIX::OrdStatus(event.ord_status),
+		FIX::Side(convert(event.side)),
+		FIX::LeavesQty(event.leaves_quantity),
+		FIX::CumQty(event.cum_quantity),
+		FIX::AvgPx(event.avg_price)
 	);
 
-	fixOrder.set(FIX::Symbol(order.get_symbol())); 
-	fixOrder.set(FIX::ClOrdID(order.get_cl_ord_id()));
-	fixOrder.set(FIX::OrderQty(order.get_quantity()));
-	fixOrder.set(FIX::OrdType(order.get_type() == Order::Type::limit ? FIX::OrdType_LIMIT : FIX::OrdType_MARKET));
-	if (order.get_type() == Order::Type::limit) {
-		fixOrder.set(FIX::Price(order.get_price()));
-	}
-	if (order.get_type() == Order::Type::market) {
-		fixOrder.set(FIX::Price(order.get_avg_executed_price()));
-	}
-	if (ord_status == FIX::OrdStatus_FILLED || 
-		ord_status == FIX::OrdStatus_PARTIALLY_FILLED || 
-		ord_status == FIX::OrdStatus_NEW || 
-		ord_status == FIX::OrdStatus_REPLACED ||
-		ord_status == FIX::OrdStatus_CANCELED)
+	auto cl_ord_id = event.long_cl_ord_id >= 0
+		? events.long_cl_ord_ids[event.long_cl_ord_id]
+		: std::string(event.cl_ord_id.data(), event.cl_ord_id_length);
+
+	fixOrder.set(FIX::Symbol(symbol_interner().lookup(event.symbol_id))); 
+	fixOrder.set(FIX::ClOrdID(cl_ord_id));
+	fixOrder.set(FIX::OrderQty(event.quantity));
+	fixOrder.set(FIX::OrdType(event.type == Order::Type::limit ? FIX::OrdType_LIMIT : FIX::OrdType_MARKET));
+	if (event.type == Order::Type::limit) {
+		fixOrder.set(FIX::Price(event.price));
+	}
+	if (event.type == Order::Type::market) {
+		fixOrder.set(FIX::Price(event.avg_price));
+	}
+	if (event.ord_status == FIX::OrdStatus_FILLED || 
+		event.ord_status == FIX::OrdStatus_PARTIALLY_FILLED || 
+		event.ord_status == FIX::OrdStatus_NEW || 
+		event.ord_status == FIX::OrdStatus_REPLACED ||
+		event.ord_status == FIX::OrdStatus_CANCELED)
 	{
-		fixOrder.set(FIX::LastQty(order.get_last_executed_quantity()));
-		fixOrder.set(FIX::LastPx(order.get_last_executed_price()));
+		fixOrder.set(FIX::LastQty(event.last_quantity));
+		fixOrder.set(FIX::LastPx(scale.to_double(event.last_price)));
 	}
 	fixOrder.set(FIX::Text(text));
+	fixOrder.set(FIX::TransactTime(common::fix::to_date_time(clock->now()), 3));
 
 	try
 	{
@@ -497,25 +698,89 @@ void Application::update_order(const Order& order, char exec_status, char ord_st
 	}
 }
 
-void Application::reject_order(const Order& order)
+Application::ExecutionEvents& Application::execution_events()
 {
-	update_order(order, FIX::ExecType_REJECTED, FIX::OrdStatus_REJECTED, "");
+	thread_local ExecutionEvents events;
+	return events;
 }
 
-void Application::accept_order(const Order& order)
+void Application::ExecutionReportListener::record(
+	const Order& order, 
+	char exec_type, 
+	char ord_status, 
+	const Price& last_price, 
+	long last_quantity)
 {
-	update_order(order, FIX::ExecType_NEW, FIX::OrdStatus_NEW, "");
+	// do not reply back to the FIX client about the other side of 
+	// the order, i.e. owned/generated by the market simulator
+	static const auto simulator_id = session_interner().intern(OWNER_MARKET_SIMULATOR);
+	if (order.get_owner_id() == simulator_id) {
+		return;
+	}
+
+	auto& event = events.events.emplace_back();
+	event.ord_id = order.get_ord_id();
+	event.symbol_id = order.get_symbol_id();
+	event.owner_id = order.get_owner_id();
+	event.target_id = order.get_target_id();
+	event.last_price = last_price;
+	event.price = order.get_price();
+	event.avg_price = order.get_avg_executed_price();
+	event.quantity = order.get_quantity();
+	event.last_quantity = last_quantity;
+	event.cum_quantity = order.get_executed_quantity();
+	event.leaves_quantity = order.get_open_quantity();
+	event.exec_type = exec_type;
+	event.ord_status = ord_status;
+	event.side = order.get_side();
+	event.type = order.get_type();
+
+	auto cl_ord_id = order.get_cl_ord_id();
+	if (cl_ord_id.size() <= Order::inline_cl_ord_id_length) {
+		event.long_cl_ord_id = -1;
+		event.cl_ord_id_length = static_cast<uint8_t>(cl_ord_id.size());
+		std::copy(cl_ord_id.begin(), cl_ord_id.end(), event.cl_ord_id.begin());
+	}
+	else {
+		// the slots are kept across flushes so that their capacity is reused
+		if (events.num_long_cl_ord_ids == events.long_cl_ord_ids.size()) {
+			events.long_cl_ord_ids.emplace_back();
+		}
+		events.long_cl_ord_ids[events.num_long_cl_ord_ids].assign(cl_ord_id);
+		event.long_cl_ord_id = static_cast<int32_t>(events.num_long_cl_ord_ids++);
+		event.cl_ord_id_length = 0;
+	}
 }
 
-void Application::fill_order(const Order& order)
+Application::ExecutionReportListener::~ExecutionReportListener()
 {
-	auto ord_status = order.is_filled() ? FIX::OrdStatus_FILLED : FIX::OrdStatus_PARTIALLY_FILLED;
-	update_order(order, FIX::ExecType_TRADE, ord_status, "");
+	if (!events.events.empty()) {
+		try {
+			flush();
+		}
+		catch (std::exception& e) {
+			spdlog::error("Application::ExecutionReportListener: flush failed {}", e.what());
+		}
+	}
 }
 
-void Application::cancel_order(const Order& order)
+void Application::ExecutionReportListener::flush()
 {
-	update_order(order, FIX::ExecType_CANCELED, FIX::OrdStatus_CANCELED, "");
+	struct Clear {
+		ExecutionEvents& events;
+		~Clear() { 
+			events.events.clear(); 
+			events.num_long_cl_ord_ids = 0; 
+		}
+	} clear{ events };
+
+	for (auto exec_type : { FIX::ExecType_REJECTED, FIX::ExecType_NEW, FIX::ExecType_TRADE, FIX::ExecType_CANCELED }) {
+		for (const auto& event : events.events) {
+			if (event.exec_type == exec_type) {
+				application.update_order(event, events, scale, "");
+			}
+		}
+	}
 }
 
 void Application::reject_order(
@@ -550,6 +815,7 @@ void Application::reject_order(
 	fixOrder.set(orderQty);
 	fixOrder.set(FIX::LastQty(0));
 	fixOrder.set(FIX::Text(message));
+	fixOrder.set(FIX::TransactTime(common::fix::to_date_time(clock->now()), 3));
 
 	try
 	{
@@ -562,24 +828,14 @@ void Application::reject_order(
 
 void Application::process_order(const Order& order)
 {
-	auto result = markets.insert(order);
-
-	if (result.error) {
-		assert(result.matched.empty());
-		reject_order(order);
-		return;
-	} 
-
-	// we have a new or partial fill 
-	if (result.resting_order) {
-		accept_order(result.resting_order.value());
-	}
-
-	// handle the partial fills and full fills here
-	for (const auto& fill : result.matched)
-	{
-		fill_order(fill);
+	// acks, fills and rejects are recorded while matching and reported after the book is unlocked
+	auto it = markets.markets.find(order.get_symbol());
+	if (it == markets.markets.end()) {
+		throw std::runtime_error(std::format("invalid market symbol={}", order.get_symbol()));
 	}
+	ExecutionReportListener listener{ *this, it->second.get_price_scale() };
+	it->second.insert(order, listener);
+	listener.flush();
 }
 
 void Application::process_cancel(
@@ -588,10 +844,25 @@ void Application::process_cancel(
 	Order::Side side)
 {
 	spdlog::info("Application::process_cancel: cancelling ord_id={}\n{}", ord_id, markets.to_string(symbol));
-	auto order = markets.erase(symbol, ord_id, side);
-	if (order.has_value()) {
-		cancel_order(order.value());
-		spdlog::info("Application::process_cancel: cancelled order={}\n{}", order.value().to_string(), markets.to_string(symbol));
+
+	// order ids are numeric inside the matcher
+	uint64_t id = 0;
+	auto [ptr, ec] = std::from_chars(ord_id.data(), ord_id.data() + ord_id.size(), id);
+	if (ec != std::errc() || ptr != ord_id.data() + ord_id.size()) {
+		spdlog::error("Application::process_cancel: invalid ord_id={}", ord_id);
+		return;
+	}
+
+	auto it = markets.markets.find(symbol);
+	if (it == markets.markets.end()) {
+		spdlog::error("Application::process_cancel: invalid market symbol={}", symbol);
+		return;
+	}
+	ExecutionReportListener listener{ *this, it->second.get_price_scale() };
+	auto cancelled = it->second.erase(id, side, listener);
+	listener.flush();
+	if (cancelled) {
+		spdlog::info("Application::process_cancel: cancelled ord_id={}\n{}", ord_id, markets.to_string(symbol));
 	}
 	else {
 		spdlog::error("Application::process_cancel: could not find order with ord_id={} side={}", ord_id, common::to_string(side));
@@ -658,4 +929,8 @@ std::string Application::generate_id(const std::string& label) {
 	return std::format("{}_{}", label, ++ord_id);
 }
 
+uint64_t Application::next_ord_id() {
+	return ++ord_id;
+}
+
 
@@ -6,6 +6,11 @@
 #include "common/order.h"
 #include "common/markets.h"
 #include "common/id_generator.h"
+#include "common/scheduler.h"
+#include "common/clock.h"
+
+#include "market_data_subscriptions.h"
+#include "market_depth.h"
 
 #include "quickfix/Application.h"
 #include "quickfix/MessageCracker.h"
@@ -24,17 +29,21 @@ class Application: public FIX::Application, public FIX::MessageCracker
 public:
 	Application(
 		 std::map<std::string, Market>& market,
-		 std::chrono::milliseconds market_update_period,
-		 FIX::Log *logger, 
-		 std::mutex& mutex
+		 const std::map<std::string, std::chrono::milliseconds>& market_update_periods,
+		 size_t market_update_threads,
+		 std::chrono::seconds market_update_statistics_period,
+		 const std::shared_ptr<Clock>& clock,
+		 FIX::Log *logger
 	) : logger(logger)
       , markets(market)
-	  , market_update_period(market_update_period)
-	  , mutex(mutex)
+	  , market_update_periods(market_update_periods)
+	  , market_update_statistics_period(market_update_statistics_period)
+	  , clock(clock)
+	  , scheduler(market_update_threads, clock)
 	  , ord_id(0)
 	{}
 
-	void run_market_data_update();
+	void run_market_data_update(const std::string& symbol, Market& market, fix_sim::MarketDepth& depth);
 
 	void start_market_data_updates();
 
@@ -44,8 +53,89 @@ public:
 
 private:
 
+	/*
+	 * Fixed size record of a match event of a client order, the execution report is built from 
+	 * it once the book is unlocked. Client order ids too long to be stored inline are kept in the 
+	 * long_cl_ord_ids of the events buffer.
+	 */
+	struct ExecutionEvent {
+		uint64_t ord_id;
+		uint32_t symbol_id;
+		uint32_t owner_id;
+		uint32_t target_id;
+		int32_t long_cl_ord_id; // index into the long client order ids or -1
+		Price last_price;
+		double price;
+		double avg_price;
+		long quantity;
+		long last_quantity;
+		long cum_quantity;
+		long leaves_quantity;
+		char exec_type;
+		char ord_status;
+		Order::Side side;
+		Order::Type type;
+		uint8_t cl_ord_id_length;
+		std::array<char, Order::inline_cl_ord_id_length> cl_ord_id;
+	};
+
+	// reused per thread, cleared by flush so that its capacity is kept
+	struct ExecutionEvents {
+		std::vector<ExecutionEvent> events;
+		std::vector<std::string> long_cl_ord_ids;
+		size_t num_long_cl_ord_ids{ 0 };
+	};
+
+	static ExecutionEvents& execution_events();
+
+	/*
+	 * Records the match events of client orders while the matcher lock is held, orders of the 
+	 * market simulator are not reported. The execution reports are sent by flush once the matcher 
+	 * returned, so no FIX I/O happens under the book lock and the QuickFIX session lock is never 
+	 * taken inside it.
+	 */
+	struct ExecutionReportListener {
+		Application& application;
+		PriceScale scale;
+		ExecutionEvents& events{ execution_events() };
+
+		// events left over because the matcher threw are still reported, the buffer is shared by the thread
+		~ExecutionReportListener();
+
+		void on_accept(const Order& order) {
+			record(order, FIX::ExecType_NEW, FIX::OrdStatus_NEW, scale.to_price(order.get_last_executed_price()), order.get_last_executed_quantity());
+		}
+
+		void on_fill(const Fill& fill) {
+			if (fill.maker != nullptr) {
+				record_fill(*fill.maker, fill);
+			}
+			record_fill(*fill.taker, fill);
+		}
+
+		void on_cancel(const Order& order) {
+			record(order, FIX::ExecType_CANCELED, FIX::OrdStatus_CANCELED, scale.to_price(order.get_last_executed_price()), order.get_last_executed_quantity());
+		}
+
+		void on_reject(const Order& order) {
+			record(order, FIX::ExecType_REJECTED, FIX::OrdStatus_REJECTED, Price(), 0);
+		}
+
+		void record_fill(const Order& order, const Fill& fill) {
+			auto ord_status = order.is_filled() ? FIX::OrdStatus_FILLED : FIX::OrdStatus_PARTIALLY_FILLED;
+			record(order, FIX::ExecType_TRADE, ord_status, fill.price, fill.quantity);
+		}
+
+		void record(const Order& order, char exec_type, char ord_status, const Price& last_price, long last_quantity);
+
+		// sends rejects, the ack of a resting order, its fills and then cancels and clears the events
+		void flush();
+	};
+
 	std::string generate_id(const std::string& label);
 
+	uint64_t next_ord_id();
+
 	// FIX Application overloads
 
 	void onCreate(const FIX::SessionID&);
@@ -72,15 +162,7 @@ private:
 
 	void process_cancel(const std::string& ord_id, const std::string& symbol, Order::Side);
 
-	void update_order(const Order&, char exec_status, char ord_status, const std::string& text);
-
-	void reject_order(const Order& order);
-
-	void accept_order(const Order& order);
-
-	void fill_order(const Order& order);
-
-	void cancel_order(const Order& order);
+	void update_order(const ExecutionEvent& event, const ExecutionEvents& events, const PriceScale& scale, const std::string& text);
 
 	void reject_order(
 		const FIX::SenderCompID&, 
@@ -102,37 +184,76 @@ private:
 
 	FIX::OrdType convert(Order::Type);
 
-	void subscribe_market_data(const std::string& symbol, const std::string& senderCompID, const std::string& targetCompID);
+	void subscribe_market_data(const std::string& symbol, const fix_sim::MarketDataSubscription& subscription);
 
-	void unsubscribe_market_data(const std::string& symbol);
+	void unsubscribe_market_data(const std::string& md_req_id, const std::string& senderCompID, const std::string& targetCompID);
 
 	bool subscribed_to_market_data(const std::string& symbol);
 
 	FIX::Message get_snapshot_message(
+		const std::string& mdReqID,
 		const std::string& senderCompID,
 		const std::string& targetCompID,
 		const TopOfBook& top
 	);
 
-	std::optional<FIX::Message> get_update_message(
+	FIX::Message get_depth_snapshot_message(
+		const std::string& mdReqID,
+		const std::string& senderCompID,
+		const std::string& targetCompID,
+		const std::string& symbol,
+		const PriceScale& scale,
+		const std::vector<DepthLevel>& levels
+	);
+
+	FIX::Message get_market_data_request_reject_message(
+		const std::string& mdReqID,
 		const std::string& senderCompID,
 		const std::string& targetCompID,
-		const std::pair<TopOfBook, TopOfBook>& topOfBook
+		char reason,
+		const std::string& text
+	);
+
+	// update messages are built once without session specific fields
+	std::optional<FIX::Message> get_update_message(const std::pair<TopOfBook, TopOfBook>& topOfBook);
+
+	std::optional<FIX::Message> get_depth_update_message(
+		const std::string& symbol,
+		const PriceScale& scale,
+		const std::vector<fix_sim::DepthEntry>& entries
+	);
+
+	// builds the update message once per requested depth and shares it among the subscribers of that depth
+	void publish_market_data(
+		const std::string& symbol,
+		const Market& market,
+		const std::pair<TopOfBook, TopOfBook>& topOfBook,
+		fix_sim::MarketDepth& depth,
+		const fix_sim::MarketDataSubscriptions::subscriptions_t& subscriptions
 	);
 
+	// only MDReqID and the header are set per session
+	void send_market_data(FIX::Message& message, const fix_sim::MarketDataSubscription& subscription);
+
+	void report_market_data_update_statistics();
+
 	IDGenerator generator;
 	Markets markets;
-	std::chrono::milliseconds market_update_period;
+	std::map<std::string, std::chrono::milliseconds> market_update_periods;
+	std::chrono::seconds market_update_statistics_period;
+
+	// simulation time for market data, bars and execution reports
+	std::shared_ptr<Clock> clock;
 
 	FIX::Log* logger;
 
-	std::map<std::string, std::pair<std::string, std::string>> market_data_subscriptions;
+	fix_sim::MarketDataSubscriptions market_data_subscriptions;
+
+	// depth published per symbol, each one is only accessed by the update task of its symbol
+	std::map<std::string, fix_sim::MarketDepth> market_depths;
 
-	std::mutex& mutex;
-	int ord_id;
-	std::thread thread;
-	bool started{ false };
-	std::atomic_bool done{ false };
+	Scheduler scheduler;
+	std::atomic<uint64_t> ord_id;
 };
 
 #endif
@@ -13,6 +13,8 @@
 #include "common/price_sampler.h"
 #include "common/market.h"
 #include "common/utils.h"
+#include "common/clock.h"
+#include "common/instrument_registry.h"
 
 #include "application.h"
 #include "rest_server.h"
@@ -34,7 +36,6 @@ int main(int argc, char** argv)
 
     try
     {
-        std::mutex mutex;
         std::string settings_file = argv[1];
         std::string market_config_file = argv[2];
         std::random_device random_device;
@@ -54,6 +55,23 @@ int main(int argc, char** argv)
         auto market_update_period = std::chrono::duration_cast<std::chrono::milliseconds>(
             std::chrono::milliseconds(cfg["market_update_period_millis"].value<int>().value())
         );
+        auto market_update_threads = static_cast<size_t>(
+            cfg["market_update_threads"].value<int>().value_or((int)std::thread::hardware_concurrency())
+        );
+        auto market_update_statistics_period = std::chrono::seconds(
+            cfg["market_update_statistics_period_seconds"].value<int>().value_or(60)
+        );
+        std::map<std::string, std::chrono::milliseconds> market_update_periods;
+
+        // "system" runs in wall clock time, "accelerated" clock_speed times faster and "virtual" as fast as possible
+        auto clock_mode = cfg["clock"].value<std::string>().value_or("system");
+        auto clock_speed = cfg["clock_speed"].value<double>().value_or(1.0);
+        auto clock_start = cfg["clock_start"].value<std::string>();
+        auto clock = clock_factory(
+            clock_mode,
+            clock_start ? parse_datetime(clock_start.value()) : get_current_system_clock(),
+            clock_speed
+        );
 
         spdlog::set_level(spdlog::level::debug);
         spdlog::flush_every(std::chrono::seconds(2));
@@ -77,10 +95,13 @@ int main(int argc, char** argv)
            auto history_sample_period = std::chrono::milliseconds(
                sym_tbl["history_sample_period_millis"].value<int>().value()
            );
+           auto update_period = std::chrono::milliseconds(
+               sym_tbl["market_update_period_millis"].value<int>().value_or((int)market_update_period.count())
+           );
 
            auto top = TopOfBook(
                symbol, 
-               get_current_system_clock(), 
+               clock->now(), 
                price - spread/2,
                bid_volume,
                price + spread/2,
@@ -98,29 +119,43 @@ int main(int argc, char** argv)
                1
            );
            if (sampler != nullptr) {
+              instrument_registry().register_instrument(Instrument{
+                  .symbol = symbol,
+                  .tick_size = tick_size,
+                  .precision = static_cast<int>(std::lround(std::log10(tick_scale)))
+              });
               markets.try_emplace(
                   symbol,
                   sampler,
+                  clock,
                   top,
+                  PriceScale(tick_scale),
                   bar_period,
                   history_age,
                   history_sample_period,
-                  false,
-                  mutex
+                  false
               );
+              market_update_periods.insert_or_assign(symbol, update_period);
            }
            else {
                throw std::runtime_error("unknown price sampler type");
            }
         }
 
-        RestServer rest_server(server_host, server_port, markets, mutex);
+        RestServer rest_server(server_host, server_port, markets, clock);
 
         FIX::FileStoreFactory storeFactory(settings);
         FIX::ScreenLogFactory logFactory(settings); 
         screenLogger = logFactory.create();
 
-        Application application(markets, market_update_period, screenLogger, mutex);
+        Application application(
+            markets,
+            market_update_periods,
+            market_update_threads,
+            market_update_statistics_period,
+            clock,
+            screenLogger
+        );
         FIX::SocketAcceptor acceptor(application, storeFactory, settings, logFactory);
 
         acceptor.start();
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "pch.h"
+
+namespace fix_sim {
+
+	// a market data subscription of a FIX session, comp ids are from the simulator's point of view
+	struct MarketDataSubscription {
+		std::string md_req_id;
+		std::string sender_comp_id;
+		std::string target_comp_id;
+		
+		// FIX MarketDepth, 1 is the simulated top of book, 0 the full order book and N the best N levels
+		size_t market_depth{ 1 };
+
+		bool same_session(const std::string& sender, const std::string& target) const {
+			return sender_comp_id == sender && target_comp_id == target;
+		}
+	};
+
+	/*
+	 * Market data subscriptions of any number of sessions per symbol.
+	 * The subscriber list of a symbol is copied on write, so the market update workers
+	 * only take a reference counted snapshot under the lock and publish without holding it.
+	 */
+	class MarketDataSubscriptions {
+	public:
+		typedef std::vector<MarketDataSubscription> subscriptions_t;
+
+		// a session subscribing again with the same MDReqID replaces its previous subscription
+		void subscribe(const std::string& symbol, const MarketDataSubscription& subscription) {
+			std::lock_guard<std::mutex> ul(mutex);
+			auto& current = subscriptions[symbol];
+			auto updated = current ? std::make_shared<subscriptions_t>(*current) : std::make_shared<subscriptions_t>();
+			std::erase_if(*updated, [&](const MarketDataSubscription& s) {
+				return s.md_req_id == subscription.md_req_id && s.same_session(subscription.sender_comp_id, subscription.target_comp_id);
+			});
+			updated->push_back(subscription);
+			current = std::move(updated);
+		}
+
+		size_t unsubscribe(const std::string& md_req_id, const std::string& sender_comp_id, const std::string& target_comp_id) {
+			return remove_if([&](const MarketDataSubscription& s) {
+				return s.md_req_id == md_req_id && s.same_session(sender_comp_id, target_comp_id);
+			});
+		}
+
+		size_t unsubscribe_session(const std::string& sender_comp_id, const std::string& target_comp_id) {
+			return remove_if([&](const MarketDataSubscription& s) {
+				return s.same_session(sender_comp_id, target_comp_id);
+			});
+		}
+
+		std::shared_ptr<const subscriptions_t> get(const std::string& symbol) const {
+			std::lock_guard<std::mutex> ul(mutex);
+			auto it = subscriptions.find(symbol);
+			return it != subscriptions.end() ? it->second : std::shared_ptr<const subscriptions_t>();
+		}
+
+		bool has_subscribers(const std::string& symbol) const {
+			auto current = get(symbol);
+			return current && !current->empty();
+		}
+
+	private:
+		template<typename Predicate>
+		size_t remove_if(Predicate predicate) {
+			std::lock_guard<std::mutex> ul(mutex);
+			size_t removed = 0;
+			for (auto it = subscriptions.begin(); it != subscriptions.end(); ) {
+				if (std::any_of(it->second->begin(), it->second->end(), predicate)) {
+					auto updated = std::make_shared<subscriptions_t>(*it->second);
+					removed += std::erase_if(*updated, predicate);
+					it->second = std::move(updated);
+				}
+				if (it->second->empty()) {
+					it = subscriptions.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+			return removed;
+		}
+
+		mutable std::mutex mutex;
+		std::map<std::string, std::shared_ptr<const subscriptions_t>> subscriptions;
+	};
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "pch.h"
+
+#include <map>
+#include <optional>
+#include <set>
+
+#include "quickfix/FixValues.h"
+
+#include "common/order_matcher.h"
+
+namespace fix_sim {
+
+	// deepest MarketDepth published level by level, deeper requests are capped
+	constexpr size_t max_market_depth = 100;
+
+	/*
+	 * Validates the FIX MarketDepth of a request. Negative values have no depth and the request is
+	 * rejected, 0 requests the full book as in FIX and larger values are capped at max_market_depth.
+	 */
+	inline std::optional<size_t> to_market_depth(int market_depth) {
+		if (market_depth < 0) {
+			return std::optional<size_t>();
+		}
+		return std::min(static_cast<size_t>(market_depth), max_market_depth);
+	}
+
+	// a market data entry with its FIX MDUpdateAction
+	struct DepthEntry {
+		char action;
+		common::Order::Side side;
+		common::Price price;
+		long quantity;
+	};
+
+	/*
+	 * Aggregated order book depth of a symbol as last published, maintained from the level changes
+	 * of the order matcher. Subscribers of the full book receive the level changes of a tick directly,
+	 * subscribers of the best N levels the difference to the N levels previously published to them,
+	 * which costs O(N) per tick and never walks the orders of the book.
+	 * Only used by the market update task of the symbol, hence not synchronized.
+	 */
+	class MarketDepth {
+	public:
+		typedef std::vector<std::pair<common::Price, long>> side_levels_t;
+
+		// drains the level changes of the matcher and prepares the full book updates
+		void update(common::OrderMatcher& matcher) {
+			matcher.drain_level_changes(changes);
+			apply(changes);
+		}
+
+		void apply(const std::vector<common::DepthLevel>& level_changes) {
+			full_depth_entries.clear();
+			for (const auto& change : level_changes) {
+				if (change.side == common::Order::Side::buy)
+					apply(bids, change);
+				else
+					apply(asks, change);
+			}
+		}
+
+		const std::vector<DepthEntry>& full_depth_updates() const {
+			return full_depth_entries;
+		}
+
+		// updates for subscribers of the best depth levels since the previous call with the same depth
+		void depth_updates(size_t depth, std::vector<DepthEntry>& entries) {
+			entries.clear();
+			auto& [published_bids, published_asks] = published[depth];
+			update_side(bids, depth, common::Order::Side::buy, published_bids, entries);
+			update_side(asks, depth, common::Order::Side::sell, published_asks, entries);
+		}
+
+		// forgets the published levels of depths without subscribers
+		void retain(const std::set<size_t>& depths) {
+			std::erase_if(published, [&](const auto& entry) { return !depths.contains(entry.first); });
+		}
+
+	private:
+		template<typename LevelMap>
+		void apply(LevelMap& levels, const common::DepthLevel& change) {
+			auto it = levels.find(change.price);
+			if (change.open_quantity == 0) {
+				if (it != levels.end()) {
+					levels.erase(it);
+					full_depth_entries.push_back(DepthEntry{ FIX::MDUpdateAction_DELETE, change.side, change.price, 0 });
+				}
+			}
+			else if (it == levels.end()) {
+				levels.emplace(change.price, change.open_quantity);
+				full_depth_entries.push_back(DepthEntry{ FIX::MDUpdateAction_NEW, change.side, change.price, change.open_quantity });
+			}
+			else if (it->second != change.open_quantity) {
+				it->second = change.open_quantity;
+				full_depth_entries.push_back(DepthEntry{ FIX::MDUpdateAction_CHANGE, change.side, change.price, change.open_quantity });
+			}
+		}
+
+		// merges the current best levels with the published ones, both are in book order of the side
+		template<typename LevelMap>
+		void update_side(const LevelMap& levels, size_t depth, common::Order::Side side, side_levels_t& published_levels, std::vector<DepthEntry>& entries) {
+			auto& current = scratch;
+			current.clear();
+			for (auto it = levels.begin(); it != levels.end() && current.size() < depth; ++it) {
+				current.emplace_back(it->first, it->second);
+			}
+
+			auto before = levels.key_comp();
+			auto cit = current.begin();
+			auto pit = published_levels.begin();
+			while (cit != current.end() || pit != published_levels.end()) {
+				if (pit == published_levels.end() || (cit != current.end() && before(cit->first, pit->first))) {
+					entries.push_back(DepthEntry{ FIX::MDUpdateAction_NEW, side, cit->first, cit->second });
+					++cit;
+				}
+				else if (cit == current.end() || before(pit->first, cit->first)) {
+					entries.push_back(DepthEntry{ FIX::MDUpdateAction_DELETE, side, pit->first, 0 });
+					++pit;
+				}
+				else {
+					if (cit->second != pit->second) {
+						entries.push_back(DepthEntry{ FIX::MDUpdateAction_CHANGE, side, cit->first, cit->second });
+					}
+					++cit;
+					++pit;
+				}
+			}
+
+			std::swap(published_levels, current);
+		}
+
+		std::map<common::Price, long, std::greater<common::Price>> bids;
+		std::map<common::Price, long, std::less<common::Price>> asks;
+		std::vector<DepthEntry> full_depth_entries;
+		std::vector<common::DepthLevel> changes;
+		side_levels_t scratch;
+		std::map<size_t, std::pair<side_levels_t, side_levels_t>> published;
+	};
+}
@@ -7,6 +7,8 @@
 #include "spdlog/spdlog.h"
 
 #include "common/time_utils.h"
+#include "common/clock.h"
+#include "common/columnar.h"
 
 namespace fix_sim {
 
@@ -18,7 +20,7 @@ namespace fix_sim {
       std::string host;
       int port;
       std::map<std::string, Market>& markets;
-      std::mutex& mutex;
+      std::shared_ptr<common::Clock> clock;
 
       Server server;
       std::atomic_bool done{ false };
@@ -30,11 +32,11 @@ namespace fix_sim {
           const std::string& host,
           int port,
           std::map<std::string, Market>& markets,
-          std::mutex& mutex
+          const std::shared_ptr<common::Clock>& clock
       ) : host(host)
         , port(port)
         , markets(markets)
-        , mutex(mutex)
+        , clock(clock)
       {
          server.Get("/symbols", [this](const Request& req, Response& res) {
             std::string symbols;
@@ -45,12 +47,13 @@ namespace fix_sim {
          });
 
          // for example http://localhost:8080/bars?symbol=EUR/USD&from=2024-03-30 12:00:00&to=2024-03-30 16:00:00
+         // add format=binary or accept common::columnar::content_type for the binary columnar format
          server.Get("/bars", [this](const Request& req, Response& res) {
             std::string msg = "====> /bar";
 
             std::string symbol = "nan";
             std::chrono::nanoseconds from{0};
-            std::chrono::nanoseconds to = common::get_current_system_clock();
+            std::chrono::nanoseconds to = this->clock->now();
 
             if (req.has_param("symbol")) {
                symbol = req.get_param_value("symbol");
@@ -66,8 +69,14 @@ namespace fix_sim {
                to = common::parse_datetime(to_param);
                msg += std::format(" to={}", to_param);
             }
+            auto binary = common::columnar::is_requested(req.get_param_value("format"), req.get_header_value("Accept"));
             auto it = this->markets.find(symbol);
-            if (it != this->markets.end()) {
+            if (it != this->markets.end() && binary) {
+               auto [content, n] = it->second.get_bars_as_columnar(from, to);
+               res.set_content(std::move(content), std::string(common::columnar::content_type));
+               msg += std::format(", response bars={} binary", n);
+            }
+            else if (it != this->markets.end()) {
                auto [content, n] = it->second.get_bars_as_json(from, to);
                res.set_content(content.dump(), "application/json");
                msg += std::format(", response bars={}", n);
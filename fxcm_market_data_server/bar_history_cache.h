@@ -0,0 +1,309 @@
+#pragma once
+
+#include <future>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "common/bar.h"
+#include "common/time_utils.h"
+
+#include "history_source.h"
+
+namespace fxcm {
+
+    // length of a bar of the FXCM timeframe such as m5, H1 or D1 in days, zero if unknown
+    inline double timeframe_length(const std::string& timeframe) {
+        if (timeframe.size() < 2) {
+            return 0;
+        }
+        int n = 0;
+        for (size_t i = 1; i < timeframe.size(); ++i) {
+            if (!std::isdigit(static_cast<unsigned char>(timeframe[i]))) {
+                return 0;
+            }
+            n = n * 10 + (timeframe[i] - '0');
+        }
+        switch (timeframe[0]) {
+        case 'm':
+            return n * common::SECONDS_PER_MINUTE / common::SECONDS_PER_DAY;
+        case 'h':
+        case 'H':
+            return n * common::SECONDS_PER_HOURS / common::SECONDS_PER_DAY;
+        case 'd':
+        case 'D':
+            return n;
+        case 'w':
+        case 'W':
+            return 7.0 * n;
+        case 'M':
+            return 31.0 * n;
+        default:
+            return 0;
+        }
+    }
+
+    /*
+     * In process cache and request coalescing in front of a HistorySource.
+     *
+     * For every symbol and timeframe the cache keeps disjoint segments of covered bar start times
+     * together with their bars. A request only sends the parts of its range to the source that are
+     * neither covered nor already being fetched by a concurrent request. It waits for the fetches in
+     * flight which overlap its range instead of issuing them again, and merges what it fetched with
+     * the adjacent segments. Bars that may still change, i.e. those which started less than one bar
+     * length before now, are never cached, but concurrent requests for them are coalesced as well.
+     *
+     * The number of cached bars is bounded by max_bars, the least recently used symbol and timeframe
+     * is evicted first. With max_bars zero requests are only coalesced.
+     */
+    class BarHistoryCache {
+    public:
+        typedef double DATE;
+        typedef common::BidAskBar<DATE> Bar;
+        typedef std::shared_ptr<const std::vector<Bar>> Bars;
+
+        struct Stats {
+            size_t requests{ 0 };
+            size_t fetches{ 0 };
+            size_t coalesced{ 0 };
+            size_t cached_bars{ 0 };
+        };
+
+        BarHistoryCache(std::shared_ptr<HistorySource> source, size_t max_bars)
+            : source(source)
+            , max_bars(max_bars)
+        {}
+
+        BarHistoryCache(const BarHistoryCache&) = delete;
+
+        BarHistoryCache& operator=(const BarHistoryCache&) = delete;
+
+        std::vector<Bar> get_bars(const std::string& symbol, const std::string& timeframe, DATE from, DATE to) {
+            return get_bars(symbol, timeframe, from, to, common::nanos_to_date(common::get_current_system_clock()));
+        }
+
+        // the bars starting in [from, to] sorted by time, now determines which bars are complete
+        std::vector<Bar> get_bars(const std::string& symbol, const std::string& timeframe, DATE from, DATE to, DATE now) {
+            Key key{ symbol, timeframe };
+            auto length = timeframe_length(timeframe);
+            auto cacheable_to = max_bars > 0 && length > 0 ? now - length : -std::numeric_limits<DATE>::infinity();
+
+            std::vector<Bar> bars;
+            std::vector<std::shared_ptr<Fetch>> own;
+            std::vector<std::shared_ptr<Fetch>> others;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                ++stats.requests;
+                auto& entry = entries[key];
+                entry.last_used = ++use_count;
+
+                std::vector<Range> missing{ Range{ from, to } };
+                for (const auto& [seg_from, segment] : entry.segments) {
+                    if (seg_from <= to && segment.to >= from) {
+                        subtract(missing, Range{ seg_from, segment.to });
+                        append(segment.bars, from, to, bars);
+                    }
+                }
+                for (const auto& fetch : entry.in_flight) {
+                    if (fetch->range.from <= to && fetch->range.to >= from) {
+                        subtract(missing, fetch->range);
+                        others.push_back(fetch);
+                    }
+                }
+                for (const auto& range : missing) {
+                    auto fetch = std::make_shared<Fetch>();
+                    fetch->range = range;
+                    fetch->result = fetch->promise.get_future().share();
+                    entry.in_flight.push_back(fetch);
+                    own.push_back(fetch);
+                }
+                stats.fetches += own.size();
+                stats.coalesced += others.size();
+            }
+
+            spdlog::debug(
+                "BarHistoryCache: {} {} from {} to {} cached={} fetch={} coalesced={}",
+                symbol, timeframe, common::date_to_string(from), common::date_to_string(to), bars.size(), own.size(), others.size()
+            );
+
+            std::exception_ptr failure;
+            for (const auto& fetch : own) {
+                Bars fetched;
+                if (!failure) {
+                    try {
+                        fetched = std::make_shared<const std::vector<Bar>>(
+                            source->get_bars(symbol, timeframe, fetch->range.from, fetch->range.to)
+                        );
+                    }
+                    catch (...) {
+                        failure = std::current_exception();
+                    }
+                }
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    auto& entry = entries[key];
+                    std::erase(entry.in_flight, fetch);
+                    if (fetched) {
+                        Range complete{ fetch->range.from, std::min(fetch->range.to, cacheable_to) };
+                        if (complete.from <= complete.to) {
+                            insert(entry, complete, *fetched);
+                            evict(key);
+                        }
+                    }
+                }
+                // the waiting requests are released outside of the lock
+                if (fetched) {
+                    append(*fetched, from, to, bars);
+                    fetch->promise.set_value(fetched);
+                }
+                else {
+                    fetch->promise.set_exception(failure);
+                }
+            }
+            if (failure) {
+                std::rethrow_exception(failure);
+            }
+
+            for (const auto& fetch : others) {
+                append(*fetch->result.get(), from, to, bars);
+            }
+
+            std::sort(bars.begin(), bars.end(), [](const Bar& a, const Bar& b) { return a.timestamp < b.timestamp; });
+            bars.erase(
+                std::unique(bars.begin(), bars.end(), [](const Bar& a, const Bar& b) { return a.timestamp == b.timestamp; }),
+                bars.end()
+            );
+            return bars;
+        }
+
+        Stats get_stats() const {
+            std::unique_lock<std::mutex> lock(mutex);
+            auto result = stats;
+            result.cached_bars = num_bars;
+            return result;
+        }
+
+        void clear() {
+            std::unique_lock<std::mutex> lock(mutex);
+            for (auto& [key, entry] : entries) {
+                entry.segments.clear();
+            }
+            num_bars = 0;
+        }
+
+    private:
+        typedef std::pair<std::string, std::string> Key;
+
+        struct Range {
+            DATE from;
+            DATE to;
+        };
+
+        struct Fetch {
+            Range range{};
+            std::promise<Bars> promise;
+            std::shared_future<Bars> result;
+        };
+
+        struct Segment {
+            DATE to;
+            std::vector<Bar> bars;
+        };
+
+        struct Entry {
+            std::map<DATE, Segment> segments;
+            std::vector<std::shared_ptr<Fetch>> in_flight;
+            size_t last_used{ 0 };
+        };
+
+        // removes the inner part of range from the ranges, the end points are kept so that bars are not lost
+        static void subtract(std::vector<Range>& ranges, const Range& range) {
+            std::vector<Range> result;
+            for (const auto& r : ranges) {
+                if (range.from > r.to || range.to < r.from) {
+                    result.push_back(r);
+                    continue;
+                }
+                if (r.from < range.from) {
+                    result.push_back(Range{ r.from, range.from });
+                }
+                if (range.to < r.to) {
+                    result.push_back(Range{ range.to, r.to });
+                }
+            }
+            ranges.swap(result);
+        }
+
+        static void append(const std::vector<Bar>& source, DATE from, DATE to, std::vector<Bar>& bars) {
+            auto it = std::lower_bound(source.begin(), source.end(), from, [](const Bar& b, DATE t) { return b.timestamp < t; });
+            for (; it != source.end() && it->timestamp <= to; ++it) {
+                bars.push_back(*it);
+            }
+        }
+
+        // called with the lock, merges the bars of the covered range with the overlapping or touching segments
+        void insert(Entry& entry, Range range, const std::vector<Bar>& fetched) {
+            std::vector<Bar> merged;
+            append(fetched, range.from, range.to, merged);
+            auto it = entry.segments.upper_bound(range.to);
+            while (it != entry.segments.begin()) {
+                auto prev = std::prev(it);
+                if (prev->second.to < range.from) {
+                    break;
+                }
+                range.from = std::min(range.from, prev->first);
+                range.to = std::max(range.to, prev->second.to);
+                num_bars -= prev->second.bars.size();
+                merged.insert(merged.end(), prev->second.bars.begin(), prev->second.bars.end());
+                it = entry.segments.erase(prev);
+            }
+            std::sort(merged.begin(), merged.end(), [](const Bar& a, const Bar& b) { return a.timestamp < b.timestamp; });
+            merged.erase(
+                std::unique(merged.begin(), merged.end(), [](const Bar& a, const Bar& b) { return a.timestamp == b.timestamp; }),
+                merged.end()
+            );
+            num_bars += merged.size();
+            entry.segments.emplace(range.from, Segment{ range.to, std::move(merged) });
+        }
+
+        // called with the lock, the entry of keep is only evicted if it alone exceeds the limit
+        void evict(const Key& keep) {
+            while (num_bars > max_bars) {
+                auto victim = entries.end();
+                for (auto it = entries.begin(); it != entries.end(); ++it) {
+                    if (it->first != keep && !it->second.segments.empty() && (victim == entries.end() || it->second.last_used < victim->second.last_used)) {
+                        victim = it;
+                    }
+                }
+                if (victim == entries.end()) {
+                    victim = entries.find(keep);
+                }
+                if (victim == entries.end() || victim->second.segments.empty()) {
+                    break;
+                }
+                for (const auto& [seg_from, segment] : victim->second.segments) {
+                    num_bars -= segment.bars.size();
+                }
+                spdlog::debug("BarHistoryCache: evicted {} {}", victim->first.first, victim->first.second);
+                victim->second.segments.clear();
+                if (victim->first != keep && victim->second.in_flight.empty()) {
+                    entries.erase(victim);
+                }
+            }
+        }
+
+        std::shared_ptr<HistorySource> source;
+        size_t max_bars;
+
+        mutable std::mutex mutex;
+        std::map<Key, Entry> entries;
+        size_t num_bars{ 0 };
+        size_t use_count{ 0 };
+        Stats stats;
+    };
+}
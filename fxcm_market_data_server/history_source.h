@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/bar.h"
+#include "common/time_utils.h"
+
+namespace fxcm {
+
+    /*
+     * Upstream source of historical bars. The proxy serves /bars through this interface so that the
+     * ForexConnect price history communicator can be replaced by a local stand-in.
+     */
+    class HistorySource {
+    public:
+        typedef double DATE;
+
+        virtual ~HistorySource() = default;
+
+        // the bars of symbol and timeframe starting in [from, to] sorted by time, throws on failure
+        virtual std::vector<common::BidAskBar<DATE>> get_bars(const std::string& symbol, const std::string& timeframe, DATE from, DATE to) = 0;
+    };
+
+    /*
+     * History source reading the bars from csv files, one file {symbol}_{timeframe}.csv per symbol and
+     * timeframe in the directory, with '/' in the symbol replaced by '-' as for /ticks_to_csv.
+     *
+     * Columns: DateTime(ns UTC), BidOpen, BidHigh, BidLow, BidClose, AskOpen, AskHigh, AskLow, AskClose, Volume
+     * with an optional header row. The latency simulates the round trip of a communicator request.
+     */
+    class FileHistorySource : public HistorySource {
+        std::string path;
+        std::chrono::milliseconds latency;
+        std::atomic<size_t> requests{ 0 };
+
+    public:
+        FileHistorySource(const std::string& path, std::chrono::milliseconds latency = std::chrono::milliseconds(0))
+            : path(path)
+            , latency(latency)
+        {}
+
+        // number of get_bars calls so far
+        size_t num_requests() const {
+            return requests;
+        }
+
+        std::string filename(const std::string& symbol, const std::string& timeframe) const {
+            auto symbol_tag = symbol;
+            std::replace(symbol_tag.begin(), symbol_tag.end(), '/', '-');
+            return std::format("{}/{}_{}.csv", path, symbol_tag, timeframe);
+        }
+
+        std::vector<common::BidAskBar<DATE>> get_bars(const std::string& symbol, const std::string& timeframe, DATE from, DATE to) override {
+            ++requests;
+            if (latency.count() > 0) {
+                std::this_thread::sleep_for(latency);
+            }
+
+            auto file = filename(symbol, timeframe);
+            std::ifstream stream(file);
+            if (!stream) {
+                throw std::runtime_error(std::format("no history file {}", file));
+            }
+
+            std::vector<common::BidAskBar<DATE>> bars;
+            std::string line;
+            while (std::getline(stream, line)) {
+                if (line.empty() || !std::isdigit(static_cast<unsigned char>(line[0]))) {
+                    continue;
+                }
+                std::replace(line.begin(), line.end(), ',', ' ');
+                std::istringstream fields(line);
+                long long ns = 0;
+                double v[9];
+                fields >> ns;
+                for (auto& x : v) {
+                    fields >> x;
+                }
+                if (!fields) {
+                    throw std::runtime_error(std::format("invalid row in {}: {}", file, line));
+                }
+                auto dt = common::nanos_to_date(std::chrono::nanoseconds(ns));
+                if (dt < from || dt > to) {
+                    continue;
+                }
+                bars.emplace_back(dt, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7], v[8]);
+            }
+
+            std::sort(bars.begin(), bars.end(), [](const auto& a, const auto& b) { return a.timestamp < b.timestamp; });
+            return bars;
+        }
+    };
+}
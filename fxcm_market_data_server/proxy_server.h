@@ -10,6 +10,7 @@
 
 #include "common/bar.h"
 #include "common/json.h"
+#include "common/columnar.h"
 #include "common/time_utils.h"
 
 #include "LocalFormat.h"
@@ -17,6 +18,8 @@
 #include "SessionStatusListener.h"
 #include "CommunicatorStatusListener.h"
 #include "LiveBarStreamer.h"
+#include "history_source.h"
+#include "bar_history_cache.h"
 
 namespace fxcm {
 
@@ -44,6 +47,176 @@ namespace fxcm {
         return res;
     }
 
+    /*
+     * Streams the ticks of the reader from date_from on as a chunked response in the columnar format,
+     * one message per chunk of at most chunk_size ticks. Only one chunk is encoded at a time, so the
+     * memory on top of the reader is bounded by the chunk size and not by the number of ticks.
+     */
+    void set_tick_stream_content(Response& res, O2G2Ptr<IO2GMarketDataSnapshotResponseReader> reader, double date_from, size_t chunk_size = 16384) {
+        auto next = std::make_shared<int>(0);
+        res.set_chunked_content_provider(
+            std::string(common::columnar::content_type),
+            [reader, date_from, chunk_size, next](size_t offset, DataSink& sink) {
+                auto n = reader ? reader->size() : 0;
+                std::vector<common::Quote<double>> chunk;
+                chunk.reserve(chunk_size);
+                while (*next < n && chunk.size() < chunk_size) {
+                    auto i = (*next)++;
+                    auto dt = reader->getDate(i);
+                    if (dt >= date_from) {
+                        chunk.emplace_back(dt, reader->getBid(i), reader->getAsk(i));
+                    }
+                }
+                // an empty result is still sent as one message without rows
+                if (!chunk.empty() || offset == 0) {
+                    auto message = common::to_columnar(chunk);
+                    if (!sink.write(message.data(), message.size())) {
+                        return false;
+                    }
+                }
+                if (*next >= n) {
+                    sink.done();
+                }
+                return true;
+            }
+        );
+    }
+
+    /*
+     * History source sending one price history communicator request per call and waiting for its
+     * response.
+     */
+    class ForexConnectHistorySource : public HistorySource {
+        O2G2Ptr<pricehistorymgr::IPriceHistoryCommunicator> communicator;
+        O2G2Ptr<SessionStatusListener> statusListener;
+
+    public:
+        ForexConnectHistorySource(
+            O2G2Ptr<pricehistorymgr::IPriceHistoryCommunicator> communicator,
+            O2G2Ptr<SessionStatusListener> statusListener
+        ) : communicator(communicator)
+          , statusListener(statusListener)
+        {}
+
+        std::vector<common::BidAskBar<DATE>> get_bars(const std::string& symbol, const std::string& timeframe, DATE from, DATE to) override {
+            std::vector<common::BidAskBar<DATE>> bars;
+            auto date_from = from;
+            auto date_to = to;
+            auto quotes_count = 0;
+
+            O2G2Ptr<CommunicatorStatusListener> communicatorStatusListener(new CommunicatorStatusListener());
+            communicator->addStatusListener(communicatorStatusListener);
+
+            bool has_error = false;
+            std::string error_message;
+
+            if (communicator->isReady() || communicatorStatusListener->waitEvents() && communicatorStatusListener->isReady())
+            {
+                O2G2Ptr<ResponseListener> responseListener(new ResponseListener());
+                communicator->addListener(responseListener);
+
+                O2G2Ptr<IO2GTimeframe> timeframeObj = create_timeframe_object(communicator, timeframe);
+                if (!timeframeObj)
+                {
+                    error_message = std::format("timeframe {} incorrect", timeframe);
+                    has_error = true;
+                }
+
+                pricehistorymgr::IError* error = NULL;
+                O2G2Ptr<pricehistorymgr::IPriceHistoryCommunicatorRequest> request = communicator->createRequest(
+                    symbol.c_str(), timeframeObj, date_from, date_to, quotes_count, &error
+                );
+                O2G2Ptr<pricehistorymgr::IError> autoError(error);
+                if (!request)
+                {
+                    error_message = std::format("failed to create request {}", error ? error->getMessage() : "unknown error");
+                    has_error = true;
+                }
+
+                responseListener->setRequest(request);
+                if (!communicator->sendRequest(request, &error))
+                {
+                    error_message = std::format("failed to send request {}", error ? error->getMessage() : "unknown error");
+                    has_error = true;
+                }
+
+                if (!has_error)
+                {
+                    responseListener->wait();
+
+                    O2G2Ptr<pricehistorymgr::IPriceHistoryCommunicatorResponse> response = responseListener->getResponse();
+                    if (response) {
+                        pricehistorymgr::IError* error = NULL;
+                        O2G2Ptr<IO2GMarketDataSnapshotResponseReader> reader = communicator->createResponseReader(response, &error);
+                        O2G2Ptr<pricehistorymgr::IError> autoError(error);
+                        if (reader) {
+                            if (!reader->isBar())
+                            {
+                                error_message = std::format("failded sending request - expected bars");
+                                has_error = true;
+                            }
+                            else {
+                                auto n = reader->size();
+
+                                if (n > 0) {
+                                    LocalFormat format;
+
+                                    spdlog::info(
+                                        "{} bars from {} to {} in request interval from {} to {}",
+                                        n, format.formatDate(reader->getDate(0)), format.formatDate(reader->getDate(n - 1)),
+                                        format.formatDate(date_from), format.formatDate(date_to)
+                                    );
+
+                                    for (int i = 0; i < n; ++i) {
+                                        DATE dt = reader->getDate(i); // beginning of the bar
+
+                                        if (dt < date_from) {
+                                            continue;
+                                        }
+
+                                        common::BidAskBar<DATE> bar(
+                                            dt,
+                                            reader->getBidOpen(i),
+                                            reader->getBidHigh(i),
+                                            reader->getBidLow(i),
+                                            reader->getBidClose(i),
+                                            reader->getAskOpen(i),
+                                            reader->getAskHigh(i),
+                                            reader->getAskLow(i),
+                                            reader->getAskClose(i),
+                                            reader->getVolume(i)
+                                        );
+
+                                        bars.emplace_back(bar);
+                                    }
+                                }
+                            }
+                        }
+                        else {
+                            error_message = std::format("failed to create reader {}", error ? error->getMessage() : "unknown error");
+                            has_error = true;
+                        }
+                    }
+                }
+
+                communicator->removeListener(responseListener);
+            }
+            else {
+                error_message = std::format("communicator not ready or status listener timeout");
+                has_error = true;
+            }
+
+            communicator->removeStatusListener(communicatorStatusListener);
+            statusListener->reset();
+
+            if (has_error) {
+                throw std::runtime_error(error_message);
+            }
+
+            return bars;
+        }
+    };
+
     class ProxyServer {
 
         int server_port;
@@ -63,6 +236,9 @@ namespace fxcm {
 
         std::map<std::string, std::shared_ptr<LiveBarStreamer>> streamers;
 
+        std::shared_ptr<HistorySource> history_source;
+        std::unique_ptr<BarHistoryCache> bar_cache;
+
     public:
 
         bool is_ready() const {
@@ -82,7 +258,8 @@ namespace fxcm {
             const std::string& url,
             const std::string& server_host,
             int server_port,
-            std::chrono::milliseconds login_timeout = 15000ms
+            std::chrono::milliseconds login_timeout = 15000ms,
+            size_t bar_cache_max_bars = 2000000
         ) : server_host(server_host)
           , server_port(server_port)
         {
@@ -105,6 +282,9 @@ namespace fxcm {
                 spdlog::error("failed to initialize communcator {}", error ? error->getMessage() : "unknown error");
             }
 
+            history_source = std::make_shared<ForexConnectHistorySource>(communicator, statusListener);
+            bar_cache = std::make_unique<BarHistoryCache>(history_source, bar_cache_max_bars);
+
             session->login(login.c_str(), password.c_str(), url.c_str(), connection.c_str());
 
             if (statusListener->waitEvents() && statusListener->isConnected())
@@ -294,130 +474,26 @@ namespace fxcm {
                         msg << std::format(" to={}", to_param);
                     }
                     if (req.has_param("timeframe")) {
-                        auto timeframe = req.get_param_value("timeframe");
+                        timeframe = req.get_param_value("timeframe");
                         msg << std::format(" timeframe={}", timeframe);
                     }
 
                     spdlog::info(msg.str());
-                    std::vector<common::BidAskBar<DATE>> bars;
-                    auto date_from = common::nanos_to_date(from);
-                    auto date_to = common::nanos_to_date(to);
-                    auto quotes_count = 0;
-
-                    O2G2Ptr<CommunicatorStatusListener> communicatorStatusListener(new CommunicatorStatusListener());
-                    communicator->addStatusListener(communicatorStatusListener);
-
-                    bool has_error = false;
-                    std::string error_message;
-
-                    if (communicator->isReady() || communicatorStatusListener->waitEvents() && communicatorStatusListener->isReady())
-                    {
-                        O2G2Ptr<ResponseListener> responseListener(new ResponseListener());
-                        communicator->addListener(responseListener);
-
-                        O2G2Ptr<IO2GTimeframe> timeframeObj = create_timeframe_object(communicator, timeframe);
-                        if (!timeframeObj)
-                        {
-                            error_message = std::format("timeframe {} incorrect", timeframe);
-                            has_error = true;
-                        }
-
-                        pricehistorymgr::IError* error = NULL;
-                        O2G2Ptr<pricehistorymgr::IPriceHistoryCommunicatorRequest> request = communicator->createRequest(
-                            symbol.c_str(), timeframeObj, date_from, date_to, quotes_count, &error
-                        );
-                        O2G2Ptr<pricehistorymgr::IError> autoError(error);
-                        if (!request)
-                        {
-                            error_message = std::format("failed to create request {}", error ? error->getMessage() : "unknown error");
-                            has_error = true;
-                        }
-
-                        responseListener->setRequest(request);
-                        if (!communicator->sendRequest(request, &error))
-                        {
-                            error_message = std::format("failed to send request {}", error ? error->getMessage() : "unknown error");
-                            has_error = true;
-                        }
-
-                        if (!has_error)
-                        {
-                            responseListener->wait();
-
-                            O2G2Ptr<pricehistorymgr::IPriceHistoryCommunicatorResponse> response = responseListener->getResponse();
-                            if (response) {
-                                pricehistorymgr::IError* error = NULL;
-                                O2G2Ptr<IO2GMarketDataSnapshotResponseReader> reader = communicator->createResponseReader(response, &error);
-                                O2G2Ptr<pricehistorymgr::IError> autoError(error);
-                                if (reader) {
-                                    if (!reader->isBar())
-                                    {
-                                        error_message = std::format("failded sending request - expected bars");
-                                        has_error = true;
-                                    }
-                                    else {
-                                        auto n = reader->size();
-
-                                        if (n > 0) {
-                                            LocalFormat format;
-
-                                            spdlog::info(
-                                                "{} bars from {} to {} in request interval from {} to {}",
-                                                n, format.formatDate(reader->getDate(0)), format.formatDate(reader->getDate(n - 1)),
-                                                format.formatDate(date_from), format.formatDate(date_to)
-                                            );
+                    auto bars = bar_cache->get_bars(symbol, timeframe, common::nanos_to_date(from), common::nanos_to_date(to));
 
-                                            for (int i = 0; i < n; ++i) {
-                                                DATE dt = reader->getDate(i); // beginning of the bar
-
-                                                if (dt < date_from) {
-                                                    continue;
-                                                }
-
-                                                common::BidAskBar<DATE> bar(
-                                                    dt,
-                                                    reader->getBidOpen(i),
-                                                    reader->getBidHigh(i),
-                                                    reader->getBidLow(i),
-                                                    reader->getBidClose(i),
-                                                    reader->getAskOpen(i),
-                                                    reader->getAskHigh(i),
-                                                    reader->getAskLow(i),
-                                                    reader->getAskClose(i),
-                                                    reader->getVolume(i)
-                                                );
-
-                                                bars.emplace_back(bar);
-                                            }
-                                        }
-                                    }
-                                }
-                                else {
-                                    error_message = std::format("failed to create reader {}", error ? error->getMessage() : "unknown error");
-                                    has_error = true;
-                                }
-                            }
-                        }
-
-                        communicator->removeListener(responseListener);
+                    if (common::columnar::is_requested(req.get_param_value("format"), req.get_header_value("Accept"))) {
+                        res.set_content(common::to_columnar(bars), std::string(common::columnar::content_type));
                     }
                     else {
-                        error_message = std::format("communicator not ready or status listener timeout");
-                        has_error = true;
-                    }
-
-                    communicator->removeStatusListener(communicatorStatusListener);
-                    statusListener->reset();
-
-                    if (!has_error) {
                         auto content = common::to_json(bars);
                         res.set_content(content.dump(), "application/json");
                     }
-                    else {
-                        throw std::runtime_error(error_message);
-                    }
 
-                    spdlog::info("fetched {} number of bars", bars.size());
+                    auto stats = bar_cache->get_stats();
+                    spdlog::info(
+                        "fetched {} number of bars, cache requests={} fetches={} coalesced={} cached bars={}",
+                        bars.size(), stats.requests, stats.fetches, stats.coalesced, stats.cached_bars
+                    );
                 }
                 catch (...) {
                     std::string what = "unknown exception";
@@ -476,7 +552,9 @@ namespace fxcm {
                     }
 
                     spdlog::info(msg.str());
+                    auto binary = common::columnar::is_requested(req.get_param_value("format"), req.get_header_value("Accept"));
                     std::vector<common::Quote<DATE>> quotes;
+                    O2G2Ptr<IO2GMarketDataSnapshotResponseReader> tick_reader;
                     auto date_from = common::nanos_to_date(from);
                     auto date_to = common::nanos_to_date(to);
                     auto quotes_count = count;
@@ -544,7 +622,12 @@ namespace fxcm {
                                                 format.formatDate(date_from), format.formatDate(date_to)
                                             );
 
-                                            for (int i = 0; i < n; ++i) {
+                                            // the binary response is streamed from the reader after the request completed
+                                            if (binary) {
+                                                tick_reader = reader;
+                                            }
+
+                                            for (int i = 0; i < n && !binary; ++i) {
                                                 DATE dt = reader->getDate(i); // tick timestamp
 
                                                 if (dt < date_from) {
@@ -579,7 +662,10 @@ namespace fxcm {
                     communicator->removeStatusListener(communicatorStatusListener);
                     statusListener->reset();
 
-                    if (!has_error) {
+                    if (!has_error && binary) {
+                        set_tick_stream_content(res, tick_reader, date_from);
+                    }
+                    else if (!has_error) {
                         auto content = common::to_json(quotes);
                         res.set_content(content.dump(), "application/json");
                     }
@@ -587,7 +673,7 @@ namespace fxcm {
                         throw std::runtime_error(error_message);
                     }
 
-                    spdlog::info("fetched {} number of ticks", quotes.size());
+                    spdlog::info("fetched {} number of ticks", binary ? (tick_reader ? tick_reader->size() : 0) : quotes.size());
                 }
                 catch (...) {
                     std::string what = "unknown exception";
@@ -0,0 +1,221 @@
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "fxcm_market_data_server/bar_history_cache.h"
+#include "fxcm_market_data_server/history_source.h"
+
+using namespace fxcm;
+using namespace std::chrono_literals;
+
+typedef BarHistoryCache::DATE DATE;
+
+constexpr auto TIMEFRAME = "m1";
+constexpr int NUM_BARS = 100;
+
+// first bar of the test files, 2024-01-02 00:00:00 UTC
+const auto t0 = std::chrono::nanoseconds(1704153600000000000ll);
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+	if (!condition) {
+		++failures;
+		std::cout << "  FAILED: " << what << std::endl;
+	}
+}
+
+// start of the i-th one minute bar, converted as FileHistorySource converts it
+DATE bar_time(int i) {
+	return common::nanos_to_date(t0 + std::chrono::minutes(i));
+}
+
+void write_history_file(const FileHistorySource& source, const std::string& symbol) {
+	std::ofstream file(source.filename(symbol, TIMEFRAME));
+	file << "DateTime,BidOpen,BidHigh,BidLow,BidClose,AskOpen,AskHigh,AskLow,AskClose,Volume" << std::endl;
+	for (int i = 0; i < NUM_BARS; ++i) {
+		auto ns = (t0 + std::chrono::minutes(i)).count();
+		auto price = 1.0 + i * 0.0001;
+		file << std::format("{},{},{},{},{},{},{},{},{},{}", ns, price, price, price, price, price + 0.0002, price + 0.0002, price + 0.0002, price + 0.0002, i) << std::endl;
+	}
+}
+
+// bars i to j of the test files are complete and returned without gaps or duplicates
+bool has_bars(const std::vector<BarHistoryCache::Bar>& bars, int i, int j) {
+	if (bars.size() != (size_t)(j - i + 1)) {
+		return false;
+	}
+	for (int k = i; k <= j; ++k) {
+		if (bars[k - i].timestamp != bar_time(k)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+class CacheTest {
+public:
+	CacheTest(const std::filesystem::path& dir, std::chrono::milliseconds latency, size_t max_bars)
+		: source(std::make_shared<FileHistorySource>(dir.string(), latency))
+		, cache(source, max_bars)
+	{}
+
+	std::vector<BarHistoryCache::Bar> get_bars(const std::string& symbol, int i, int j) {
+		return cache.get_bars(symbol, TIMEFRAME, bar_time(i), bar_time(j), now);
+	}
+
+	std::future<std::vector<BarHistoryCache::Bar>> get_bars_async(const std::string& symbol, int i, int j) {
+		return std::async(std::launch::async, [this, symbol, i, j]() { return get_bars(symbol, i, j); });
+	}
+
+	std::shared_ptr<FileHistorySource> source;
+	BarHistoryCache cache;
+
+	// all bars of the test files are complete unless a test moves now back
+	DATE now{ bar_time(NUM_BARS + 10) };
+};
+
+void test_coalescing(const std::filesystem::path& dir) {
+	std::cout << "concurrent overlapping requests are coalesced" << std::endl;
+
+	CacheTest test(dir, 200ms, 10000);
+	auto first = test.get_bars_async("EUR/USD", 0, 40);
+	std::this_thread::sleep_for(50ms);
+	auto second = test.get_bars_async("EUR/USD", 20, 60);
+	auto third = test.get_bars_async("EUR/USD", 10, 30);
+
+	check(has_bars(first.get(), 0, 40), "the first request gets its bars");
+	check(has_bars(second.get(), 20, 60), "the overlapping request gets its bars");
+	check(has_bars(third.get(), 10, 30), "the contained request gets its bars");
+
+	auto stats = test.cache.get_stats();
+	check(test.source->num_requests() == 2, std::format("only the uncovered part is fetched, source requests {}", test.source->num_requests()));
+	check(stats.requests == 3 && stats.fetches == 2 && stats.coalesced == 2, "the later requests wait for the fetch in flight");
+}
+
+void test_adjacent_segments(const std::filesystem::path& dir) {
+	std::cout << "adjacent segments are merged" << std::endl;
+
+	CacheTest test(dir, 0ms, 10000);
+	check(has_bars(test.get_bars("EUR/USD", 0, 20), 0, 20), "the first segment");
+	check(has_bars(test.get_bars("EUR/USD", 20, 40), 20, 40), "the touching segment");
+	check(has_bars(test.get_bars("EUR/USD", 50, 60), 50, 60), "a separate segment");
+	check(test.cache.get_stats().cached_bars == 41 + 11, "the shared bar of the touching segments is cached once");
+
+	// fills the gap only, then all three segments are one
+	check(has_bars(test.get_bars("EUR/USD", 30, 55), 30, 55), "the request over the gap");
+	check(test.source->num_requests() == 4, "only the gap is fetched");
+	check(test.cache.get_stats().cached_bars == 61, "the gap joins the segments");
+
+	auto requests = test.source->num_requests();
+	check(has_bars(test.get_bars("EUR/USD", 0, 60), 0, 60), "the merged range");
+	check(test.source->num_requests() == requests, "the merged range is served from the cache");
+}
+
+void test_recent_bars(const std::filesystem::path& dir) {
+	std::cout << "bars which may still change are not cached" << std::endl;
+
+	CacheTest test(dir, 0ms, 10000);
+
+	// the bar starting at 90 is still open, the ones before are complete
+	test.now = bar_time(90) + 0.5 * timeframe_length(TIMEFRAME);
+	check(has_bars(test.get_bars("EUR/USD", 80, 90), 80, 90), "the recent bars are returned");
+	check(test.cache.get_stats().cached_bars == 10, "the open bar is not cached");
+
+	check(has_bars(test.get_bars("EUR/USD", 80, 90), 80, 90), "the recent bars are returned again");
+	check(test.source->num_requests() == 2, "the open bar is fetched again");
+
+	check(has_bars(test.get_bars("EUR/USD", 80, 89), 80, 89), "the complete bars");
+	check(test.source->num_requests() == 2, "the complete bars are served from the cache");
+
+	// once it completed the bar is cached as well
+	test.now = bar_time(92);
+	test.get_bars("EUR/USD", 80, 90);
+	test.get_bars("EUR/USD", 80, 90);
+	check(test.source->num_requests() == 3, "a completed bar is cached");
+}
+
+void test_failed_fetch(const std::filesystem::path& dir) {
+	std::cout << "a failed fetch reaches all waiters" << std::endl;
+
+	CacheTest test(dir, 200ms, 10000);
+	auto first = test.get_bars_async("XXX/YYY", 0, 40);
+	std::this_thread::sleep_for(50ms);
+	auto second = test.get_bars_async("XXX/YYY", 10, 30);
+
+	auto failed = [](std::future<std::vector<BarHistoryCache::Bar>>& result) {
+		try {
+			result.get();
+			return false;
+		}
+		catch (const std::runtime_error&) {
+			return true;
+		}
+	};
+	check(failed(first), "the fetching request fails");
+	check(failed(second), "the waiting request fails");
+	check(test.cache.get_stats().coalesced == 1 && test.source->num_requests() == 1, "the waiter did not fetch again");
+	check(test.cache.get_stats().cached_bars == 0, "nothing is cached");
+
+	// the failure is not cached, a later request fetches again
+	auto third = test.get_bars_async("XXX/YYY", 0, 40);
+	check(failed(third) && test.source->num_requests() == 2, "a later request fetches again");
+}
+
+void test_lru_eviction(const std::filesystem::path& dir) {
+	std::cout << "the least recently used symbol is evicted" << std::endl;
+
+	CacheTest test(dir, 0ms, 65);
+	test.get_bars("EUR/USD", 0, 19);
+	test.get_bars("USD/JPY", 0, 19);
+	test.get_bars("GBP/USD", 0, 19);
+	check(test.cache.get_stats().cached_bars == 60, "three symbols fit");
+
+	// touching EUR/USD leaves USD/JPY least recently used
+	test.get_bars("EUR/USD", 0, 19);
+	check(test.source->num_requests() == 3, "EUR/USD is served from the cache");
+
+	test.get_bars("AUD/USD", 0, 19);
+	check(test.cache.get_stats().cached_bars == 60, "the limit holds");
+
+	auto requests = test.source->num_requests();
+	test.get_bars("EUR/USD", 0, 19);
+	test.get_bars("GBP/USD", 0, 19);
+	test.get_bars("AUD/USD", 0, 19);
+	check(test.source->num_requests() == requests, "the recently used symbols stay cached");
+
+	test.get_bars("USD/JPY", 0, 19);
+	check(test.source->num_requests() == requests + 1, "the least recently used symbol was evicted");
+
+	// a single request beyond the limit is returned but not kept
+	auto bars = test.get_bars("EUR/USD", 0, 99);
+	check(has_bars(bars, 0, 99), "a request beyond the limit gets its bars");
+	check(test.cache.get_stats().cached_bars <= 65, "the limit holds for a single large request");
+}
+
+int main()
+{
+	auto dir = std::filesystem::temp_directory_path() / "test_bar_history_cache";
+	std::filesystem::create_directories(dir);
+	FileHistorySource files(dir.string());
+	for (auto symbol : { "EUR/USD", "USD/JPY", "GBP/USD", "AUD/USD" }) {
+		write_history_file(files, symbol);
+	}
+
+	test_coalescing(dir);
+	test_adjacent_segments(dir);
+	test_recent_bars(dir);
+	test_failed_fetch(dir);
+	test_lru_eviction(dir);
+
+	std::filesystem::remove_all(dir);
+
+	std::cout << (failures == 0 ? "all tests passed" : std::format("{} checks failed", failures)) << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -2,120 +2,256 @@
 #include <chrono>
 #include <iostream>
 #include <thread>
+#include <vector>
+#include <atomic>
+#include <format>
 
-#include "time_utils.h"
-#include "blocking_queue.h"
+#include "common/blocking_queue.h"
 
+using namespace common;
 using namespace std::chrono_literals;
 
-typedef std::chrono::time_point<std::chrono::system_clock> time_point;
+int failures = 0;
 
-struct Data {
-  friend std::ostream& operator<<(std::ostream&, const Data&);
+void check(bool condition, const std::string& what) {
+  if (!condition) {
+    ++failures;
+    std::cout << "  FAILED: " << what << std::endl;
+  }
+}
+
+// the consumer sees a strictly increasing subsequence of what the producer pushed, nothing is lost
+// without being counted as dropped
+void spsc_stress(FullPolicy policy, std::chrono::microseconds consumer_delay) {
+  std::cout << std::format("spsc stress policy={} consumer_delay={}", (int)policy, consumer_delay) << std::endl;
+
+  constexpr uint64_t n = 200000;
+  SpScQueue<uint64_t> queue(64, policy, 1000ms);
+  std::atomic<bool> produced{false};
+  uint64_t accepted = 0;
+
+  std::thread producer([&]() {
+    for (uint64_t i = 0; i < n; ++i) {
+      accepted += queue.push(i) ? 1 : 0;
+    }
+    produced = true;
+  });
+
+  uint64_t popped = 0;
+  uint64_t last = 0;
+  bool ordered = true;
+  auto consume = [&](uint64_t value) {
+    ordered = ordered && (popped == 0 || value > last);
+    last = value;
+    ++popped;
+    if (consumer_delay.count() > 0 && popped % 1024 == 0) {
+      std::this_thread::sleep_for(consumer_delay);
+    }
+  };
+  while (!produced || !queue.empty()) {
+    uint64_t value;
+    if (queue.pop(value, 10ms)) {
+      consume(value);
+    }
+  }
+  producer.join();
+
+  check(ordered, "items are popped in push order");
+  check(popped + queue.num_dropped() == n, std::format("popped {} + dropped {} == pushed {}", popped, queue.num_dropped(), n));
+  if (policy == FullPolicy::block) {
+    check(queue.num_dropped() == 0 && accepted == n, "block never drops while the consumer keeps up");
+  }
+  if (policy == FullPolicy::drop) {
+    check(accepted == popped, "drop accepts exactly the popped items");
+  }
+  if (policy == FullPolicy::overwrite) {
+    check(last == n - 1, "overwrite always keeps the newest item");
+  }
+}
+
+void spsc_block_timeout() {
+  std::cout << "spsc block timeout and overflow" << std::endl;
+
+  SpScQueue<int> queue(4, FullPolicy::block, 50ms);
+  for (int i = 0; i < 4; ++i) {
+    check(queue.push(i), "push into free slots");
+  }
 
-  std::string field;
-  int value;
-  time_point timestamp;
-};
+  auto start = std::chrono::steady_clock::now();
+  check(!queue.push(4), "push into a full ring gives up");
+  auto waited = std::chrono::steady_clock::now() - start;
+  check(waited >= 50ms, "the first push waits the block timeout");
 
-inline std::ostream& operator<<(std::ostream& ostream, const Data& data)
-{
-  return ostream << "[" << data.field << ": " << data.value
-                 << " created at " << to_string(data.timestamp) << "]";
+  start = std::chrono::steady_clock::now();
+  check(!queue.push(5), "overflowing push is dropped");
+  waited = std::chrono::steady_clock::now() - start;
+  check(waited < 25ms, "the overflowing push does not wait again");
+  check(queue.num_dropped() == 2, "both given up items are counted");
+
+  int item;
+  check(queue.pop(item) && item == 0, "pop the oldest item");
+  check(queue.push(6), "push succeeds once there is room");
+
+  // a consumer making room while the producer waits unblocks it
+  std::thread consumer([&]() {
+    std::this_thread::sleep_for(10ms);
+    int value;
+    queue.pop(value);
+  });
+  check(queue.push(7), "a waiting push succeeds when the consumer makes room");
+  consumer.join();
+
+  std::vector<int> items;
+  queue.pop_all([&](int value) { items.push_back(value); });
+  check(items == std::vector<int>({2, 3, 6, 7}), "the ring keeps its order across the overflow");
 }
 
-class Producer {
-  std::thread thread;
-  bool done{false};
-  bool started{false};
-  int count{0};
-  BlockingTimeoutQueue<Data>& queue;
-
-public:
-  explicit Producer(BlockingTimeoutQueue<Data>& queue) : queue(queue) {}
-
-  void run() {
-    while (!done) {
-      std::this_thread::sleep_for(1000ms);
-      const auto now = std::chrono::system_clock::now();
-      queue.push(Data{"field", ++count, now});
+void spsc_batches() {
+  std::cout << "spsc push batch, pop_all, pop_until and pop_until_last" << std::endl;
+
+  SpScQueue<std::string> queue(8, FullPolicy::drop);
+  std::vector<std::string> batch;
+  for (int i = 0; i < 10; ++i) {
+    batch.push_back(std::to_string(i));
+  }
+  check(queue.push(std::span<const std::string>(batch)) == 8, "a batch push accepts what fits");
+  check(queue.num_dropped() == 2, "the rest of the batch is dropped");
+
+  std::vector<std::string> items;
+  auto n = queue.pop_all([&](const std::string& item) { items.push_back(item); });
+  check(n == 8 && items.front() == "0" && items.back() == "7", "pop_all drains in order");
+  check(queue.empty(), "pop_all leaves the queue empty");
+
+  for (int i = 0; i < 5; ++i) {
+    queue.push(std::to_string(i));
+  }
+  std::vector<std::string> until;
+  check(queue.pop_until([&](const std::string& item) { until.push_back(item); return item == "2"; }, 10ms), "pop_until stops at the condition");
+  check(until.size() == 3 && queue.size() == 2, "pop_until leaves the remaining items");
+  check(!queue.pop_until([&](const std::string& item) { return item == "9"; }, 10ms), "pop_until times out without the condition");
+
+  for (int i = 0; i < 5; ++i) {
+    queue.push(std::to_string(i));
+  }
+  std::string last;
+  check(queue.pop_until_last(last) && last == "4", "pop_until_last keeps the newest item");
+  check(queue.empty() && !queue.pop_until_last(last), "pop_until_last consumes everything");
+
+  // pop_all with a concurrent producer loses nothing
+  SpScQueue<int> concurrent(256, FullPolicy::block, 1000ms);
+  constexpr int m = 100000;
+  std::thread producer([&]() {
+    std::vector<int> chunk;
+    for (int i = 0; i < m; i += 10) {
+      chunk.clear();
+      for (int j = i; j < i + 10; ++j) {
+        chunk.push_back(j);
+      }
+      concurrent.push(std::span<const int>(chunk));
     }
+  });
+  int expected = 0;
+  bool ordered = true;
+  while (expected < m) {
+    concurrent.pop_all([&](int value) { ordered = ordered && value == expected; ++expected; });
   }
+  producer.join();
+  check(ordered && concurrent.num_dropped() == 0, "concurrent batches arrive complete and in order");
+}
+
+// several producers, each producer's items arrive in its order and none is lost
+void blocking_timeout_queue_stress(WaitStrategy strategy) {
+  std::cout << std::format("blocking timeout queue stress strategy={}", (int)strategy) << std::endl;
+
+  constexpr int num_producers = 4;
+  constexpr int n = 50000;
+  BlockingTimeoutQueue<std::pair<int, int>> queue(strategy);
 
-  void start() {
-    std::cout << "Producer started..." << std::endl;
-    started = true;
-    thread = std::thread(&Producer::run, this);
-  }
-
-  void cancel() {
-    if (!started)
-      return;
-    done = true;
-    started = false;
-    if (thread.joinable())
-      thread.join();
-    std::cout << "Producer stopped" << std::endl;
-  }
-};
-
-class Consumer {
-  std::thread thread;
-  bool done{false};
-  bool started{false};
-  BlockingTimeoutQueue<Data>& queue;
-
-public:
-  explicit Consumer(BlockingTimeoutQueue<Data>& queue) : queue(queue) {}
-
-  void run() const {
-    while (!done) {
-      Data data;
-      const auto start = std::chrono::system_clock::now();
-      if (const auto success = queue.pop(data, 5000ms)) {
-        const auto now = std::chrono::system_clock::now();
-        const auto latency = std::chrono::duration_cast<std::chrono::microseconds>(now - data.timestamp).count();
-        const auto waiting_time = std::chrono::duration_cast<std::chrono::microseconds>(now - start).count();
-        std::cout << "Consumer popped " << data
-                  << " @ " << to_string(now)
-                  << " with latency " << latency << "us"
-                  << " with waiting time " << (waiting_time / 1000.0) << "ms" << std::endl;
-      } else {
-        std::cout << "***** Consumer timeout!" << std::endl;
+  std::vector<std::thread> producers;
+  for (int p = 0; p < num_producers; ++p) {
+    producers.emplace_back([&queue, p]() {
+      for (int i = 0; i < n; ++i) {
+        queue.push(std::make_pair(p, i));
       }
+    });
+  }
+
+  std::vector<int> next(num_producers, 0);
+  bool ordered = true;
+  int popped = 0;
+  auto consume = [&](const std::pair<int, int>& item) {
+    ordered = ordered && item.second == next[item.first];
+    next[item.first] = item.second + 1;
+    ++popped;
+  };
+  while (popped < num_producers * n) {
+    std::pair<int, int> item;
+    if (popped % 3 == 0) {
+      queue.pop_all(consume);
+    }
+    else if (queue.pop(item, 1000ms)) {
+      consume(item);
     }
+    else {
+      break;
+    }
+  }
+  for (auto& producer : producers) {
+    producer.join();
   }
 
-  void start() {
-    std::cout << "Consumer started..." << std::endl;
-    started = true;
-    thread = std::thread(&Consumer::run, this);
+  check(ordered, "per producer order is kept");
+  check(popped == num_producers * n, std::format("popped {} of {}", popped, num_producers * n));
+  check(queue.size() == 0, "nothing is left pending");
+}
+
+void blocking_timeout_queue_wake_up(WaitStrategy strategy) {
+  std::cout << std::format("blocking timeout queue wake up strategy={}", (int)strategy) << std::endl;
+
+  BlockingTimeoutQueue<int> queue(strategy);
+  int item;
+
+  auto start = std::chrono::steady_clock::now();
+  check(!queue.pop(item, 20ms), "pop times out on an empty queue");
+  check(std::chrono::steady_clock::now() - start >= 20ms, "pop waits its timeout");
+
+  // the push comes after the spin phase, so the consumer is parked and must be notified
+  for (int round = 0; round < 20; ++round) {
+    std::thread producer([&queue, round]() {
+      std::this_thread::sleep_for(5ms);
+      queue.push(round);
+    });
+    start = std::chrono::steady_clock::now();
+    auto success = queue.pop(item, 2000ms);
+    auto waited = std::chrono::steady_clock::now() - start;
+    producer.join();
+    check(success && item == round, "the parked consumer gets the item");
+    check(waited < 500ms, std::format("the parked consumer wakes up on push, waited {}", std::chrono::duration_cast<std::chrono::milliseconds>(waited)));
   }
 
-  void cancel() {
-    if (!started)
-      return;
-    done = true;
-    started = false;
-    if (thread.joinable())
-      thread.join();
-    std::cout << "Consumer stopped" << std::endl;
+  for (int i = 0; i < 5; ++i) {
+    queue.push(i);
   }
-};
+  std::vector<int> until;
+  check(queue.pop_until([&](int value) { until.push_back(value); return value == 3; }, 10ms), "pop_until stops at the condition");
+  check(until.size() == 4, "pop_until consumed up to the condition");
+  check(queue.pop(item) && item == 4, "the rest stays queued");
+}
 
 int main([[maybe_unused]]int argc, [[maybe_unused]]char **argv) {
+  for (auto policy : {FullPolicy::overwrite, FullPolicy::drop, FullPolicy::block}) {
+    spsc_stress(policy, 0us);
+    spsc_stress(policy, 200us);
+  }
+  spsc_block_timeout();
+  spsc_batches();
 
-  BlockingTimeoutQueue<Data> queue(false);
-  Producer producer(queue);
-  Consumer consumer(queue);
-  std::cout << "Waiting in main thread..." << std::endl;
-
-  consumer.start();
-  producer.start();
+  for (auto strategy : {WaitStrategy::condition_variable, WaitStrategy::spin_then_park, WaitStrategy::busy_spin}) {
+    blocking_timeout_queue_stress(strategy);
+  }
+  blocking_timeout_queue_wake_up(WaitStrategy::condition_variable);
+  blocking_timeout_queue_wake_up(WaitStrategy::spin_then_park);
 
-  std::this_thread::sleep_for(15s);
-  std::cout << "stopping producer and consumer..." << std::endl;
-  producer.cancel();
-  consumer.cancel();
-  std::cout << "done" << std::endl;
+  std::cout << (failures == 0 ? "all tests passed" : std::format("{} checks failed", failures)) << std::endl;
+  return failures == 0 ? 0 : 1;
 }
@@ -129,6 +129,7 @@ public:
 	MarketDataSubscriptionTest() : FixTest() {};
 
 	void test() {
+		auto version = top_of_book_store.version("AUD/USD");
 		service->client().subscribe_market_data(FIX::Symbol("AUD/USD"), false);
 
 		auto wait = 2s;
@@ -136,7 +137,7 @@ public:
 		int success = 0;
 		for (int i = 0; i < n; ++i) {
 			TopOfBook top;
-			if (top_of_book_queue.pop(top, wait)) {
+			if (top_of_book_store.wait("AUD/USD", version, top, wait)) {
 				log::debug<0, true>("{}", top.to_string());
 				++success;
 			}
@@ -151,12 +152,13 @@ public:
 	MarketDataUnsubscriptionTest() : FixTest() {};
 
 	void test() {
+		auto version = top_of_book_store.version("AUD/USD");
 		service->client().subscribe_market_data(FIX::Symbol("AUD/USD"), false);
 
 		auto wait = 2s;
 		int success = 0;
 		TopOfBook top;
-		if (top_of_book_queue.pop(top, wait)) {
+		if (top_of_book_store.wait("AUD/USD", version, top, wait)) {
 			log::debug<0, true>("{}", top.to_string());
 			++success;
 		}
@@ -176,12 +178,13 @@ public:
 	MarketDataSubscriptionSnapshotTest() : FixTest() {};
 
 	void test() {
+		auto version = top_of_book_store.version("AUD/USD");
 		service->client().market_data_snapshot(FIX::Symbol("AUD/USD"), false);
 
 		auto wait = 2s;
 		int success = 0;
 		TopOfBook top;
-		if (top_of_book_queue.pop(top, wait)) {
+		if (top_of_book_store.wait("AUD/USD", version, top, wait)) {
 			log::debug<0, true>("{}", top.to_string());
 			++success;
 		}
@@ -195,6 +198,7 @@ public:
 	MarketDataSubscriptionSnapshotThenIncrementalTest() : FixTest() {};
 
 	void test() {
+		auto version = top_of_book_store.version("EUR/USD");
 		service->client().market_data_snapshot(FIX::Symbol("EUR/USD"), false, true);
 
 		auto wait = 1s;
@@ -202,7 +206,7 @@ public:
 		int success = 0;
 		for (int i = 0; i < n; ++i) {
 			TopOfBook top;
-			if (top_of_book_queue.pop(top, wait)) {
+			if (top_of_book_store.wait("EUR/USD", version, top, wait)) {
 				log::debug<0, true>("{}", top.to_string());
 				++success;
 			}
@@ -11,9 +11,11 @@ using namespace zorro;
 
 namespace fxcm {
 
-	BlockingTimeoutQueue<TopOfBook> top_of_book_queue;
-	BlockingTimeoutQueue<ExecReport> exec_report_queue;
-	BlockingTimeoutQueue<StatusExecReport> status_exec_report_queue;
+	// transport from the QuickFIX callback thread, quotes are conflated, order reports wait up to
+	// the block timeout of the queue for room so that a stalled consumer cannot stall the FIX session
+	TopOfBookStore top_of_book_store;
+	SpScQueue<ExecReport> exec_report_queue(8192, FullPolicy::block);
+	SpScQueue<StatusExecReport> status_exec_report_queue(8192, FullPolicy::block);
 	BlockingTimeoutQueue<ServiceMessage> service_message_queue;
 	BlockingTimeoutQueue<FXCMPositionReport> position_report_queue;
 	BlockingTimeoutQueue<FXCMPositionReports> position_snapshot_reports_queue;
@@ -202,7 +204,7 @@ namespace fxcm {
 			2,
 			exec_report_queue,
 			status_exec_report_queue,
-			top_of_book_queue,
+			top_of_book_store,
 			service_message_queue,
 			position_report_queue,
 			position_snapshot_reports_queue,
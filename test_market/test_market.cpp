@@ -1,196 +1,244 @@
-//#include <iostream>
-//#include <format>
-//
-//#include "common/market.h"
-//#include "common/order_matcher.h"
-//#include "common/market_data.h"
-//#include "common/price_sampler.h"
-//#include "common/white_noise.h"
-//#include "common/time_utils.h"
-//
-//using namespace common;
-//
-//constexpr auto SYMBOL = "APPL";
-//
-//static int ord_id = 0; 
-//
-//std::mutex mutex;
-//
-//auto by_quantity = [](const Order& o) {return o.get_quantity(); };
-//auto by_open_quantity = [](const Order& o) {return o.get_open_quantity(); };
-//auto by_last_exec_quantity = [](const Order& o) {return o.get_last_executed_quantity(); };
-//
-//std::string generate_id(const std::string& label) {
-//	return std::format("{}_{}", label, ++ord_id);
-//}
-//
-//Order create_order(
-//	Order::Side side, 
-//	double price, 
-//	long quantity=100, 
-//	const std::string& owner = "market", 
-//	Order::Type type=Order::Type::limit,
-//	const std::string& target="target") {
-//	return Order(generate_id("ord_id"), generate_id("cl_ord_id"), SYMBOL, owner, target, side, type, price, quantity);
-//}
-//
-//void test_quoting() {
-//	std::random_device random_device;
-//	std::mt19937 generator(random_device());
-//	auto tick_scale = 100000.0;
-//	auto tick_size = 0.00001;
-//	auto sampler = std::make_shared<WhiteNoise>(
-//		SYMBOL,
-//		generator,
-//		0.4,
-//		tick_scale
-//	);
-//
-//	std::queue<Order> order_q;
-//	auto matcher = OrderMatcher(mutex);
-//
-//	auto n = 100;
-//	auto dt = std::chrono::hours(12);
-//	auto t0 = get_current_system_clock() - n*dt;
-//
-//	auto bid = 100.0;
-//	auto ask = 101.0;
-//	auto current = TopOfBook(SYMBOL, t0, bid, 10, ask, 11);
-//
-//	// two trader orders, two from the market 
-//	auto o1 = create_order(Order::Side::buy, bid - 10*tick_size, 2, "trader");
-//	auto o2 = create_order(Order::Side::sell, ask + 10 * tick_size, 2, "trader");
-//	auto o_bid = create_order(Order::Side::buy, current.bid_price, 100, "market");
-//	auto o_ask = create_order(Order::Side::sell, current.ask_price, 100, "market");
-//
-//	matcher.insert(o1);
-//	matcher.insert(o2);
-//	matcher.insert(o_bid);
-//	matcher.insert(o_ask);
-//
-//	assert(order_q.empty());
-//
-//	for (auto i = 0; i < 5000; ++i) {
-//		t0 += dt;
-//		auto next = sampler->sample(current, t0);
-//
-//		//std::cout << std::format("{:>8.1f} | {:<8.1f}", next.bid_price, next.ask_price) << std::endl;
-//
-//		if (next.bid_price != current.bid_price) {
-//			matcher.erase(o_bid.get_ord_id(), o_bid.get_side());
-//			o_bid = create_order(Order::Side::buy, next.bid_price, 100, "market");
-//			matcher.insert(o_bid, order_q);
-//		}
-//
-//		if (next.ask_price != current.ask_price) {
-//			matcher.erase(o_ask.get_ord_id(), o_ask.get_side());
-//			o_ask = create_order(Order::Side::sell, next.ask_price, 100, "market");
-//			matcher.insert(o_ask);
-//		}
-//
-//		if (!order_q.empty()) {
-//			std::cout << "match at " << t0 << std::endl;
-//			std::cout << std::format("  current {:>8.5f} | {:<8.5f}", current.bid_price, current.ask_price) << std::endl;
-//			std::cout << std::format("  next    {:>8.5f} | {:<8.5f}", next.bid_price, next.ask_price) << std::endl;
-//		}
-//
-//		std::vector<Order> new_orders;
-//		while (!order_q.empty()) {
-//			auto& o = order_q.front();
-//
-//			std::cout << std::format(
-//				"  {} price={:>8.5f}, exec price={:>8.5f} owner={}", 
-//				to_string(o.get_side()), o.get_price(), o.get_last_executed_price(), o.get_owner()
-//			) << std::endl;
-//
-//			if (o.get_side() == Order::buy && o.get_owner() == "trader") {
-//				auto price = next.bid_price - 10 * tick_size;
-//				auto o = create_order(Order::Side::buy, price, 2, "trader");
-//				new_orders.emplace_back(o);
-//				std::cout << std::format("  new buy order at {:>8.5f}", price) << std::endl;
-//			}
-//
-//			if (o.get_side() == Order::sell && o.get_owner() == "trader") {
-//				auto price = next.ask_price + 10 * tick_size;
-//				auto o = create_order(Order::Side::sell, price, 2, "trader");
-//				new_orders.emplace_back(o);
-//				std::cout << std::format("  new sell order at {:>8.5f}", price) << std::endl;
-//			}
-//
-//			order_q.pop();
-//		}
-//
-//		auto m = 0;
-//		for (auto& o : new_orders) {
-//			auto [op, error, dm] = matcher.insert(o, order_q);
-//			m += dm;
-//		}
-//
-//		// should not have any matches
-//		assert(m == 0 && order_q.empty());
-//
-//		current = next;
-//	}
-//}
-//
-//void test_aggressive_sell() {
-//	auto matcher = OrderMatcher(mutex);
-//
-//	auto o1 = create_order(Order::Side::buy, 100, 1, "trader");
-//	auto o2 = create_order(Order::Side::sell, 110, 1, "trader");
-//	matcher.insert(o1);
-//	matcher.insert(o2);
-//	std::cout << "by_quantity" << std::endl;
-//	print_levels(matcher, by_quantity);
-//
-//	auto o3 = create_order(Order::Side::sell, 90, 10, "market");
-//	matcher.insert(o3);
-//	std::cout << "by_quantity" << std::endl;
-//	print_levels(matcher, by_quantity);
-//
-//	std::cout << "by_last_exec_quantity" << std::endl;
-//	print_levels(matcher, by_last_exec_quantity);
-//	std::cout << "by_open_quantity" << std::endl;
-//	print_levels(matcher, by_open_quantity);
-//
-//	while (!order_q.empty()) {
-//		std::cout << order_q.front().to_string() << std::endl;
-//		order_q.pop();
-//	}
-//}
-//
-//void test_aggressive_buy() {
-//	auto matcher = OrderMatcher(mutex);
-//
-//	std::queue<Order> order_q;
-//
-//	auto o1 = create_order(Order::Side::buy, 100, 1, "trader");
-//	auto o2 = create_order(Order::Side::sell, 110, 1, "trader");
-//	matcher.insert(o1, order_q);
-//	matcher.insert(o2, order_q);
-//	std::cout << "by_quantity" << std::endl;
-//	print_levels(matcher, by_quantity);
-//
-//	auto o3 = create_order(Order::Side::buy, 120, 10, "market");
-//	matcher.insert(o3, order_q);
-//	std::cout << "by_quantity" << std::endl;
-//	print_levels(matcher, by_quantity);
-//
-//	std::cout << "by_last_exec_quantity" << std::endl;
-//	print_levels(matcher, by_last_exec_quantity);
-//	std::cout << "by_open_quantity" << std::endl;
-//	print_levels(matcher, by_open_quantity);
-//
-//	while (!order_q.empty()) {
-//		std::cout << order_q.front().to_string() << std::endl;
-//		order_q.pop();
-//	}
-//}
-//
+#include <iostream>
+#include <format>
+#include <vector>
+#include <array>
+
+#include "common/order_matcher.h"
+
+using namespace common;
+
+constexpr auto SYMBOL = "APPL";
+
+const PriceScale price_scale(100.0);
+
+int failures = 0;
+
+void check(bool condition, const std::string& what) {
+	if (!condition) {
+		++failures;
+		std::cout << "  FAILED: " << what << std::endl;
+	}
+}
+
+Order create_order(uint64_t ord_id, Order::Side side, double price, long quantity = 100, Order::Type type = Order::Type::limit) {
+	return Order(ord_id, std::format("cl_ord_id_{}", ord_id), SYMBOL, "trader", "market", side, type, price, quantity);
+}
+
+// records the match events of the matcher in the order they were reported
+struct RecordingListener {
+	void on_accept(const Order& order) { accepted.push_back(order.get_ord_id()); }
+
+	void on_fill(const Fill& fill) {
+		fills.push_back(RecordedFill{ fill.maker != nullptr ? fill.maker->get_ord_id() : 0, fill.taker->get_ord_id(), fill.price.get_ticks(), fill.quantity });
+	}
+
+	void on_cancel(const Order& order) { canceled.push_back(order.get_ord_id()); }
+
+	void on_reject(const Order& order) { rejected.push_back(order.get_ord_id()); }
+
+	struct RecordedFill {
+		uint64_t maker;
+		uint64_t taker;
+		int64_t price;
+		long quantity;
+
+		bool operator==(const RecordedFill&) const = default;
+	};
+
+	std::vector<uint64_t> accepted;
+	std::vector<RecordedFill> fills;
+	std::vector<uint64_t> canceled;
+	std::vector<uint64_t> rejected;
+};
+
+// order ids of the level at the price in queue order
+std::vector<uint64_t> queue_of(const OrderMatcher& matcher, Order::Side side, double price) {
+	std::vector<uint64_t> ord_ids;
+	matcher.for_each_level(side, 0, [&](const PriceLevel& level) {
+		if (level.price == price_scale.to_price(price)) {
+			for (auto node = level.head; node != nullptr; node = node->next) {
+				ord_ids.push_back(node->order.get_ord_id());
+			}
+		}
+	});
+	return ord_ids;
+}
+
+std::optional<LevelAggregate> level_of(const OrderMatcher& matcher, Order::Side side, double price) {
+	std::array<LevelAggregate, 16> levels;
+	auto n = matcher.level_aggregates(side, levels);
+	for (size_t i = 0; i < n; ++i) {
+		if (levels[i].price == price_scale.to_price(price)) {
+			return levels[i];
+		}
+	}
+	return std::optional<LevelAggregate>();
+}
+
+void test_price_time_priority() {
+	std::cout << "price time priority across levels" << std::endl;
+
+	OrderMatcher matcher(price_scale);
+	RecordingListener listener;
+	matcher.insert(create_order(1, Order::sell, 101.0), listener);
+	matcher.insert(create_order(2, Order::sell, 101.0), listener);
+	matcher.insert(create_order(3, Order::sell, 100.0), listener);
+	matcher.insert(create_order(4, Order::sell, 102.0), listener);
+	check(listener.accepted == std::vector<uint64_t>({ 1, 2, 3, 4 }), "resting orders are accepted");
+
+	matcher.insert(create_order(5, Order::buy, 101.0, 250), listener);
+	auto expected = std::vector<RecordingListener::RecordedFill>({
+		{ 3, 5, 10000, 100 },
+		{ 1, 5, 10100, 100 },
+		{ 2, 5, 10100, 50 }
+	});
+	check(listener.fills == expected, "the best level fills first, then the level in time order");
+	check(listener.accepted.size() == 4, "the filled taker does not rest");
+	check(!matcher.find(3, Order::sell) && !matcher.find(1, Order::sell), "filled makers leave the book");
+	check(!level_of(matcher, Order::sell, 100.0), "the emptied level is removed");
+	check(queue_of(matcher, Order::sell, 101.0) == std::vector<uint64_t>({ 2 }), "the partially filled maker stays");
+	check(queue_of(matcher, Order::sell, 102.0) == std::vector<uint64_t>({ 4 }), "a level beyond the limit is untouched");
+
+	listener.fills.clear();
+	matcher.insert(create_order(6, Order::buy, 101.0, 80), listener);
+	check(listener.fills.size() == 1 && listener.fills[0].maker == 2 && listener.fills[0].quantity == 50, "the taker sweeps the rest of the level");
+	check(listener.accepted.back() == 6, "the remainder of the taker rests");
+	auto rested = matcher.find(6, Order::buy);
+	check(rested && rested->get_open_quantity() == 30 && rested->get_executed_quantity() == 50, "the rested taker keeps its open quantity");
+}
+
+void test_partial_fill_against_fifo() {
+	std::cout << "partial fill against the resting fifo" << std::endl;
+
+	OrderMatcher matcher(price_scale);
+	RecordingListener listener;
+	for (uint64_t ord_id = 1; ord_id <= 3; ++ord_id) {
+		matcher.insert(create_order(ord_id, Order::buy, 100.0), listener);
+	}
+
+	matcher.insert(create_order(4, Order::sell, 100.0, 150), listener);
+	auto expected = std::vector<RecordingListener::RecordedFill>({
+		{ 1, 4, 10000, 100 },
+		{ 2, 4, 10000, 50 }
+	});
+	check(listener.fills == expected, "the head of the queue fills first");
+	check(queue_of(matcher, Order::buy, 100.0) == std::vector<uint64_t>({ 2, 3 }), "the partially filled order keeps its place");
+
+	auto partial = matcher.find(2, Order::buy);
+	check(partial && partial->get_open_quantity() == 50, "the partially filled order has the rest open");
+	auto level = level_of(matcher, Order::buy, 100.0);
+	check(level && level->open_quantity == 150 && level->count == 2, "the level totals follow the fills");
+}
+
+void test_amend() {
+	std::cout << "amend down keeps priority, up re-queues, to zero removes" << std::endl;
+
+	OrderMatcher matcher(price_scale);
+	RecordingListener listener;
+	matcher.insert(create_order(1, Order::buy, 100.0), listener);
+	matcher.insert(create_order(2, Order::buy, 100.0), listener);
+	matcher.insert(create_order(3, Order::buy, 100.0), listener);
+
+	auto amended = matcher.amend(1, 50);
+	check(amended && amended->get_quantity() == 50, "amend down returns the amended order");
+	check(queue_of(matcher, Order::buy, 100.0) == std::vector<uint64_t>({ 1, 2, 3 }), "amend down keeps the place in the queue");
+	auto level = level_of(matcher, Order::buy, 100.0);
+	check(level && level->quantity == 250 && level->open_quantity == 250, "amend down updates the level totals");
+
+	matcher.amend(1, 200);
+	check(queue_of(matcher, Order::buy, 100.0) == std::vector<uint64_t>({ 2, 3, 1 }), "amend up moves to the back of the queue");
+	level = level_of(matcher, Order::buy, 100.0);
+	check(level && level->quantity == 400 && level->open_quantity == 400, "amend up updates the level totals");
+
+	matcher.amend(2, 0);
+	check(!matcher.find(2, Order::buy), "amend to zero removes the order");
+	check(queue_of(matcher, Order::buy, 100.0) == std::vector<uint64_t>({ 3, 1 }), "the rest of the queue keeps its order");
+
+	// amending a partially filled order to its executed quantity closes it
+	matcher.insert(create_order(4, Order::sell, 100.0, 30), listener);
+	matcher.amend(3, 30);
+	check(!matcher.find(3, Order::buy), "amend to the executed quantity removes the order");
+
+	matcher.amend(1, 0);
+	check(!level_of(matcher, Order::buy, 100.0), "removing the last order removes the level");
+	check(!matcher.amend(1, 100), "amending an unknown order fails");
+}
+
+void test_duplicate_ord_id() {
+	std::cout << "duplicate ord_id rejection" << std::endl;
+
+	OrderMatcher matcher(price_scale);
+	RecordingListener listener;
+	check(matcher.insert(create_order(1, Order::buy, 100.0), listener), "the first insert is accepted");
+	check(!matcher.insert(create_order(1, Order::buy, 99.0, 10), listener), "the duplicate insert fails");
+	check(listener.rejected == std::vector<uint64_t>({ 1 }), "the duplicate is rejected");
+	check(!level_of(matcher, Order::buy, 99.0), "the duplicate does not rest");
+
+	// a crossing duplicate must not trade either
+	matcher.insert(create_order(2, Order::sell, 101.0), listener);
+	check(!matcher.insert(create_order(2, Order::buy, 101.0), listener), "the crossing duplicate fails");
+	check(listener.fills.empty(), "the crossing duplicate does not fill");
+
+	auto result = matcher.insert(create_order(1, Order::sell, 102.0));
+	check(result.error && !result.resting_order, "the insert result reports the duplicate");
+
+	auto original = matcher.find(1, Order::buy);
+	check(original && original->get_price() == 100.0 && original->get_quantity() == 100, "the original order is unchanged");
+}
+
+void test_index_growth() {
+	std::cout << "find and erase after the order index grows" << std::endl;
+
+	// well beyond the initial bucket count so the index rehashes several times
+	constexpr uint64_t n = 10000;
+	OrderMatcher matcher(price_scale);
+	RecordingListener listener;
+	for (uint64_t ord_id = 1; ord_id <= n; ++ord_id) {
+		auto side = ord_id % 2 == 0 ? Order::buy : Order::sell;
+		auto price = side == Order::buy ? 100.0 - (double)(ord_id % 50) : 101.0 + (double)(ord_id % 50);
+		matcher.insert(create_order(ord_id, side, price, (long)ord_id), listener);
+	}
+	check(listener.fills.empty() && listener.accepted.size() == n, "no order crosses");
+
+	bool found = true;
+	for (uint64_t ord_id = 1; ord_id <= n; ++ord_id) {
+		auto side = ord_id % 2 == 0 ? Order::buy : Order::sell;
+		auto order = matcher.find(ord_id, side);
+		found = found && order && order->get_quantity() == (long)ord_id;
+		found = found && !matcher.find(ord_id, side == Order::buy ? Order::sell : Order::buy);
+	}
+	check(found, "every order is found on its side only");
+
+	bool erased = true;
+	for (uint64_t ord_id = 1; ord_id <= n; ord_id += 3) {
+		auto side = ord_id % 2 == 0 ? Order::buy : Order::sell;
+		auto order = matcher.erase(ord_id, side);
+		erased = erased && order && order->get_ord_id() == ord_id;
+	}
+	check(erased, "every erase returns the erased order");
+
+	bool consistent = true;
+	for (uint64_t ord_id = 1; ord_id <= n; ++ord_id) {
+		auto side = ord_id % 2 == 0 ? Order::buy : Order::sell;
+		auto present = matcher.find(ord_id, side).has_value();
+		consistent = consistent && present == ((ord_id - 1) % 3 != 0);
+	}
+	check(consistent, "erased orders are gone and the others are still found");
+	check(matcher.erase(n + 1, Order::buy) == std::nullopt, "erasing an unknown order fails");
+	check(matcher.erase(1, Order::sell) == std::nullopt, "erasing twice fails");
+
+	matcher.erase(2, Order::buy, listener);
+	check(listener.canceled == std::vector<uint64_t>({ 2 }), "erase with a listener reports the cancel");
+}
+
 int main()
 {
-	//test_quoting();
-	//test_aggressive_sell();
-	//test_aggressive_buy();
-}
+	test_price_time_priority();
+	test_partial_fill_against_fifo();
+	test_amend();
+	test_duplicate_ord_id();
+	test_index_growth();
 
+	std::cout << (failures == 0 ? "all tests passed" : std::format("{} checks failed", failures)) << std::endl;
+	return failures == 0 ? 0 : 1;
+}
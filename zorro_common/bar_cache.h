@@ -0,0 +1,250 @@
+#pragma once
+
+#include "pch.h"
+#include "zorro.h"
+
+#include <cstring>
+
+#include "common/bar.h"
+
+namespace zorro {
+
+	using common::BidAskBar;
+
+	/*
+	 * Persistent store of the bid ask bars of one symbol and time frame, backed by a memory mapped file.
+	 *
+	 * The cache covers the bar start times [covered_from, covered_to) without gaps, i.e. every bar the
+	 * market data server has for that range is in the file, sorted by timestamp. Only complete bars are
+	 * stored, so the covered range can only be extended at the front by rewriting the file or at the
+	 * back by appending the missing tail.
+	 *
+	 * File layout: a Header followed by count Records, all in native byte order. Appends write the
+	 * records before the header, so a torn append loses at most the new records.
+	 */
+	class BarCache {
+	public:
+		static constexpr char magic[8] = { 'Z', 'B', 'A', 'R', 'C', 'A', 'C', 'H' };
+		static constexpr uint32_t version = 1;
+
+		struct Header {
+			char magic[8];
+			uint32_t version;
+			uint32_t record_size;
+			DATE covered_from;
+			DATE covered_to;
+			uint64_t count;
+		};
+
+		struct Record {
+			DATE timestamp;
+			double bid_open;
+			double bid_high;
+			double bid_low;
+			double bid_close;
+			double ask_open;
+			double ask_high;
+			double ask_low;
+			double ask_close;
+			double volume;
+		};
+
+		// opens or creates the file, a file with an unknown layout is reinitialized empty
+		explicit BarCache(const std::string& filename)
+			: filename(filename)
+		{
+			file = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (file == INVALID_HANDLE_VALUE) {
+				throw std::runtime_error(std::format("BarCache: cannot open {} error={}", filename, GetLastError()));
+			}
+			LARGE_INTEGER file_size{};
+			GetFileSizeEx(file, &file_size);
+			bool valid = static_cast<uint64_t>(file_size.QuadPart) >= sizeof(Header);
+			if (valid) {
+				map();
+				valid = std::memcmp(header()->magic, magic, sizeof(magic)) == 0
+					&& header()->version == version
+					&& header()->record_size == sizeof(Record);
+			}
+			if (!valid) {
+				reset({}, 0, 0);
+			}
+			else if (sizeof(Header) + header()->count * sizeof(Record) > mapped_size) {
+				// the file was truncated behind our back, start over
+				reset({}, 0, 0);
+			}
+		}
+
+		BarCache(const BarCache&) = delete;
+
+		BarCache& operator=(const BarCache&) = delete;
+
+		~BarCache() {
+			unmap();
+			CloseHandle(file);
+		}
+
+		const std::string& get_filename() const {
+			return filename;
+		}
+
+		size_t size() const {
+			return static_cast<size_t>(header()->count);
+		}
+
+		// true if no range is covered yet, a covered range can still have no bars e.g. over a weekend
+		bool empty() const {
+			return header()->covered_to <= header()->covered_from;
+		}
+
+		DATE covered_from() const {
+			return header()->covered_from;
+		}
+
+		DATE covered_to() const {
+			return header()->covered_to;
+		}
+
+		// timestamp of the last cached bar, zero if there is none
+		DATE last_timestamp() const {
+			return size() > 0 ? records()[size() - 1].timestamp : 0;
+		}
+
+		DATE first_timestamp() const {
+			return size() > 0 ? records()[0].timestamp : 0;
+		}
+
+		// appends the cached bars with a timestamp in [from, to] to bars, returns the number added
+		size_t read(DATE from, DATE to, std::vector<BidAskBar<DATE>>& bars) const {
+			auto first = records();
+			auto last = first + size();
+			auto it = std::lower_bound(first, last, from, [](const Record& r, DATE t) { return r.timestamp < t; });
+			size_t n = 0;
+			for (; it != last && it->timestamp <= to; ++it, ++n) {
+				bars.emplace_back(
+					it->timestamp,
+					it->bid_open, it->bid_high, it->bid_low, it->bid_close,
+					it->ask_open, it->ask_high, it->ask_low, it->ask_close,
+					it->volume
+				);
+			}
+			return n;
+		}
+
+		/*
+		 * Appends the bars after the last cached bar and extends the coverage to covered_to. The bars
+		 * must be sorted and complete, bars at or before the last cached bar are skipped.
+		 */
+		void append(const std::vector<BidAskBar<DATE>>& bars, DATE covered_to) {
+			auto last = last_timestamp();
+			auto count = header()->count;
+			std::vector<Record> tail;
+			for (const auto& bar : bars) {
+				if (count + tail.size() == 0 || bar.timestamp > last) {
+					tail.push_back(to_record(bar));
+					last = bar.timestamp;
+				}
+			}
+			Header h = *header();
+			h.covered_to = std::max(h.covered_to, covered_to);
+			h.count = count + tail.size();
+			unmap();
+			write_at(sizeof(Header) + count * sizeof(Record), tail.data(), tail.size() * sizeof(Record));
+			write_at(0, &h, sizeof(h));
+			map();
+		}
+
+		// replaces the content of the cache, the bars must be sorted and complete
+		void reset(const std::vector<BidAskBar<DATE>>& bars, DATE covered_from, DATE covered_to) {
+			std::vector<Record> all;
+			all.reserve(bars.size());
+			for (const auto& bar : bars) {
+				all.push_back(to_record(bar));
+			}
+			Header h{};
+			std::memcpy(h.magic, magic, sizeof(magic));
+			h.version = version;
+			h.record_size = sizeof(Record);
+			h.covered_from = covered_from;
+			h.covered_to = covered_to;
+			h.count = all.size();
+			unmap();
+			// invalidate the header first so that an interrupted rewrite is detected on the next open
+			Header invalid{};
+			write_at(0, &invalid, sizeof(invalid));
+			write_at(sizeof(Header), all.data(), all.size() * sizeof(Record));
+			LARGE_INTEGER end{};
+			end.QuadPart = static_cast<LONGLONG>(sizeof(Header) + all.size() * sizeof(Record));
+			SetFilePointerEx(file, end, nullptr, FILE_BEGIN);
+			SetEndOfFile(file);
+			write_at(0, &h, sizeof(h));
+			map();
+		}
+
+	private:
+		static Record to_record(const BidAskBar<DATE>& bar) {
+			return Record{
+				bar.timestamp,
+				bar.bid_open, bar.bid_high, bar.bid_low, bar.bid_close,
+				bar.ask_open, bar.ask_high, bar.ask_low, bar.ask_close,
+				bar.volume
+			};
+		}
+
+		const Header* header() const {
+			return reinterpret_cast<const Header*>(view);
+		}
+
+		const Record* records() const {
+			return reinterpret_cast<const Record*>(view + sizeof(Header));
+		}
+
+		void write_at(uint64_t offset, const void* data, size_t size) {
+			LARGE_INTEGER pos{};
+			pos.QuadPart = static_cast<LONGLONG>(offset);
+			auto p = static_cast<const char*>(data);
+			bool ok = SetFilePointerEx(file, pos, nullptr, FILE_BEGIN);
+			while (ok && size > 0) {
+				DWORD written = 0;
+				auto chunk = static_cast<DWORD>(std::min<size_t>(size, 1 << 30));
+				ok = WriteFile(file, p, chunk, &written, nullptr) && written > 0;
+				p += written;
+				size -= written;
+			}
+			if (!ok) {
+				throw std::runtime_error(std::format("BarCache: cannot write {} error={}", filename, GetLastError()));
+			}
+		}
+
+		void map() {
+			LARGE_INTEGER file_size{};
+			GetFileSizeEx(file, &file_size);
+			mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			if (mapping != nullptr) {
+				view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			}
+			if (view == nullptr) {
+				throw std::runtime_error(std::format("BarCache: cannot map {} error={}", filename, GetLastError()));
+			}
+			mapped_size = static_cast<size_t>(file_size.QuadPart);
+		}
+
+		void unmap() {
+			if (view != nullptr) {
+				UnmapViewOfFile(view);
+				view = nullptr;
+			}
+			if (mapping != nullptr) {
+				CloseHandle(mapping);
+				mapping = nullptr;
+			}
+			mapped_size = 0;
+		}
+
+		std::string filename;
+		HANDLE file{ INVALID_HANDLE_VALUE };
+		HANDLE mapping{ nullptr };
+		const char* view{ nullptr };
+		size_t mapped_size{ 0 };
+	};
+}
@@ -22,14 +22,40 @@ namespace zorro {
 			}
 		}
 
+		/*
+		 * Wraps a callable producing a formattable value, it is only invoked when the message is
+		 * actually formatted, e.g. log::debug<dl5, false>("IN {}", log::lazy([&]() { return fix_string(msg); }))
+		 * costs a verbosity check and nothing else while the level is disabled.
+		 */
+		template <typename F>
+		struct lazy {
+			F f;
+		};
+
+		template <typename F>
+		lazy(F) -> lazy<F>;
+
+		// true if a message of the given verbosity level and spdlog level would be written anywhere
+		template <std::size_t level = 0, bool display = true>
+		inline bool enabled(spdlog::level::level_enum spd_level = spdlog::level::debug) {
+			if constexpr (level > 0) {
+				if (level > logging_verbosity) [[likely]]
+					return false;
+			}
+			if constexpr (display) {
+				return true;
+			}
+			else {
+				return spdlog::should_log(spd_level);
+			}
+		}
+
 		template <std::size_t level = 0, bool display = true>
 		struct info final {
 			template <typename... Args>
 			constexpr info(std::format_string<Args...> const& fmt, Args &&...args) {
-				if constexpr (level > 0) {
-					if (level > logging_verbosity) [[likely]]
-						return;
-				}
+				if (!enabled<level, display>(spdlog::level::info))
+					return;
 				auto msg = std::vformat(fmt.get(), std::make_format_args(args...));
 				if constexpr (display) {
 					_show(msg);
@@ -43,10 +69,8 @@ namespace zorro {
 		struct debug final {
 			template <typename... Args>
 			constexpr debug(std::format_string<Args...> const& fmt, Args &&...args) {
-				if constexpr (level > 0) {
-					if (level > logging_verbosity) [[likely]]
-						return;
-				}
+				if (!enabled<level, display>(spdlog::level::debug))
+					return;
 				auto msg = std::vformat(fmt.get(), std::make_format_args(args...));
 				if constexpr (display) {
 					_show(msg);
@@ -92,4 +116,12 @@ namespace zorro {
 		log::debug<2, true>("shutdown logging");
 		spdlog::shutdown();
 	}
-}
\ No newline at end of file
+}
+
+template <typename F>
+struct std::formatter<zorro::log::lazy<F>> : std::formatter<std::decay_t<std::invoke_result_t<const F&>>> {
+	template <typename FormatContext>
+	auto format(const zorro::log::lazy<F>& value, FormatContext& ctx) const {
+		return std::formatter<std::decay_t<std::invoke_result_t<const F&>>>::format(value.f(), ctx);
+	}
+};
@@ -0,0 +1,360 @@
+#pragma once
+
+#include "pch.h"
+#include "zorro.h"
+
+#include <cstring>
+
+#include "common/bar.h"
+
+namespace zorro {
+
+	using common::Quote;
+
+	/*
+	 * Persistent compressed store of the ticks of one symbol.
+	 *
+	 * Like the bar cache the store covers the tick times [covered_from, covered_to) without gaps. Ticks
+	 * are kept in blocks of up to block_size ticks. The first tick of a block is stored in full, the
+	 * following ones as zigzag varint deltas of the time in microseconds and of the bid and ask price
+	 * in units of 1 / price_scale, which typically takes 3 to 6 bytes per tick instead of 24.
+	 *
+	 * File layout, native byte order: a Header followed by blocks of a BlockHeader and its payload.
+	 * Blocks are appended before the header is updated, an incomplete last block is dropped on open.
+	 */
+	class TickStore {
+	public:
+		static constexpr char magic[8] = { 'Z', 'T', 'I', 'C', 'K', 'S', '0', '1' };
+		static constexpr size_t block_size = 4096;
+		static constexpr double micros_per_day = 86400000000.0;
+
+		struct Header {
+			char magic[8];
+			double price_scale;
+			DATE covered_from;
+			DATE covered_to;
+		};
+
+		struct BlockHeader {
+			int64_t first_time;
+			int64_t last_time;
+			int64_t first_bid;
+			int64_t first_ask;
+			uint32_t count;
+			uint32_t payload_bytes;
+		};
+
+		// opens or creates the store, the price scale of an existing file takes precedence
+		explicit TickStore(const std::string& filename, double price_scale = 1e6)
+			: filename(filename)
+		{
+			file.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+			if (!file) {
+				file.clear();
+				file.open(filename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+			}
+			if (!file) {
+				throw std::runtime_error(std::format("TickStore: cannot open {}", filename));
+			}
+			if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.magic, magic, sizeof(magic)) != 0) {
+				file.clear();
+				header = Header{};
+				std::memcpy(header.magic, magic, sizeof(magic));
+				header.price_scale = price_scale;
+				rewrite({});
+			}
+			else {
+				scan();
+			}
+		}
+
+		TickStore(const TickStore&) = delete;
+
+		TickStore& operator=(const TickStore&) = delete;
+
+		const std::string& get_filename() const {
+			return filename;
+		}
+
+		bool empty() const {
+			return header.covered_to <= header.covered_from;
+		}
+
+		DATE covered_from() const {
+			return header.covered_from;
+		}
+
+		DATE covered_to() const {
+			return header.covered_to;
+		}
+
+		size_t size() const {
+			return num_ticks;
+		}
+
+		// number of stored ticks in [from, to], exact for the blocks at the boundaries
+		size_t count(DATE from, DATE to) {
+			size_t n = 0;
+			auto t_from = to_time(from), t_to = to_time(to);
+			for (size_t b = 0; b < blocks.size(); ++b) {
+				const auto& block = blocks[b].header;
+				if (block.last_time < t_from || block.first_time > t_to) {
+					continue;
+				}
+				if (block.first_time >= t_from && block.last_time <= t_to) {
+					n += block.count;
+					continue;
+				}
+				decode(b);
+				for (const auto& tick : decoded) {
+					if (tick.time >= t_from && tick.time <= t_to)
+						++n;
+				}
+			}
+			return n;
+		}
+
+		/*
+		 * Calls op(quote) for the stored ticks in [from, to] from the most recent one backwards until
+		 * max_ticks ticks were passed, returns the number of ticks passed.
+		 */
+		template<typename Op>
+		size_t read_reverse(DATE from, DATE to, size_t max_ticks, Op op) {
+			size_t n = 0;
+			auto t_from = to_time(from), t_to = to_time(to);
+			for (size_t b = blocks.size(); b-- > 0 && n < max_ticks;) {
+				const auto& block = blocks[b].header;
+				if (block.first_time > t_to) {
+					continue;
+				}
+				if (block.last_time < t_from) {
+					break;
+				}
+				decode(b);
+				for (auto it = decoded.rbegin(); it != decoded.rend() && n < max_ticks; ++it) {
+					if (it->time > t_to) {
+						continue;
+					}
+					if (it->time < t_from) {
+						return n;
+					}
+					op(to_quote(*it));
+					++n;
+				}
+			}
+			return n;
+		}
+
+		// appends the stored ticks in [from, to] to quotes in time order
+		void read(DATE from, DATE to, std::vector<Quote<DATE>>& quotes) {
+			auto t_from = to_time(from), t_to = to_time(to);
+			for (size_t b = 0; b < blocks.size(); ++b) {
+				const auto& block = blocks[b].header;
+				if (block.last_time < t_from || block.first_time > t_to) {
+					continue;
+				}
+				decode(b);
+				for (const auto& tick : decoded) {
+					if (tick.time >= t_from && tick.time <= t_to)
+						quotes.emplace_back(to_quote(tick));
+				}
+			}
+		}
+
+		/*
+		 * Appends the sorted quotes, which must all be at or after covered_to, and extends the
+		 * coverage to covered_to.
+		 */
+		void append(const std::vector<Quote<DATE>>& quotes, DATE covered_to) {
+			file.seekp(0, std::ios::end);
+			for (size_t i = 0; i < quotes.size(); i += block_size) {
+				auto n = std::min(block_size, quotes.size() - i);
+				write_block(quotes.data() + i, n);
+			}
+			header.covered_to = std::max(header.covered_to, covered_to);
+			write_header();
+		}
+
+		// replaces the content of the store with the sorted quotes
+		void reset(const std::vector<Quote<DATE>>& quotes, DATE covered_from, DATE covered_to) {
+			header.covered_from = covered_from;
+			header.covered_to = covered_to;
+			rewrite(quotes);
+		}
+
+	private:
+		struct Tick {
+			int64_t time;
+			int64_t bid;
+			int64_t ask;
+		};
+
+		struct Block {
+			std::streamoff offset;
+			BlockHeader header;
+		};
+
+		int64_t to_time(DATE date) const {
+			return std::llround(date * micros_per_day);
+		}
+
+		Quote<DATE> to_quote(const Tick& tick) const {
+			return Quote<DATE>(
+				static_cast<DATE>(tick.time) / micros_per_day,
+				static_cast<double>(tick.bid) / header.price_scale,
+				static_cast<double>(tick.ask) / header.price_scale
+			);
+		}
+
+		Tick to_tick(const Quote<DATE>& quote) const {
+			return Tick{
+				to_time(quote.timestamp),
+				std::llround(quote.bid * header.price_scale),
+				std::llround(quote.ask * header.price_scale)
+			};
+		}
+
+		static void put_varint(std::string& out, int64_t value) {
+			auto zigzag = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+			while (zigzag >= 0x80) {
+				out.push_back(static_cast<char>((zigzag & 0x7f) | 0x80));
+				zigzag >>= 7;
+			}
+			out.push_back(static_cast<char>(zigzag));
+		}
+
+		static int64_t get_varint(const char*& p, const char* end) {
+			uint64_t zigzag = 0;
+			for (int shift = 0; p < end && shift < 64; shift += 7) {
+				auto byte = static_cast<uint8_t>(*p++);
+				zigzag |= static_cast<uint64_t>(byte & 0x7f) << shift;
+				if ((byte & 0x80) == 0)
+					break;
+			}
+			return static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+		}
+
+		// called with the put position at the end of the file
+		void write_block(const Quote<DATE>* quotes, size_t n) {
+			auto first = to_tick(quotes[0]);
+			payload.clear();
+			auto prev = first;
+			for (size_t i = 1; i < n; ++i) {
+				auto tick = to_tick(quotes[i]);
+				put_varint(payload, tick.time - prev.time);
+				put_varint(payload, tick.bid - prev.bid);
+				put_varint(payload, tick.ask - prev.ask);
+				prev = tick;
+			}
+			Block block{ file.tellp(), BlockHeader{ first.time, prev.time, first.bid, first.ask, static_cast<uint32_t>(n), static_cast<uint32_t>(payload.size()) } };
+			file.write(reinterpret_cast<const char*>(&block.header), sizeof(block.header));
+			file.write(payload.data(), payload.size());
+			if (!file) {
+				throw std::runtime_error(std::format("TickStore: cannot write {}", filename));
+			}
+			blocks.push_back(block);
+			num_ticks += n;
+		}
+
+		void write_header() {
+			file.seekp(0);
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.flush();
+			if (!file) {
+				throw std::runtime_error(std::format("TickStore: cannot write {}", filename));
+			}
+		}
+
+		void rewrite(const std::vector<Quote<DATE>>& quotes) {
+			file.close();
+			file.open(filename, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!file) {
+				throw std::runtime_error(std::format("TickStore: cannot open {}", filename));
+			}
+			blocks.clear();
+			num_ticks = 0;
+			decoded_block = -1;
+			// the coverage is only written once the ticks are in place
+			auto coverage = header;
+			header.covered_from = header.covered_to = 0;
+			write_header();
+			header = coverage;
+			append(quotes, header.covered_to);
+		}
+
+		/*
+		 * Reads the block index. Blocks of an append whose coverage was not written yet are dropped,
+		 * an incomplete last block is dropped and the coverage reduced to the remaining blocks.
+		 */
+		void scan() {
+			file.seekg(0, std::ios::end);
+			auto end = static_cast<std::streamoff>(file.tellg());
+			auto covered_to = to_time(header.covered_to);
+			std::streamoff pos = sizeof(Header);
+			bool incomplete = false;
+			while (pos < end) {
+				Block block{ pos, BlockHeader{} };
+				file.seekg(pos);
+				file.read(reinterpret_cast<char*>(&block.header), sizeof(block.header));
+				auto next = pos + static_cast<std::streamoff>(sizeof(BlockHeader) + block.header.payload_bytes);
+				if (!file || block.header.count == 0 || next > end) {
+					incomplete = true;
+					break;
+				}
+				if (block.header.first_time >= covered_to) {
+					break;
+				}
+				blocks.push_back(block);
+				num_ticks += block.header.count;
+				pos = next;
+			}
+			file.clear();
+			if (pos < end) {
+				file.close();
+				std::filesystem::resize_file(filename, pos);
+				file.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+				if (incomplete) {
+					header.covered_to = blocks.empty()
+						? header.covered_from
+						: std::min(header.covered_to, static_cast<DATE>(blocks.back().header.last_time + 1) / micros_per_day);
+					write_header();
+				}
+			}
+		}
+
+		void decode(size_t b) {
+			if (decoded_block == static_cast<int64_t>(b)) {
+				return;
+			}
+			const auto& block = blocks[b];
+			payload.resize(block.header.payload_bytes);
+			file.seekg(block.offset + static_cast<std::streamoff>(sizeof(BlockHeader)));
+			file.read(payload.data(), payload.size());
+			if (!file) {
+				file.clear();
+				throw std::runtime_error(std::format("TickStore: cannot read {}", filename));
+			}
+			decoded.clear();
+			Tick tick{ block.header.first_time, block.header.first_bid, block.header.first_ask };
+			decoded.push_back(tick);
+			const char* p = payload.data();
+			const char* end = p + payload.size();
+			for (uint32_t i = 1; i < block.header.count; ++i) {
+				tick.time += get_varint(p, end);
+				tick.bid += get_varint(p, end);
+				tick.ask += get_varint(p, end);
+				decoded.push_back(tick);
+			}
+			decoded_block = static_cast<int64_t>(b);
+		}
+
+		std::string filename;
+		std::fstream file;
+		Header header{};
+		std::vector<Block> blocks;
+		size_t num_ticks{ 0 };
+		std::string payload;
+		std::vector<Tick> decoded;
+		int64_t decoded_block{ -1 };
+	};
+}
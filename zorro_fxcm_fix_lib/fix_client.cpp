@@ -5,6 +5,7 @@
 #include "pch.h"
 
 #include "fix_client.h"
+#include "fix_trace_sink.h"
 
 #include "quickfix/config.h"
 #include "quickfix/Session.h"
@@ -29,7 +30,7 @@ namespace zorro {
 	constexpr int dl5 = 5;
 
 #ifdef FIX_MSG_TRACE_LOG
-	std::shared_ptr<spdlog::logger> fix_msg_trace_log;
+	std::unique_ptr<FixTraceSink> fix_msg_trace_sink;
 #endif
 
 	std::string fix_string(const FIX::Message& msg) {
@@ -38,18 +39,15 @@ namespace zorro {
 		return s;
 	}
 
-	std::string fix_string_masked(const FIX::Message& msg) {
-		FIX::Message msg_copy = msg;
-		FIX::SenderCompID sender_comp_id;
-		auto is_data = msg_copy.getHeader().getField(sender_comp_id).getString().starts_with("MD");
-		auto masked_sender_comp_id = is_data ? "MDataSenderCompID_Masked" : "TExecSenderCompID_Masked";
-		msg_copy.getHeader().setField(FIX::SenderCompID(masked_sender_comp_id));
-		msg_copy.setField(FIX::Account("Account_Masked"));
-		auto s = msg_copy.toString();
-		std::replace(s.begin(), s.end(), '\x1', '|');
-		return s;
+	// only converts the message when the log level is enabled
+	inline auto lazy_fix_string(const FIX::Message& msg) {
+		return log::lazy([&msg]() { return fix_string(msg); });
 	}
-	
+
+	inline auto lazy_session_id(const FIX::SessionID& session_id) {
+		return log::lazy([&session_id]() { return session_id.toString(); });
+	}
+
 	template<class T>
 	inline T get_or_else(const ServiceMessage& map, const std::string_view& key, const T& other) {
 		auto it = map.find(std::string(key));
@@ -61,20 +59,18 @@ namespace zorro {
 		}
 	}
 
+	// epoch if the fields are malformed
 	template<typename G>
 	inline std::chrono::nanoseconds parse_date_and_time(const G& g, int date_field = FIX::FIELD::MDEntryDate, int time_field = FIX::FIELD::MDEntryTime) {
-		std::stringstream in;
-		in << g.getField(date_field) << "-" << g.getField(time_field);
-		std::chrono::time_point<std::chrono::system_clock>  tp;
-		in >> std::chrono::parse("%Y%m%d-%T", tp);
-		return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch());
+		std::chrono::nanoseconds timestamp{ 0 };
+		common::parse_utc_date_and_time(g.getField(date_field), g.getField(time_field), timestamp);
+		return timestamp;
 	}
 
-	inline std::chrono::nanoseconds parse_datetime(const std::string& datetime) {
-		std::stringstream in; in << datetime;
-		std::chrono::time_point<std::chrono::system_clock>  tp;
-		in >> std::chrono::parse("%Y%m%d-%T", tp);
-		return std::chrono::duration_cast<std::chrono::nanoseconds>(tp.time_since_epoch());
+	inline std::chrono::nanoseconds parse_utc_timestamp(const std::string& datetime) {
+		std::chrono::nanoseconds timestamp{ 0 };
+		common::parse_utc_timestamp(datetime, timestamp);
+		return timestamp;
 	}
 
 	FXCMMarginCallStatus parse_fxcm_margin_call_status(const std::string& status) {
@@ -205,9 +201,9 @@ namespace zorro {
 	FixClient::FixClient(
 		const FIX::SessionSettings& session_settings,
 		unsigned int num_required_session_logins,
-		BlockingTimeoutQueue<ExecReport>& exec_report_queue,
-		BlockingTimeoutQueue<StatusExecReport>& status_exec_report_queue,
-		BlockingTimeoutQueue<TopOfBook>& top_of_book_queue,
+		SpScQueue<ExecReport>& exec_report_queue,
+		SpScQueue<StatusExecReport>& status_exec_report_queue,
+		TopOfBookStore& top_of_book_store,
 		BlockingTimeoutQueue<ServiceMessage>& service_message_queue,
 		BlockingTimeoutQueue<FXCMPositionReport>& position_report_queue, 
 		BlockingTimeoutQueue<FXCMPositionReports>& position_snapshot_reports_queue,
@@ -217,7 +213,7 @@ namespace zorro {
       , num_required_session_logins(num_required_session_logins)
 	  , exec_report_queue(exec_report_queue)
 	  , status_exec_report_queue(status_exec_report_queue)
-	  , top_of_book_queue(top_of_book_queue)
+	  , top_of_book_store(top_of_book_store)
       , service_message_queue(service_message_queue)
 	  , position_report_queue(position_report_queue)
       , position_snapshot_reports_queue(position_snapshot_reports_queue)
@@ -234,8 +230,7 @@ namespace zorro {
 		}
 
 #ifdef FIX_MSG_TRACE_LOG
-		fix_msg_trace_log = spdlog::basic_logger_mt("fix", std::format("fix_message_tracer_{}.log", common::timestamp_postfix()), true);
-		fix_msg_trace_log->set_level(spdlog::level::debug);
+		fix_msg_trace_sink = std::make_unique<FixTraceSink>(std::format("fix_message_tracer_{}.bin", common::timestamp_postfix()));
 #endif
 	}
 
@@ -342,10 +337,12 @@ namespace zorro {
 		const FIX::Message& message, const FIX::SessionID& sessionID
 	) EXCEPT(FIX::FieldNotFound, FIX::IncorrectDataFormat, FIX::IncorrectTagValue, FIX::RejectLogon)
 	{
-		log::debug<dl2, false>("FixClient::fromAdmin IN <{}> {}", sessionID.toString(), fix_string(message));
+		log::debug<dl2, false>("FixClient::fromAdmin IN <{}> {}", lazy_session_id(sessionID), lazy_fix_string(message));
+
+		pending_order_requests.expire();
 
 #ifdef FIX_MSG_TRACE_LOG
-		fix_msg_trace_log->debug("Admin IN  {}", fix_string_masked(message));
+		fix_msg_trace_sink->write(FixTraceKind::admin_in, message);
 #endif
 	}
 
@@ -365,10 +362,10 @@ namespace zorro {
 		auto sub_id = session_settings.get().getString("TargetSubID");
 		message.getHeader().setField(FIX::TargetSubID(sub_id));
 
-		log::debug<dl2, false>("Admin OUT <{}> {}", sessionID.toString(), fix_string(message));
+		log::debug<dl2, false>("Admin OUT <{}> {}", lazy_session_id(sessionID), lazy_fix_string(message));
 
 #ifdef FIX_MSG_TRACE_LOG
-		fix_msg_trace_log->debug("Admin OUT {}", fix_string_masked(message));
+		fix_msg_trace_sink->write(FixTraceKind::admin_out, message);
 #endif
 	}
 
@@ -378,20 +375,27 @@ namespace zorro {
 		auto mkt = fix::is_market_data_message(message);
 		auto exec = fix::is_exec_report_message(message);
 		if (exec) {
-			log::debug<dl0, false>("FixClient::fromApp IN <{}> {}", sessionID.toString(), fix_string(message));
+			log::debug<dl0, false>("FixClient::fromApp IN <{}> {}", lazy_session_id(sessionID), lazy_fix_string(message));
 		} 
 		else if (mkt) {
-			log::debug<dl5, false>("FixClient::fromApp IN <{}> {}", sessionID.toString(), fix_string(message));
+			log::debug<dl5, false>("FixClient::fromApp IN <{}> {}", lazy_session_id(sessionID), lazy_fix_string(message));
 		} 
 		else {
-			log::debug<dl1, false>("FixClient::fromApp IN <{}> {}", sessionID.toString(), fix_string(message));
+			log::debug<dl1, false>("FixClient::fromApp IN <{}> {}", lazy_session_id(sessionID), lazy_fix_string(message));
 		}
 
 #ifdef FIX_MSG_TRACE_LOG
-		fix_msg_trace_log->debug("App   IN  {}", fix_string_masked(message));
+		fix_msg_trace_sink->write(FixTraceKind::app_in, message);
 #endif
 
 		crack(message, sessionID);
+
+		// after crack so that a report arriving just at the deadline still completes its request
+		pending_order_requests.expire();
+	}
+
+	size_t FixClient::expire_pending_requests() {
+		return pending_order_requests.expire();
 	}
 
 	void FixClient::toApp(FIX::Message& message, const FIX::SessionID& sessionID) EXCEPT(FIX::DoNotSend)
@@ -407,10 +411,10 @@ namespace zorro {
 		auto sub_ID = session_settings.get().getString("TargetSubID");
 		message.getHeader().setField(FIX::TargetSubID(sub_ID));
 
-		log::debug<dl0, false>("FixClient::toApp OUT <{}> {}", sessionID.toString(), fix_string(message));
+		log::debug<dl0, false>("FixClient::toApp OUT <{}> {}", lazy_session_id(sessionID), lazy_fix_string(message));
 
 #ifdef FIX_MSG_TRACE_LOG
-		fix_msg_trace_log->debug("App   OUT {}", fix_string_masked(message));
+		fix_msg_trace_sink->write(FixTraceKind::app_out, message);
 #endif
 	}
 
@@ -490,6 +494,16 @@ namespace zorro {
 						.fxcm_trading_status = trade_status,
 					};
 					status.security_informations.emplace(symbol, std::move(security_info));
+
+					instrument_registry().register_instrument(Instrument{
+						.symbol = symbol,
+						.currency = currency,
+						.tick_size = std::pow(10.0, -pip_size),
+						.precision = pip_size,
+						.min_quantity = min_quantity,
+						.max_quantity = max_quanity,
+						.contract_multiplier = contract_multiplier
+					});
 				}
 				catch (FIX::FieldNotFound& error) {
 					log::error<false>(
@@ -560,7 +574,7 @@ namespace zorro {
 			double maintenance_margin = FIX::DoubleConvertor::convert(message.getField(FXCM_USED_MARGIN3));
 			double cash_daily = FIX::DoubleConvertor::convert(message.getField(FXCM_CASH_DAILY));
 			auto margin_call_status = parse_fxcm_margin_call_status(message.getField(FXCM_MARGIN_CALL));
-			auto sending_time = parse_datetime(message.getHeader().getField(FIX::FIELD::SendingTime));
+			auto sending_time = parse_utc_timestamp(message.getHeader().getField(FIX::FIELD::SendingTime));
 
 			// CollateralReport NoPartyIDs group can be inspected for additional account information such as AccountName or HedgingStatus
 			FIX44::CollateralReport::NoPartyIDs group;
@@ -673,7 +687,7 @@ namespace zorro {
 			position_id = message.getField(FXCM_POS_ID);
 			interest = FIX::DoubleConvertor::convert(message.getField(FXCM_POS_INTEREST));
 			commission = FIX::DoubleConvertor::convert(message.getField(FXCM_POS_COMMISSION));
-			open_time = parse_datetime(message.getField(FXCM_POS_OPEN_TIME));
+			open_time = parse_utc_timestamp(message.getField(FXCM_POS_OPEN_TIME));
 
 			int num_net_positions = FIX::IntConvertor::convert(message.getField(FIX::FIELD::NoPositions));
 			if (num_net_positions > 1) {
@@ -702,7 +716,7 @@ namespace zorro {
 				is_open = false;
 				close_pnl = FIX::DoubleConvertor::convert(message.getField(FXCM_CLOSE_PNL));
 				close_settle_price = FIX::DoubleConvertor::convert(message.getField(FXCM_CLOSE_SETTLE_PRICE));
-				close_time = parse_datetime(message.getField(FXCM_POS_CLOSE_TIME));
+				close_time = parse_utc_timestamp(message.getField(FXCM_POS_CLOSE_TIME));
 				close_order_id = message.getField(FXCM_CLOSE_ORDER_ID);
 				close_cl_ord_id = message.getField(FXCM_CLOSE_CL_ORD_ID);
 			}
@@ -773,7 +787,16 @@ namespace zorro {
 	{
 		auto& symbol = message.getField(FIX::FIELD::Symbol);
 
-		auto& top_of_book = top_of_books.insert_or_assign(symbol, TopOfBook(symbol)).first->second;
+		auto registered = top_of_book_store.find(symbol);
+		if (!registered.has_value()) {
+			log::error<false>("FixClient::onMessage[FIX44::MarketDataSnapshotFullRefresh]: symbol={} not requested", symbol);
+			return;
+		}
+		auto id = registered.value();
+		if (id >= top_of_books.size()) {
+			top_of_books.resize(id + 1);
+		}
+		auto& top_of_book = top_of_books[id].emplace(symbol);
 		double session_high_price;
 		double session_low_price;
 		std::chrono::nanoseconds timestamp;
@@ -820,9 +843,9 @@ namespace zorro {
 			}
 		}
 
-		log::debug<dl5, false>("FixClient::onMessage[FIX44::MarketDataSnapshotFullRefresh]: top={}", top_of_book.to_string());
+		log::debug<dl5, false>("FixClient::onMessage[FIX44::MarketDataSnapshotFullRefresh]: top={}", log::lazy([&]() { return top_of_book.to_string(); }));
 
-		top_of_book_queue.push(top_of_book); // publish snapshot related top of book
+		top_of_book_store.publish(id, top_of_book); // publish snapshot related top of book
 
 		if (subscribe_after_snapshot) {
 			subscribe_market_data(symbol, true, false);
@@ -842,7 +865,9 @@ namespace zorro {
 		FIX::MDEntrySize size;
 		FIX::MDEntryPx price;
 
-		std::set<TopOfBook*> change_set;
+		// instrument ids of the changed books, only a few per message
+		auto& change_set = changed_instrument_ids;
+		change_set.clear();
 
 		int entry_count = FIX::IntConvertor::convert(message.getField(FIX::FIELD::NoMDEntries));
 		for (int i = 1; i <= entry_count; i++) {
@@ -850,11 +875,12 @@ namespace zorro {
 			message.getGroup(i, group);
 			auto& symbol = group.getField(FIX::FIELD::Symbol);
 
-			auto it = top_of_books.find(symbol);
-			if (it == top_of_books.end()) {
+			auto id = instrument_registry().find(symbol);
+			if (!id.has_value() || id.value() >= top_of_books.size() || !top_of_books[id.value()].has_value()) {
 				log::error<false>("FixClient::onMessage[FIX44::MarketDataIncrementalRefresh]: did not find symbol={} in top of books", symbol);
 				continue;
 			}
+			auto& top_of_book = top_of_books[id.value()].value();
 
 			if (i == 1) {
 				if (group.isSetField(FIX::FIELD::MDEntryDate) && group.isSetField(FIX::FIELD::MDEntryTime)) {
@@ -866,20 +892,24 @@ namespace zorro {
 			group.get(price);
 
 			if (entry_type == FIX::MDEntryType_BID) {  
-				it->second.bid_price = price;
+				top_of_book.bid_price = price;
 				if (group.getIfSet(size)) {
-					it->second.bid_volume = size;
+					top_of_book.bid_volume = size;
+				}
+				top_of_book.timestamp = timestamp;
+				if (std::find(change_set.begin(), change_set.end(), id.value()) == change_set.end()) {
+					change_set.push_back(id.value());
 				}
-				it->second.timestamp = timestamp;
-				change_set.insert(&it->second);
 			}
 			else if (entry_type == FIX::MDEntryType_OFFER) { 
-				it->second.ask_price = price;
+				top_of_book.ask_price = price;
 				if (group.getIfSet(size)) {
-					it->second.ask_volume = size;
+					top_of_book.ask_volume = size;
+				}
+				top_of_book.timestamp = timestamp;
+				if (std::find(change_set.begin(), change_set.end(), id.value()) == change_set.end()) {
+					change_set.push_back(id.value());
 				}
-				it->second.timestamp = timestamp;
-				change_set.insert(&it->second);
 			}
 			else if (entry_type == FIX::MDEntryType_TRADING_SESSION_HIGH_PRICE) {
 				session_high_price = price;
@@ -895,210 +925,132 @@ namespace zorro {
 			}
 		}
 
-		for (auto top_of_book : change_set) {
-			log::debug<dl5, false>("FixClient::onMessage[FIX44::MarketDataIncrementalRefresh]: top={}", top_of_book->to_string());
+		for (auto id : change_set) {
+			const auto& top_of_book = top_of_books[id].value();
+			log::debug<dl5, false>("FixClient::onMessage[FIX44::MarketDataIncrementalRefresh]: top={}", log::lazy([&]() { return top_of_book.to_string(); }));
 
-			top_of_book_queue.push(*top_of_book); // publish snapshot related top of book
+			top_of_book_store.publish(id, top_of_book); // conflated, readers only see the latest quote
 		}
 	}
 
 	void FixClient::onMessage(const FIX44::ExecutionReport& message, const FIX::SessionID&) 
 	{
-		try {
-			FIX::Symbol symbol;
-			FIX::ExecID exec_id;
-			FIX::ExecType exec_type;
-			FIX::OrderID ord_id;
-			FIX::ClOrdID cl_ord_id;
-			FIX::OrdStatus ord_status;
-			FIX::OrdType ord_type;
-			FIX::Side side;
-			FIX::TimeInForce tif;
-			FIX::Price price;
-			FIX::OrderQty order_qty;
-			FIX::LastQty last_qty;
-			FIX::LastPx last_px;
-			FIX::LeavesQty leaves_qty;
-			FIX::CumQty cum_qty;
-			FIX::AvgPx avg_px;
-			FIX::Text text;
-			FIX::LastRptRequested last_rpt_requested;
-			FIX::MassStatusReqID mass_status_req_id;
-
-			message.get(exec_type);
-
-			if (exec_type != FIX::ExecType_ORDER_STATUS) {
-				message.get(symbol);
-				message.get(exec_id);
-				message.get(ord_id);
-				message.get(cl_ord_id);
-				message.get(ord_status);
-				message.getIfSet(ord_type);
-				message.get(side);
-				message.get(tif);
-				message.get(price);
-				message.get(avg_px);
-				message.get(order_qty);
-				message.get(last_qty);
-				message.get(leaves_qty);
-				message.get(last_px);
-				message.get(cum_qty);
-				message.getIfSet(text);
-
-				std::string position_id;
-				if (message.isSetField(FXCM_FIX_FIELDS::FXCM_POS_ID)) {
-					position_id = message.getField(FXCM_FIX_FIELDS::FXCM_POS_ID);
+		// single pass over the fields into reused reports, only called from the FIX thread
+		const auto& fields = exec_report_decoder.decode(message);
+
+		if (!fields.has(fix::ExecReportFields::has_exec_type)) {
+			log::debug<dl0, false>("FixClient::on_message[ExecutionReport]: error parsing execution report {}", lazy_fix_string(message));
+			return;
+		}
+
+		if (fields.exec_type != FIX::ExecType_ORDER_STATUS) {
+			if (!fields.has(fix::ExecReportFields::required_order_fields)) {
+				log::debug<dl0, false>("FixClient::on_message[ExecutionReport]: error parsing execution report {}", lazy_fix_string(message));
+				return;
+			}
+			if (!fields.has(fix::ExecReportFields::has_custom)) {
+				log::error<false>("FixClient::on_message[ExecutionReport]: no position id set {}", fix_string(message));
+			}
+
+			auto& report = decoded_exec_report;
+			fields.assign(report);
+
+			log::debug<dl0, false>("FixClient::on_message[ExecutionReport]: {}", log::lazy([&]() { return report.to_string("position_id"); }));
+
+			if (!exec_report_queue.push(report)) {
+				log::error<false>(
+					"FixClient::on_message[ExecutionReport]: exec report queue full, dropped={} {}", 
+					exec_report_queue.num_dropped(), report.to_string("position_id")
+				);
+			}
+
+			// every report goes to the order tracker stream, the ones answering a pending request also
+			// complete it, queued first so that the order tracker already has it when the waiter wakes up
+			pending_order_requests.complete(report);
+		}
+		else {
+			auto& report = decoded_status_exec_report;
+
+			if (fields.ord_status != FIX::OrdStatus_REJECTED) {
+				constexpr auto required = fix::ExecReportFields::required_order_fields & ~fix::ExecReportFields::has_cl_ord_id;
+				if (!fields.has(required)) {
+					log::debug<dl0, false>("FixClient::on_message[ExecutionReport]: error parsing execution report {}", lazy_fix_string(message));
+					return;
 				}
-				else {
+				if (!fields.has(fix::ExecReportFields::has_custom)) {
 					log::error<false>("FixClient::on_message[ExecutionReport]: no position id set {}", fix_string(message));
 				}
 
-				ExecReport report(
-					symbol.getString(),
-					ord_id.getString(),
-					cl_ord_id.getString(),
-					exec_id.getString(),
-					exec_type.getValue(),
-					ord_type.getValue(),
-					ord_status.getValue(),
-					side.getValue(),
-					tif.getValue(),
-					price.getValue(),
-					avg_px.getValue(),
-					order_qty.getValue(),
-					last_qty.getValue(),
-					last_px.getValue(),
-					cum_qty.getValue(),
-					leaves_qty.getValue(),
-					text.getString(),
-					position_id
-				);
+				fields.assign(report);
 
-				log::debug<dl0, false>("FixClient::on_message[ExecutionReport]: {}", report.to_string("position_id"));
+				log::debug<dl0, false>(
+					"FixClient::on_message[StatusExecutionReport(ord_status!=FIX::OrdStatus_REJECTED)]: {}", 
+					log::lazy([&]() { return report.to_string("position_id"); })
+				);
 
-				exec_report_queue.push(report);
+				if (!status_exec_report_queue.push(report)) {
+					log::error<false>(
+						"FixClient::on_message[StatusExecutionReport]: status exec report queue full, dropped={} {}", 
+						status_exec_report_queue.num_dropped(), report.to_string()
+					);
+				}
 			}
 			else {
-				message.get(ord_status);
-
-				if (ord_status != FIX::OrdStatus_REJECTED) {
-					message.get(symbol);
-					message.get(exec_id);
-					message.get(ord_id);
-					message.getIfSet(cl_ord_id);
-					message.getIfSet(ord_type);
-					message.get(side);
-					message.get(tif);
-					message.get(price);
-					message.get(avg_px);
-					message.get(order_qty);
-					message.get(last_qty);
-					message.get(leaves_qty);
-					message.get(last_px);
-					message.get(cum_qty);
-
-					message.getIfSet(text);
-					message.getIfSet(mass_status_req_id);
-
-					auto tot_num_reports = 0;
-					if (message.isSetField(FIX::FIELD::TotNumReports)) {
-						const auto& s = message.getField(FIX::FIELD::TotNumReports);
-						tot_num_reports = std::atoi(s.c_str());
-					}
-
-					auto last_rpt_requested = true;
-					if (message.isSetField(FIX::FIELD::LastRptRequested)) {
-						const auto& s = message.getField(FIX::FIELD::LastRptRequested);
-						last_rpt_requested = s == "Y";
-					}
-
-					std::string position_id;
-					if (message.isSetField(FXCM_FIX_FIELDS::FXCM_POS_ID)) {
-						position_id = message.getField(FXCM_FIX_FIELDS::FXCM_POS_ID);
-					}
-					else {
-						log::error<false>("FixClient::on_message[ExecutionReport]: no position id set {}", fix_string(message));
-					}
-
-					StatusExecReport report(
-						symbol.getString(),
-						ord_id.getString(),
-						cl_ord_id.getString(),
-						exec_id.getString(),
-						mass_status_req_id.getString(),
-						exec_type.getValue(),
-						ord_type.getValue(),
-						ord_status.getValue(),
-						side.getValue(),
-						tif.getValue(),
-						price.getValue(),
-						avg_px.getValue(),
-						order_qty.getValue(),
-						last_qty.getValue(),
-						last_px.getValue(),
-						cum_qty.getValue(),
-						leaves_qty.getValue(),
-						text.getString(),
-						tot_num_reports,
-						last_rpt_requested,
-						position_id
-					);
-
-					log::debug<dl0, false>(
-						"FixClient::on_message[StatusExecutionReport(ord_status!=FIX::OrdStatus_REJECTED)]: {}", 
-						report.to_string("position_id")
-					);
-
-					status_exec_report_queue.push(report);
+				// only the ids and the text are reliable in rejected status reports
+				constexpr auto required = fix::ExecReportFields::has_exec_id | fix::ExecReportFields::has_mass_status_req_id;
+				if (!fields.has(required)) {
+					log::debug<dl0, false>("FixClient::on_message[ExecutionReport]: error parsing execution report {}", lazy_fix_string(message));
+					return;
 				}
-				else {
-					// skip some fields because of Quickfix parsing issues
-					message.get(exec_id);
-					message.get(mass_status_req_id);
-					message.getIfSet(text);
-
-					StatusExecReport report(
-						"N/A",
-						"N/A",
-						"N/A",
-						exec_id.getString(),
-						mass_status_req_id.getString(),
-						exec_type.getValue(),
-						'0',
-						FIX::OrdStatus_REJECTED,
-						FIX::Side_UNDISCLOSED,
-						FIX::TimeInForce_GOOD_TILL_CANCEL,
-						0,
-						0,
-						0,
-						0,
-						0,
-						0,
-						0,
-						text.getString(),
-						0,
-						true
-					);
 
-					log::debug<dl0, false>("FixClient::on_message[StatusExecutionReport(ord_status==FIX::OrdStatus_REJECTED)]: {}", report.to_string());
+				report = StatusExecReport(
+					"N/A",
+					"N/A",
+					"N/A",
+					std::string(fields.exec_id),
+					std::string(fields.mass_status_req_id),
+					fields.exec_type,
+					'0',
+					FIX::OrdStatus_REJECTED,
+					FIX::Side_UNDISCLOSED,
+					FIX::TimeInForce_GOOD_TILL_CANCEL,
+					0,
+					0,
+					0,
+					0,
+					0,
+					0,
+					0,
+					std::string(fields.text),
+					0,
+					true
+				);
+
+				log::debug<dl0, false>("FixClient::on_message[StatusExecutionReport(ord_status==FIX::OrdStatus_REJECTED)]: {}", log::lazy([&]() { return report.to_string(); }));
 
-					status_exec_report_queue.push(report);
+				if (!status_exec_report_queue.push(report)) {
+					log::error<false>(
+						"FixClient::on_message[StatusExecutionReport]: status exec report queue full, dropped={} {}", 
+						status_exec_report_queue.num_dropped(), report.to_string()
+					);
 				}
 			}
 		}
-		catch (...) {
-			log::debug<dl0, false>("FixClient::on_message[ExecutionReport]: error parsing execution report {}", fix_string(message));
-		}
 	}
 	
 	void FixClient::onMessage(const FIX44::OrderCancelReject& message, const FIX::SessionID&) 
 	{
 		FIX::Text text;
+		FIX::ClOrdID cl_ord_id;
 		message.getIfSet(text);
 		auto raw = fix_string(message);
 		auto service_msg = reject_service_message("OrderCancelReject", text.getString(), raw);
 		service_message_queue.push(service_msg);
 
+		if (message.getIfSet(cl_ord_id)) {
+			pending_order_requests.reject(cl_ord_id.getString(), text.getString());
+		}
+
 		log::error<false>("onMessage[FIX44::OrderCancelReject]: {}", raw);
 	}
 
@@ -1128,6 +1080,7 @@ namespace zorro {
 		auto request_id = std::format("{}_{}", symbol.getString(), id_generator.genID());
 		auto subscription_request_type = FIX::SubscriptionRequestType_SNAPSHOT;
 		auto md_update_type = incremental ? FIX::MDUpdateType_INCREMENTAL_REFRESH : FIX::MDUpdateType_FULL_REFRESH;
+		top_of_book_store.register_symbol(symbol.getString());
 		FIX44::MarketDataRequest request;
 		request.setField(FIX::MDReqID(request_id));
 		request.setField(FIX::SubscriptionRequestType(subscription_request_type));
@@ -1143,7 +1096,7 @@ namespace zorro {
 		entry_types.setField(FIX::MDEntryType(FIX::MDEntryType_OFFER));
 		request.addGroup(entry_types);
 
-		log::debug<dl4, false>("FixClient::market_data_snapshot: {} subscribe_after_snapshot={}", fix_string(request), subscribe_after_snapshot);
+		log::debug<dl4, false>("FixClient::market_data_snapshot: {} subscribe_after_snapshot={}", lazy_fix_string(request), subscribe_after_snapshot);
 
 		this->subscribe_after_snapshot = subscribe_after_snapshot;
 
@@ -1167,6 +1120,7 @@ namespace zorro {
 			auto request_id = std::format("{}_{}", symbol.getString(), id_generator.genID());
 			auto subscription_request_type = FIX::SubscriptionRequestType_SNAPSHOT_AND_UPDATES;
 			auto md_update_type = incremental ? FIX::MDUpdateType_INCREMENTAL_REFRESH : FIX::MDUpdateType_FULL_REFRESH;
+			top_of_book_store.register_symbol(symbol.getString());
 			FIX44::MarketDataRequest request;
 			request.setField(FIX::MDReqID(request_id));
 			request.setField(FIX::SubscriptionRequestType(subscription_request_type));
@@ -1188,7 +1142,7 @@ namespace zorro {
 				request.addGroup(entry_types);
 			}
 
-			log::debug<dl4, false>("FixClient::subscribe_market_data: {}", fix_string(request));
+			log::debug<dl4, false>("FixClient::subscribe_market_data: {}", lazy_fix_string(request));
 
 			FIX::Session::sendToTarget(request, market_data_session_id);
 
@@ -1224,7 +1178,7 @@ namespace zorro {
 				request.addGroup(entry_types);
 			}
 
-			log::debug<dl4, false>("FixClient::unsubscribe_market_data: {}", fix_string(request));
+			log::debug<dl4, false>("FixClient::unsubscribe_market_data: {}", lazy_fix_string(request));
 
 			FIX::Session::sendToTarget(request, market_data_session_id);
 
@@ -1243,7 +1197,7 @@ namespace zorro {
 		request.setField(FIX::TradingSessionID("FXCM"));
 		request.setField(FIX::SubscriptionRequestType(FIX::SubscriptionRequestType_SNAPSHOT));
 		
-		log::debug<dl4, false>("FixClient::trading_session_status_request: {}", fix_string(request));
+		log::debug<dl4, false>("FixClient::trading_session_status_request: {}", lazy_fix_string(request));
 
 		FIX::Session::sendToTarget(request, trading_session_id);
 
@@ -1258,7 +1212,7 @@ namespace zorro {
 		request.setField(FIX::TradingSessionID("FXCM"));
 		request.setField(FIX::SubscriptionRequestType(subscription_req_type));
 
-		log::debug<dl4, false>("FixClient::collateral_inquiry: {}", fix_string(request));
+		log::debug<dl4, false>("FixClient::collateral_inquiry: {}", lazy_fix_string(request));
 
 		FIX::Session::sendToTarget(request, trading_session_id);
 
@@ -1288,7 +1242,7 @@ namespace zorro {
 		parties_group.addGroup(sub_parties);
 		request.addGroup(parties_group);
 
-		log::debug<dl1, false>("FixClient::request_for_positions: {}", fix_string(request));
+		log::debug<dl1, false>("FixClient::request_for_positions: {}", lazy_fix_string(request));
 
 		FIX::Session::sendToTarget(request, trading_session_id);
 
@@ -1300,7 +1254,7 @@ namespace zorro {
 		request.setField(FIX::MassStatusReqID(id_generator.genID()));
 		request.setField(FIX::MassStatusReqType(FIX::MassStatusReqType_STATUS_FOR_ALL_ORDERS));
 
-		log::debug<dl1, false>("FixClient::order_mass_status_request: {}", fix_string(request));
+		log::debug<dl1, false>("FixClient::order_mass_status_request: {}", lazy_fix_string(request));
 
 		FIX::Session::sendToTarget(request, trading_session_id);
 
@@ -1354,13 +1308,117 @@ namespace zorro {
 			order.setField(FXCM_FIX_FIELDS::FXCM_POS_ID, position_id.value());
 		}
 
-		log::debug<dl4, false>("FixClient::newOrderSingle[{}]: {}" , trading_session_id.toString(), fix_string(order));
+		log::debug<dl4, false>("FixClient::newOrderSingle[{}]: {}" , trading_session_id.toString(), lazy_fix_string(order));
 
 		FIX::Session::sendToTarget(order, trading_session_id);
 
 		return std::optional<FIX::Message>(order);
 	}	
 
+	std::optional<std::future<ExecReport>> FixClient::submit_new_order_single(
+		const FIX::Symbol& symbol,
+		const FIX::ClOrdID& cl_ord_id,
+		const FIX::Side& side,
+		const FIX::OrdType& ord_type,
+		const FIX::TimeInForce& tif,
+		const FIX::OrderQty& order_qty,
+		const FIX::Price& price,
+		const FIX::StopPx& stop_price,
+		const std::optional<std::string>& position_id,
+		const std::optional<FIX::Account>& account
+	) {
+		auto future = pending_order_requests.add(cl_ord_id.getString(), order_completion(ord_type.getValue()));
+		if (!future.has_value()) {
+			log::error<true>("FixClient::submit_new_order_single: request with cl_ord_id={} already pending", cl_ord_id.getString());
+			return future;
+		}
+		auto msg = new_order_single(symbol, cl_ord_id, side, ord_type, tif, order_qty, price, stop_price, position_id, account);
+		if (!msg.has_value()) {
+			pending_order_requests.remove(cl_ord_id.getString());
+			return std::optional<std::future<ExecReport>>();
+		}
+		return future;
+	}
+
+	bool FixClient::submit_new_order_single(
+		const PendingOrderRequests::callback_t& callback,
+		const std::chrono::milliseconds& timeout,
+		const FIX::Symbol& symbol,
+		const FIX::ClOrdID& cl_ord_id,
+		const FIX::Side& side,
+		const FIX::OrdType& ord_type,
+		const FIX::TimeInForce& tif,
+		const FIX::OrderQty& order_qty,
+		const FIX::Price& price,
+		const FIX::StopPx& stop_price,
+		const std::optional<std::string>& position_id,
+		const std::optional<FIX::Account>& account
+	) {
+		if (!pending_order_requests.add(cl_ord_id.getString(), order_completion(ord_type.getValue()), callback, timeout)) {
+			log::error<true>("FixClient::submit_new_order_single: request with cl_ord_id={} already pending", cl_ord_id.getString());
+			return false;
+		}
+		auto msg = new_order_single(symbol, cl_ord_id, side, ord_type, tif, order_qty, price, stop_price, position_id, account);
+		if (!msg.has_value()) {
+			pending_order_requests.remove(cl_ord_id.getString());
+			return false;
+		}
+		return true;
+	}
+
+	std::optional<std::future<ExecReport>> FixClient::submit_order_cancel_request(
+		const FIX::Symbol& symbol,
+		const FIX::OrderID& ord_id,
+		const FIX::OrigClOrdID& orig_cl_ord_id,
+		const FIX::ClOrdID& cl_ord_id,
+		const FIX::Side& side,
+		const FIX::OrderQty& order_qty,
+		const std::optional<std::string>& position_id,
+		const std::optional<FIX::Account>& account
+	) {
+		auto future = pending_order_requests.add(cl_ord_id.getString(), is_canceled_or_reject, ord_id.getString());
+		if (!future.has_value()) {
+			log::error<true>("FixClient::submit_order_cancel_request: request with cl_ord_id={} already pending", cl_ord_id.getString());
+			return future;
+		}
+		auto msg = order_cancel_request(symbol, ord_id, orig_cl_ord_id, cl_ord_id, side, order_qty, position_id, account);
+		if (!msg.has_value()) {
+			pending_order_requests.remove(cl_ord_id.getString());
+			return std::optional<std::future<ExecReport>>();
+		}
+		return future;
+	}
+
+	std::optional<std::future<ExecReport>> FixClient::submit_order_cancel_replace_request(
+		const FIX::Symbol& symbol,
+		const FIX::OrderID& ord_id,
+		const FIX::OrigClOrdID& orig_cl_ord_id,
+		const FIX::ClOrdID& cl_ord_id,
+		const FIX::Side& side,
+		const FIX::OrdType& ord_type,
+		const FIX::OrderQty& order_qty,
+		const FIX::Price& price,
+		const FIX::TimeInForce& tif,
+		const std::optional<std::string>& position_id,
+		const std::optional<FIX::Account>& account
+	) {
+		auto future = pending_order_requests.add(cl_ord_id.getString(), is_replaced_or_reject, ord_id.getString());
+		if (!future.has_value()) {
+			log::error<true>("FixClient::submit_order_cancel_replace_request: request with cl_ord_id={} already pending", cl_ord_id.getString());
+			return future;
+		}
+		auto msg = order_cancel_replace_request(symbol, ord_id, orig_cl_ord_id, cl_ord_id, side, ord_type, order_qty, price, tif, position_id, account);
+		if (!msg.has_value()) {
+			pending_order_requests.remove(cl_ord_id.getString());
+			return std::optional<std::future<ExecReport>>();
+		}
+		return future;
+	}
+
+	bool FixClient::remove_pending_request(const std::string& cl_ord_id) {
+		return pending_order_requests.remove(cl_ord_id);
+	}
+
 	std::optional<FIX::Message> FixClient::order_cancel_request(
 		const FIX::Symbol& symbol,
 		const FIX::OrderID& ord_id,
@@ -1395,7 +1453,7 @@ namespace zorro {
 			request.setField(FXCM_FIX_FIELDS::FXCM_POS_ID, position_id.value());
 		}
 
-		log::debug<dl4, false>("FixClient::orderCancelRequest[{}]: {}", trading_session_id.toString(), fix_string(request));
+		log::debug<dl4, false>("FixClient::orderCancelRequest[{}]: {}", trading_session_id.toString(), lazy_fix_string(request));
 
 		FIX::Session::sendToTarget(request, trading_session_id);
 
@@ -1443,7 +1501,7 @@ namespace zorro {
 			request.setField(FXCM_FIX_FIELDS::FXCM_POS_ID, position_id.value());
 		}
 
-		log::debug<dl0, false>("FixClient::orderCancelReplaceRequest[{}]: {}", trading_session_id.toString(), fix_string(request));
+		log::debug<dl0, false>("FixClient::orderCancelReplaceRequest[{}]: {}", trading_session_id.toString(), lazy_fix_string(request));
 
 		FIX::Session::sendToTarget(request, trading_session_id);
 
@@ -1464,18 +1522,4 @@ namespace zorro {
 		else
 			FIX::Session::sendToTarget(test, market_data_session_id);
 	}
-
-	bool FixClient::has_book(const std::string& symbol) {
-		return top_of_books.contains(symbol);
-	}
-
-	TopOfBook FixClient::top_of_book(const std::string& symbol) {
-		auto it = top_of_books.find(symbol);
-		if (it != top_of_books.end()) {
-			return it->second;
-		}
-		else {
-			throw std::runtime_error(std::format("symbol {} not found in top_of_books", symbol));
-		}
-	}
 }
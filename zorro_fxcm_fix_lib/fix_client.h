@@ -38,9 +38,14 @@
 #include "common/blocking_queue.h"
 #include "common/exec_report.h"
 #include "common/market_data.h"
+#include "common/top_of_book_store.h"
+#include "common/instrument_registry.h"
 #include "common/order_tracker.h"
 #include "common/book.h"
 #include "common/fix.h"
+#include "common/exec_report_decoder.h"
+
+#include "pending_requests.h"
 
 #include <variant>
 #include <future>
@@ -211,9 +216,9 @@ namespace zorro
 		FixClient(
 			const FIX::SessionSettings& session_settings,
 			unsigned int num_required_session_logins, 
-			BlockingTimeoutQueue<ExecReport>& exec_report_queue,
-			BlockingTimeoutQueue<StatusExecReport>& status_exec_report_queue,
-			BlockingTimeoutQueue<TopOfBook>& top_of_book_queue,
+			SpScQueue<ExecReport>& exec_report_queue,
+			SpScQueue<StatusExecReport>& status_exec_report_queue,
+			TopOfBookStore& top_of_book_store,
 			BlockingTimeoutQueue<ServiceMessage>& service_message_queue,
 			BlockingTimeoutQueue<FXCMPositionReport>& position_report_queue,
 			BlockingTimeoutQueue<FXCMPositionReports>& position_snapshot_reports_queue,
@@ -270,6 +275,72 @@ namespace zorro
 			const std::optional<FIX::Account>& account = std::optional<FIX::Account>()
 		) const;
 
+		// Sends a NewOrderSingle and returns the future of the exec report completing it, a fill or reject 
+		// for market orders and additionally the NEW ack for other order types. Orders do not block each 
+		// other, any number can be in flight.
+		std::optional<std::future<ExecReport>> submit_new_order_single(
+			const FIX::Symbol& symbol,
+			const FIX::ClOrdID& cl_ord_id,
+			const FIX::Side& side,
+			const FIX::OrdType& ord_type,
+			const FIX::TimeInForce& tif,
+			const FIX::OrderQty& order_qty,
+			const FIX::Price& price,
+			const FIX::StopPx& stop_price,
+			const std::optional<std::string>& position_id = std::optional<std::string>(),
+			const std::optional<FIX::Account>& account = std::optional<FIX::Account>()
+		);
+
+		// as above but the callback is invoked on the FIX thread with the completing exec report, or with
+		// a synthetic reject if none arrived within the timeout, which may also run on the FixService thread
+		bool submit_new_order_single(
+			const PendingOrderRequests::callback_t& callback,
+			const std::chrono::milliseconds& timeout,
+			const FIX::Symbol& symbol,
+			const FIX::ClOrdID& cl_ord_id,
+			const FIX::Side& side,
+			const FIX::OrdType& ord_type,
+			const FIX::TimeInForce& tif,
+			const FIX::OrderQty& order_qty,
+			const FIX::Price& price,
+			const FIX::StopPx& stop_price,
+			const std::optional<std::string>& position_id = std::optional<std::string>(),
+			const std::optional<FIX::Account>& account = std::optional<FIX::Account>()
+		);
+
+		// Sends an OrderCancelRequest and returns the future of the exec report canceling the order or rejecting the request
+		std::optional<std::future<ExecReport>> submit_order_cancel_request(
+			const FIX::Symbol& symbol,
+			const FIX::OrderID& ord_id,
+			const FIX::OrigClOrdID& orig_cl_ord_id,
+			const FIX::ClOrdID& cl_ord_id,
+			const FIX::Side& side,
+			const FIX::OrderQty& order_qty,
+			const std::optional<std::string>& position_id = std::optional<std::string>(),
+			const std::optional<FIX::Account>& account = std::optional<FIX::Account>()
+		);
+
+		// Sends an OrderCancelReplaceRequest and returns the future of the exec report replacing the order or rejecting the request
+		std::optional<std::future<ExecReport>> submit_order_cancel_replace_request(
+			const FIX::Symbol& symbol,
+			const FIX::OrderID& ord_id,
+			const FIX::OrigClOrdID& orig_cl_ord_id,
+			const FIX::ClOrdID& cl_ord_id,
+			const FIX::Side& side,
+			const FIX::OrdType& ord_type,
+			const FIX::OrderQty& order_qty,
+			const FIX::Price& price,
+			const FIX::TimeInForce& tif,
+			const std::optional<std::string>& position_id = std::optional<std::string>(),
+			const std::optional<FIX::Account>& account = std::optional<FIX::Account>()
+		);
+
+		// drops a pending request, returns false if it was already completed
+		bool remove_pending_request(const std::string& cl_ord_id);
+
+		// rejects the callback requests past their timeout, called for every inbound message and by the FixService timer
+		size_t expire_pending_requests();
+
 		std::optional<FIX::Message> order_cancel_request(
 			const FIX::Symbol& symbol,
 			const FIX::OrderID& ord_id,
@@ -365,9 +436,9 @@ namespace zorro
 
 		FIX::SessionSettings session_settings;
 		unsigned int num_required_session_logins;
-		BlockingTimeoutQueue<ExecReport>& exec_report_queue;
-		BlockingTimeoutQueue<StatusExecReport>& status_exec_report_queue;
-		BlockingTimeoutQueue<TopOfBook>& top_of_book_queue;
+		SpScQueue<ExecReport>& exec_report_queue;
+		SpScQueue<StatusExecReport>& status_exec_report_queue;
+		TopOfBookStore& top_of_book_store;
 		BlockingTimeoutQueue<ServiceMessage>& service_message_queue;
 		BlockingTimeoutQueue<FXCMPositionReport>& position_report_queue;
 		BlockingTimeoutQueue<FXCMPositionReports>& position_snapshot_reports_queue;
@@ -385,15 +456,16 @@ namespace zorro
 		bool subscribe_after_snapshot{ false };
 
 		std::map<std::string, std::string> market_data_subscriptions;
-		std::map<std::string, TopOfBook> top_of_books;
+		std::vector<std::optional<TopOfBook>> top_of_books; // indexed by instrument id, only touched by the FIX thread, readers use the top_of_book_store
+		std::vector<uint32_t> changed_instrument_ids;
 		std::vector<FXCMPositionReport> position_report_list;
+		PendingOrderRequests pending_order_requests;
+		fix::ExecReportDecoder exec_report_decoder{ FXCM_FIX_FIELDS::FXCM_POS_ID };
+		ExecReport decoded_exec_report;
+		StatusExecReport decoded_status_exec_report;
 
 		std::mutex mutex;
 
-		// should not be used anymore, use the top_of_book_queue
-		bool has_book(const std::string& symbol);
-		TopOfBook top_of_book(const std::string& symbol);
-
 		// FIX Application interface
 
 		void onCreate(const FIX::SessionID&);
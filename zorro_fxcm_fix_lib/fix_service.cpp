@@ -10,14 +10,21 @@ namespace zorro {
 	void FixService::run() {
 		initiator->start();
 		spdlog::debug("FixService: FIX initiator started");
+
+		std::unique_lock<std::mutex> ul(stop_mutex);
+		while (!stop_cv.wait_for(ul, expire_period, [this]() { return stopping; })) {
+			ul.unlock();
+			fix_client->expire_pending_requests();
+			ul.lock();
+		}
 	}
 
 	FixService::FixService(
 		const std::string& settings_cfg_file,
 		unsigned int num_required_session_logins,
-		BlockingTimeoutQueue<ExecReport>& exec_report_queue,
-		BlockingTimeoutQueue<StatusExecReport>& status_exec_report_queue,
-		BlockingTimeoutQueue<TopOfBook>& top_of_book_queue,
+		SpScQueue<ExecReport>& exec_report_queue,
+		SpScQueue<StatusExecReport>& status_exec_report_queue,
+		TopOfBookStore& top_of_book_store,
 		BlockingTimeoutQueue<ServiceMessage>& service_message_queue,
 		BlockingTimeoutQueue<FXCMPositionReport>& position_report_queue,
 		BlockingTimeoutQueue<FXCMPositionReports>& position_snapshot_reports_queue,
@@ -33,7 +40,7 @@ namespace zorro {
 			num_required_session_logins,
 			exec_report_queue,
 			status_exec_report_queue,
-			top_of_book_queue,
+			top_of_book_store,
 			service_message_queue,
 			position_report_queue,
 			position_snapshot_reports_queue,
@@ -59,9 +66,9 @@ namespace zorro {
 	FixService::FixService(
 		const std::string& settings_cfg_file,
 		unsigned int num_required_session_logins,
-		BlockingTimeoutQueue<ExecReport>& exec_report_queue,
-		BlockingTimeoutQueue<StatusExecReport>& status_exec_report_queue,
-		BlockingTimeoutQueue<TopOfBook>& top_of_book_queue,
+		SpScQueue<ExecReport>& exec_report_queue,
+		SpScQueue<StatusExecReport>& status_exec_report_queue,
+		TopOfBookStore& top_of_book_store,
 		BlockingTimeoutQueue<ServiceMessage>& service_message_queue,
 		BlockingTimeoutQueue<FXCMPositionReport>& position_reports_queue,
 		BlockingTimeoutQueue<FXCMPositionReports>& position_snapshot_reports_queue,
@@ -78,7 +85,7 @@ namespace zorro {
 			num_required_session_logins,
 			exec_report_queue,
 			status_exec_report_queue,
-			top_of_book_queue,
+			top_of_book_store,
 			service_message_queue,
 			position_reports_queue,
 			position_snapshot_reports_queue,
@@ -98,6 +105,7 @@ namespace zorro {
 
 	void FixService::start() {
 		started = true;
+		stopping = false;
 		thread = std::thread(&FixService::run, this);
 		spdlog::debug("FixService: FIX fix_client thread started");
 	}
@@ -106,6 +114,11 @@ namespace zorro {
 		if (!started)
 			return;
 		started = false;
+		{
+			std::lock_guard<std::mutex> ul(stop_mutex);
+			stopping = true;
+		}
+		stop_cv.notify_one();
 		initiator->stop(true);
 		spdlog::debug("FixService: FIX initiator and fix client stopped - going to join");
 		if (thread.joinable())
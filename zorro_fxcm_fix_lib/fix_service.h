@@ -32,9 +32,9 @@ namespace zorro {
 		FixService(
 			const std::string& settings_cfg_file,
 			unsigned int num_required_session_logins,
-			BlockingTimeoutQueue<ExecReport>& exec_report_queue,
-			BlockingTimeoutQueue<StatusExecReport>& status_exec_report_queue,
-			BlockingTimeoutQueue<TopOfBook>& top_of_book_queue,
+			SpScQueue<ExecReport>& exec_report_queue,
+			SpScQueue<StatusExecReport>& status_exec_report_queue,
+			TopOfBookStore& top_of_book_store,
 			BlockingTimeoutQueue<ServiceMessage>& service_message_queue,
 			BlockingTimeoutQueue<FXCMPositionReport>& position_report_queue,
 			BlockingTimeoutQueue<FXCMPositionReports>& position_snapshot_reports_queue,
@@ -48,9 +48,9 @@ namespace zorro {
 		FixService(
 			const std::string& settings_cfg_file,
 			unsigned int num_required_session_logins,
-			BlockingTimeoutQueue<ExecReport>& exec_report_queue,
-			BlockingTimeoutQueue<StatusExecReport>& status_exec_report_queue,
-			BlockingTimeoutQueue<TopOfBook>& top_of_book_queue,
+			SpScQueue<ExecReport>& exec_report_queue,
+			SpScQueue<StatusExecReport>& status_exec_report_queue,
+			TopOfBookStore& top_of_book_store,
 			BlockingTimeoutQueue<ServiceMessage>& service_message_queue,
 			BlockingTimeoutQueue<FXCMPositionReport>& position_reports_queue,
 			BlockingTimeoutQueue<FXCMPositionReports>& position_snapshot_reports_queue,
@@ -68,11 +68,18 @@ namespace zorro {
 
 	private:
 
+		// starts the initiator, then expires timed out callback requests until cancelled so that
+		// their timeout holds while no messages arrive
 		void run();
 
 		void create_factories();
 
+		static constexpr std::chrono::milliseconds expire_period{ 100 };
+
 		bool started;
+		bool stopping{ false };
+		std::mutex stop_mutex;
+		std::condition_variable stop_cv;
 		std::string settings_cfg_file;
 		FIX::SessionSettings* settings;
 		FIX::FileStoreFactory* store_factory;
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "pch.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <thread>
+
+#include "quickfix/Message.h"
+
+namespace zorro {
+
+	enum class FixTraceKind : uint8_t {
+		admin_in = 0,
+		admin_out = 1,
+		app_in = 2,
+		app_out = 3
+	};
+
+	inline std::string_view to_string(FixTraceKind kind) {
+		switch (kind) {
+			case FixTraceKind::admin_in: return "Admin IN ";
+			case FixTraceKind::admin_out: return "Admin OUT";
+			case FixTraceKind::app_in: return "App   IN ";
+			case FixTraceKind::app_out: return "App   OUT";
+			default: return "?";
+		}
+	}
+
+	/*
+	 * Asynchronous binary sink for raw FIX message traces. The QuickFIX callbacks only append a
+	 * length prefixed record with the raw tag=value bytes to a buffer under a short lock, a writer
+	 * thread swaps the buffer out, masks the identifying fields and appends it to the file.
+	 *
+	 * File layout: the magic "FIXTRC01" followed by records of
+	 *   int64 timestamp in nanoseconds since the epoch | uint8 kind | uint32 length | length bytes
+	 * in native byte order. Use read_fix_trace to convert a file back to text.
+	 *
+	 * If the writer cannot keep up, records beyond max_buffered_bytes are dropped and counted.
+	 */
+	class FixTraceSink {
+	public:
+		static constexpr std::string_view magic = "FIXTRC01";
+		static constexpr size_t record_header_size = sizeof(int64_t) + sizeof(uint8_t) + sizeof(uint32_t);
+
+		explicit FixTraceSink(
+			const std::string& filename,
+			bool mask = true,
+			std::chrono::milliseconds flush_interval = std::chrono::milliseconds(500),
+			size_t max_buffered_bytes = 64 * 1024 * 1024
+		)
+			: out(filename, std::ios::binary | std::ios::trunc)
+			, mask(mask)
+			, flush_interval(flush_interval)
+			, max_buffered_bytes(max_buffered_bytes)
+		{
+			if (!out) {
+				throw std::runtime_error(std::format("FixTraceSink: cannot open {}", filename));
+			}
+			out.write(magic.data(), magic.size());
+			writer = std::thread([this]() { run(); });
+		}
+
+		FixTraceSink(const FixTraceSink&) = delete;
+
+		FixTraceSink& operator=(const FixTraceSink&) = delete;
+
+		~FixTraceSink() {
+			{
+				std::lock_guard<std::mutex> ul(mutex);
+				stopped = true;
+			}
+			cv.notify_one();
+			writer.join();
+		}
+
+		// raw is the FIX message with SOH delimiters as produced by FIX::Message::toString
+		void write_raw(FixTraceKind kind, std::string_view raw) {
+			auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::system_clock::now().time_since_epoch()).count();
+			std::lock_guard<std::mutex> ul(mutex);
+			if (pending.size() + record_header_size + raw.size() > max_buffered_bytes) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+			append_record(pending, timestamp, kind, raw);
+		}
+
+		void write(FixTraceKind kind, const FIX::Message& message) {
+			thread_local std::string buffer;
+			write_raw(kind, message.toString(buffer));
+		}
+
+		size_t num_dropped() const {
+			return dropped.load(std::memory_order_relaxed);
+		}
+
+	private:
+		static void append_record(std::vector<char>& buffer, int64_t timestamp, FixTraceKind kind, std::string_view raw) {
+			auto length = static_cast<uint32_t>(raw.size());
+			auto offset = buffer.size();
+			buffer.resize(offset + record_header_size + raw.size());
+			auto p = buffer.data() + offset;
+			std::memcpy(p, &timestamp, sizeof(timestamp));
+			p += sizeof(timestamp);
+			*p++ = static_cast<char>(kind);
+			std::memcpy(p, &length, sizeof(length));
+			p += sizeof(length);
+			std::memcpy(p, raw.data(), raw.size());
+		}
+
+		void run() {
+			std::vector<char> batch, masked;
+			while (true) {
+				bool stop = false;
+				{
+					std::unique_lock<std::mutex> ul(mutex);
+					cv.wait_for(ul, flush_interval, [this]() { return stopped; });
+					std::swap(batch, pending);
+					stop = stopped;
+				}
+				if (!batch.empty()) {
+					if (mask) {
+						mask_batch(batch, masked);
+						std::swap(batch, masked);
+					}
+					out.write(batch.data(), batch.size());
+					out.flush();
+					batch.clear();
+				}
+				if (stop) {
+					return;
+				}
+			}
+		}
+
+		// rewrites the records of a batch with the account and credential fields masked
+		static void mask_batch(const std::vector<char>& batch, std::vector<char>& masked) {
+			masked.clear();
+			std::string message;
+			size_t pos = 0;
+			while (pos + record_header_size <= batch.size()) {
+				int64_t timestamp;
+				uint32_t length;
+				std::memcpy(&timestamp, batch.data() + pos, sizeof(timestamp));
+				auto kind = static_cast<FixTraceKind>(batch[pos + sizeof(timestamp)]);
+				std::memcpy(&length, batch.data() + pos + sizeof(timestamp) + 1, sizeof(length));
+				pos += record_header_size;
+				mask_message(std::string_view(batch.data() + pos, length), message);
+				append_record(masked, timestamp, kind, message);
+				pos += length;
+			}
+		}
+
+		static void mask_message(std::string_view raw, std::string& message) {
+			message.clear();
+			size_t pos = 0;
+			while (pos < raw.size()) {
+				auto end = raw.find('\x1', pos);
+				if (end == std::string_view::npos)
+					end = raw.size();
+				auto field = raw.substr(pos, end - pos);
+				auto eq = field.find('=');
+				auto tag = eq == std::string_view::npos ? std::string_view() : field.substr(0, eq);
+				if (tag == "49") {
+					message.append(field.substr(3).starts_with("MD") ? "49=MDataSenderCompID_Masked" : "49=TExecSenderCompID_Masked");
+				}
+				else if (tag == "1") {
+					message.append("1=Account_Masked");
+				}
+				else if (tag == "553" || tag == "554") {
+					message.append(tag).append("=Masked");
+				}
+				else {
+					message.append(field);
+				}
+				if (end < raw.size())
+					message.push_back('\x1');
+				pos = end + 1;
+			}
+		}
+
+		std::ofstream out;
+		bool mask;
+		std::chrono::milliseconds flush_interval;
+		size_t max_buffered_bytes;
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::vector<char> pending;
+		bool stopped{ false };
+		std::atomic<size_t> dropped{ 0 };
+		std::thread writer;
+	};
+
+	/*
+	 * Reads a trace written by FixTraceSink and calls op(timestamp, kind, raw) for each record,
+	 * returns the number of records read.
+	 */
+	template<typename Op>
+	size_t read_fix_trace(const std::string& filename, Op op) {
+		std::ifstream in(filename, std::ios::binary);
+		char file_magic[FixTraceSink::magic.size()];
+		if (!in.read(file_magic, sizeof(file_magic)) || std::string_view(file_magic, sizeof(file_magic)) != FixTraceSink::magic) {
+			throw std::runtime_error(std::format("read_fix_trace: {} is not a FIX trace file", filename));
+		}
+		size_t count = 0;
+		std::string raw;
+		while (true) {
+			int64_t timestamp;
+			uint8_t kind;
+			uint32_t length;
+			if (!in.read(reinterpret_cast<char*>(&timestamp), sizeof(timestamp))
+				|| !in.read(reinterpret_cast<char*>(&kind), sizeof(kind))
+				|| !in.read(reinterpret_cast<char*>(&length), sizeof(length)))
+				break;
+			raw.resize(length);
+			if (!in.read(raw.data(), length))
+				break;
+			op(std::chrono::nanoseconds(timestamp), static_cast<FixTraceKind>(kind), std::string_view(raw));
+			++count;
+		}
+		return count;
+	}
+}
@@ -17,6 +17,7 @@
 #include <atomic>
 #include <thread>
 #include <future>
+#include <condition_variable>
 #include <type_traits>
 #include <filesystem>
 #include <unordered_map>
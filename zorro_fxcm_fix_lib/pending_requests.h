@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "quickfix/FixValues.h"
+
+#include "common/exec_report.h"
+
+namespace zorro {
+
+	// decides if an exec report completes a pending order request
+	typedef std::function<bool(const common::ExecReport&)> completion_t;
+
+	// a NEW ack, a fill or a reject completes a limit order request
+	inline bool is_new_fill_or_reject(const common::ExecReport& report) {
+		return (report.exec_type == FIX::ExecType_NEW && report.ord_status == FIX::OrdStatus_NEW)
+			|| (report.exec_type == FIX::ExecType_TRADE && report.ord_status == FIX::OrdStatus_FILLED)
+			|| (report.exec_type == FIX::ExecType_REJECTED && report.ord_status == FIX::OrdStatus_REJECTED);
+	}
+
+	// only a complete fill or a reject completes a market order request
+	inline bool is_fill_or_reject(const common::ExecReport& report) {
+		return (report.exec_type == FIX::ExecType_TRADE && report.ord_status == FIX::OrdStatus_FILLED)
+			|| (report.exec_type == FIX::ExecType_REJECTED && report.ord_status == FIX::OrdStatus_REJECTED);
+	}
+
+	inline bool is_canceled_or_reject(const common::ExecReport& report) {
+		return (report.exec_type == FIX::ExecType_CANCELED && report.ord_status == FIX::OrdStatus_CANCELED)
+			|| (report.exec_type == FIX::ExecType_REJECTED && report.ord_status == FIX::OrdStatus_REJECTED);
+	}
+
+	inline bool is_replaced_or_reject(const common::ExecReport& report) {
+		return (report.exec_type == FIX::ExecType_REPLACED && report.ord_status == FIX::OrdStatus_REPLACED)
+			|| (report.exec_type == FIX::ExecType_REJECTED && report.ord_status == FIX::OrdStatus_REJECTED);
+	}
+
+	inline completion_t order_completion(char ord_type) {
+		if (ord_type == FIX::OrdType_MARKET)
+			return is_fill_or_reject;
+		else
+			return is_new_fill_or_reject;
+	}
+
+	/*
+	 * Order requests in flight keyed by ClOrdID. The FIX thread routes each exec report on arrival,
+	 * by its ClOrdID or else by its OrderID for requests on an existing order, and completes the
+	 * request with the first report satisfying the completion condition, either through a future or
+	 * a callback which runs on the FIX thread. Routing is O(1), many requests can be pending at once
+	 * and a waiter never has to scan or consume unrelated exec reports.
+	 *
+	 * A future waiter removes its request when it times out. Callback requests carry a deadline
+	 * instead, expire completes them with a synthetic reject once it passed. Expire is called for
+	 * every inbound message and by the FixService timer, the earliest deadline is kept in an atomic
+	 * so that the common case of nothing to expire does not take the lock.
+	 */
+	class PendingOrderRequests {
+	public:
+		typedef std::function<void(const common::ExecReport&)> callback_t;
+		typedef std::chrono::steady_clock::time_point time_point_t;
+
+		/*
+		 * Must be added before the request is sent so that no exec report can be missed. Requests on
+		 * an existing order such as cancels also pass its OrderID, the latest request on an order wins.
+		 * Returns no future if a request with the same ClOrdID is already pending.
+		 */
+		std::optional<std::future<common::ExecReport>> add(const std::string& cl_ord_id, completion_t completion, const std::string& ord_id = std::string()) {
+			Request request{ std::move(completion), ord_id };
+			auto future = request.promise.get_future();
+			if (!insert(cl_ord_id, std::move(request))) {
+				return std::optional<std::future<common::ExecReport>>();
+			}
+			return std::optional<std::future<common::ExecReport>>(std::move(future));
+		}
+
+		// as above with a callback, returns false if a request with the same ClOrdID is already pending
+		template<class R, class P>
+		bool add(
+			const std::string& cl_ord_id, 
+			completion_t completion, 
+			callback_t callback, 
+			const std::chrono::duration<R, P>& timeout, 
+			const std::string& ord_id = std::string()
+		) {
+			Request request{ std::move(completion), ord_id };
+			request.callback = std::move(callback);
+			request.deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+			return insert(cl_ord_id, std::move(request));
+		}
+
+		// called by the FIX thread for every exec report, returns true if it completed a request
+		bool complete(const common::ExecReport& report) {
+			std::unique_lock<std::mutex> ul(mutex);
+			auto it = requests.find(report.cl_ord_id);
+			if (it == requests.end() && !report.ord_id.empty()) {
+				auto oit = cl_ord_id_by_ord_id.find(report.ord_id);
+				if (oit != cl_ord_id_by_ord_id.end()) {
+					it = requests.find(oit->second);
+				}
+			}
+			if (it == requests.end() || !it->second.completion(report)) {
+				return false;
+			}
+			auto request = extract(it);
+			ul.unlock();
+
+			notify(request, report);
+			return true;
+		}
+
+		// completes the request with a synthetic reject, e.g. on an OrderCancelReject
+		bool reject(const std::string& cl_ord_id, const std::string& text) {
+			std::unique_lock<std::mutex> ul(mutex);
+			auto it = requests.find(cl_ord_id);
+			if (it == requests.end()) {
+				return false;
+			}
+			auto request = extract(it);
+			ul.unlock();
+
+			notify(request, synthetic_reject(cl_ord_id, request.ord_id, text));
+			return true;
+		}
+
+		// completes the callback requests past their deadline with a synthetic reject
+		size_t expire(time_point_t now = std::chrono::steady_clock::now()) {
+			if (now.time_since_epoch().count() < next_deadline.load(std::memory_order_acquire)) {
+				return 0;
+			}
+
+			std::vector<std::pair<std::string, Request>> expired;
+			{
+				std::lock_guard<std::mutex> ul(mutex);
+				auto deadline = time_point_t::max();
+				for (auto it = requests.begin(); it != requests.end();) {
+					auto next = std::next(it);
+					if (it->second.callback && it->second.deadline <= now) {
+						auto cl_ord_id = it->first;
+						expired.emplace_back(std::move(cl_ord_id), extract(it));
+					}
+					else if (it->second.callback) {
+						deadline = std::min(deadline, it->second.deadline);
+					}
+					it = next;
+				}
+				next_deadline.store(deadline.time_since_epoch().count(), std::memory_order_release);
+			}
+
+			for (auto& [cl_ord_id, request] : expired) {
+				notify(request, synthetic_reject(cl_ord_id, request.ord_id, "no exec report before the request timed out"));
+			}
+			return expired.size();
+		}
+
+		// forgets a request, e.g. after its waiter timed out
+		bool remove(const std::string& cl_ord_id) {
+			std::lock_guard<std::mutex> ul(mutex);
+			auto it = requests.find(cl_ord_id);
+			if (it == requests.end()) {
+				return false;
+			}
+			extract(it);
+			return true;
+		}
+
+		size_t size() const {
+			std::lock_guard<std::mutex> ul(mutex);
+			return requests.size();
+		}
+
+	private:
+		struct Request {
+			completion_t completion;
+			std::string ord_id;
+			std::promise<common::ExecReport> promise{};
+			callback_t callback{};
+			time_point_t deadline{ time_point_t::max() };
+		};
+
+		typedef std::unordered_map<std::string, Request> requests_t;
+
+		bool insert(const std::string& cl_ord_id, Request&& request) {
+			std::lock_guard<std::mutex> ul(mutex);
+			if (requests.contains(cl_ord_id)) {
+				return false;
+			}
+			if (!request.ord_id.empty()) {
+				cl_ord_id_by_ord_id.insert_or_assign(request.ord_id, cl_ord_id);
+			}
+			if (request.deadline.time_since_epoch().count() < next_deadline.load(std::memory_order_relaxed)) {
+				next_deadline.store(request.deadline.time_since_epoch().count(), std::memory_order_release);
+			}
+			requests.emplace(cl_ord_id, std::move(request));
+			return true;
+		}
+
+		// called with the lock
+		Request extract(requests_t::iterator it) {
+			auto request = std::move(it->second);
+			if (!request.ord_id.empty()) {
+				auto oit = cl_ord_id_by_ord_id.find(request.ord_id);
+				if (oit != cl_ord_id_by_ord_id.end() && oit->second == it->first) {
+					cl_ord_id_by_ord_id.erase(oit);
+				}
+			}
+			requests.erase(it);
+			return request;
+		}
+
+		static common::ExecReport synthetic_reject(const std::string& cl_ord_id, const std::string& ord_id, const std::string& text) {
+			common::ExecReport report;
+			report.cl_ord_id = cl_ord_id;
+			report.ord_id = ord_id;
+			report.exec_type = FIX::ExecType_REJECTED;
+			report.ord_status = FIX::OrdStatus_REJECTED;
+			report.text = text;
+			return report;
+		}
+
+		static void notify(Request& request, const common::ExecReport& report) {
+			if (request.callback) {
+				request.callback(report);
+			}
+			else {
+				request.promise.set_value(report);
+			}
+		}
+
+		mutable std::mutex mutex;
+		requests_t requests;
+		std::unordered_map<std::string, std::string> cl_ord_id_by_ord_id;
+		std::atomic<time_point_t::rep> next_deadline{ time_point_t::max().time_since_epoch().count() }; // written under the lock
+	};
+}
@@ -12,12 +12,15 @@
 #include "common/exec_report.h"
 #include "common/blocking_queue.h"
 #include "common/json.h"
+#include "common/columnar.h"
 #include "common/time_utils.h"
 
 #include "zorro_common/log.h"
 #include "zorro_common/utils.h"
 #include "zorro_common/enums.h"
 #include "zorro_common/broker_commands.h"
+#include "zorro_common/bar_cache.h"
+#include "zorro_common/tick_store.h"
 
 #include "toml++/toml.h"
 #include "nlohmann/json.h"
@@ -73,6 +76,8 @@ namespace zorro {
 	auto rest_port = std::atoi(fxcm_cfg["market_data_server_port"].value<std::string>().value_or(rest_port_env).c_str());
 
 	httplib::Client rest_client(std::format("{}:{}", rest_host, rest_port));
+	// bars and ticks are requested in the binary columnar format, JSON is still decoded from older servers
+	httplib::Headers rest_accept_columnar = { { "Accept", std::format("{}, application/json", common::columnar::content_type) } };
 
 	std::chrono::milliseconds fix_waiting_time = std::chrono::milliseconds(fix_cfg["waiting_time_ms"].value<int>().value_or(2000));
 	std::chrono::milliseconds fix_login_waiting_time = std::chrono::milliseconds(fix_cfg["login_waiting_time_ms"].value<int>().value_or(4000));  
@@ -92,6 +97,12 @@ namespace zorro {
 	int client_order_id = 0;
 	int internal_order_id = zorro_cfg["internal_order_id_start"].value<int>().value_or(1000);;
 	bool dump_bars_to_file = zorro_cfg["dump_bars_to_file"].value<bool>().value_or(true);
+	bool use_bar_cache = zorro_cfg["bar_cache"].value<bool>().value_or(true);
+	std::string bar_cache_dir = zorro_cfg["bar_cache_dir"].value<std::string>().value_or(std::format("{}/Data/fxcm_bar_cache", zorro_install_dir));
+	bool use_tick_store = zorro_cfg["tick_store"].value<bool>().value_or(true);
+	std::string tick_store_dir = zorro_cfg["tick_store_dir"].value<std::string>().value_or(std::format("{}/Data/fxcm_tick_store", zorro_install_dir));
+	// ticks younger than this may still be missing in the history of the market data server and are not stored
+	DATE tick_store_settle_time = zorro_cfg["tick_store_settle_time_s"].value<int>().value_or(60) / SECONDS_PER_DAY;
 
 	// these come from Zorro when the plugin is started  
 	std::string fxcm_login;
@@ -115,21 +126,37 @@ namespace zorro {
 
 	std::shared_ptr<spdlog::logger> spd_logger = nullptr;
 	std::unique_ptr<FixService> fix_service = nullptr;
-	BlockingTimeoutQueue<TopOfBook> top_of_book_queue;
-	BlockingTimeoutQueue<ExecReport> exec_report_queue;
-	BlockingTimeoutQueue<StatusExecReport> status_exec_report_queue;
+	// transport from the QuickFIX callback thread, quotes are conflated, order reports wait up to
+	// the block timeout of the queue for room so that a stalled consumer cannot stall the FIX session
+	TopOfBookStore top_of_book_store;
+	SpScQueue<ExecReport> exec_report_queue(8192, FullPolicy::block);
+	SpScQueue<StatusExecReport> status_exec_report_queue(8192, FullPolicy::block);
 	BlockingTimeoutQueue<ServiceMessage> service_message_queue;
 	BlockingTimeoutQueue<FXCMPositionReport> position_report_queue;
 	BlockingTimeoutQueue<FXCMPositionReports> position_snapshot_reports_queue;
 	BlockingTimeoutQueue<FXCMCollateralReport> collateral_report_queue;
 	BlockingTimeoutQueue<FXCMTradingSessionStatus> trading_session_status_queue;
 	std::unordered_map<int, std::string> order_id_by_internal_order_id;
-	std::unordered_map<std::string, TopOfBook> top_of_books;
 	std::map<std::string, FXCMCollateralReport> collateral_reports;
 	std::map<std::string, FXCMPositionReport> position_reports;
 	FXCMTradingSessionStatus trading_session_status;
-	OrderTracker order_tracker("unknown-account");
+	// terminal orders beyond the retention limit are spilled to the log directory
+	size_t order_tracker_max_terminal_orders() {
+		auto value = zorro_cfg["order_tracker_max_terminal_orders"].value<int64_t>().value_or(OrderTracker::default_max_terminal_orders);
+		if (value < 0) {
+			throw std::runtime_error(std::format("order_tracker_max_terminal_orders={} must not be negative", value));
+		}
+		return static_cast<size_t>(value);
+	}
+
+	OrderTracker order_tracker(
+		"unknown-account",
+		order_tracker_max_terminal_orders(),
+		std::format("{}/order_tracker_{}.csv", zorro_log_dir, common::timestamp_postfix())
+	);
 	std::vector<ServiceMessage> service_message_history;
+	std::unordered_map<std::string, std::unique_ptr<BarCache>> bar_caches;
+	std::unordered_map<std::string, std::unique_ptr<TickStore>> tick_stores;
 
 	// to share with Zorro strategy scripts
 	std::vector<CFXCMPositionReport> c_open_position_reports;
@@ -186,15 +213,6 @@ namespace zorro {
 		return n;
 	}
 
-	int pop_top_of_books() {
-		auto n = top_of_book_queue.pop_all(
-			[](const TopOfBook& top) { 
-				top_of_books.insert_or_assign(top.symbol, top); 
-			}
-		);
-		return n;
-	}
-
 	template<class T>
 	const std::string& get_position_id(const T& order_or_exec_report) {
 		return order_or_exec_report.custom_1;
@@ -226,103 +244,18 @@ namespace zorro {
 		return std::make_pair(reports, success);
 	}
 
+	// waits for the exec report completing a submitted order, the order tracker is updated with everything queued so far
 	template<class R, class P>
-	std::optional<ExecReport> pop_exec_report_new(const std::string& expected_cl_ord_id, const std::chrono::duration<R, P>& timeout) {
-		log::debug<dl2, true>("pop_exec_report_new: expected_cl_ord_id={}", expected_cl_ord_id);
-		std::optional<ExecReport> target_report = std::optional<ExecReport>();
-		auto success = exec_report_queue.pop_until(
-			[&](const ExecReport& report) {
-				order_tracker.process(report);
-				auto is_new = report.exec_type == FIX::ExecType_NEW 
-					&& report.ord_status == FIX::OrdStatus_NEW
-					&& report.cl_ord_id == expected_cl_ord_id;
-				auto is_fill = report.exec_type == FIX::ExecType_TRADE
-					&& report.ord_status == FIX::OrdStatus_FILLED
-					&& report.cl_ord_id == expected_cl_ord_id;
-				auto is_reject = report.exec_type == FIX::ExecType_REJECTED
-					&& report.ord_status == FIX::OrdStatus_REJECTED
-					&& report.cl_ord_id == expected_cl_ord_id;
-				auto done = is_new || is_fill || is_reject;
-				if (done) {
-					target_report = std::optional<ExecReport>(report);
-				}
-				return done;
-			}, timeout
-		);
-		log::debug<dl2, true>("pop_exec_report_new: report found={}", target_report.has_value());
-		return target_report;
-	}
-	
-	template<class R, class P>
-	std::optional<ExecReport> pop_exec_report_fill(const std::string& expected_cl_ord_id, const std::chrono::duration<R, P>& timeout) {
-		log::debug<dl2, true>("pop_exec_report_fill: expected_cl_ord_id={}", expected_cl_ord_id);
-		std::optional<ExecReport> target_report = std::optional<ExecReport>();
-		auto success = exec_report_queue.pop_until(
-			[&](const ExecReport& report) {
-				order_tracker.process(report);
-				auto is_filled = report.exec_type == FIX::ExecType_TRADE
-					&& report.ord_status == FIX::OrdStatus_FILLED
-					&& report.cl_ord_id == expected_cl_ord_id;
-				auto is_reject = report.exec_type == FIX::ExecType_REJECTED
-					&& report.ord_status == FIX::OrdStatus_REJECTED
-					&& report.cl_ord_id == expected_cl_ord_id;
-				auto done = is_filled || is_reject;
-				if (done) {
-					target_report = std::optional<ExecReport>(report);
-				}
-				return done;
-			}, timeout
-		);
-		log::debug<dl2, true>("pop_exec_report_fill: report found={}", target_report.has_value());
-		return target_report;
-	}
-
-	template<class R, class P>
-	std::optional<ExecReport> pop_exec_report_cancel(const std::string& expected_ord_id, const std::chrono::duration<R, P>& timeout) {
-		log::debug<dl2, true>("pop_exec_report_cancel: expected_ord_id={}", expected_ord_id);
-		std::optional<ExecReport> target_report = std::optional<ExecReport>();
-		auto success = exec_report_queue.pop_until(
-			[&](const ExecReport& report) {
-				order_tracker.process(report);
-				auto is_cancel = report.exec_type == FIX::ExecType_CANCELED 
-					&& report.ord_status == FIX::OrdStatus_CANCELED
-					&& report.ord_id == expected_ord_id;
-				auto is_reject = report.exec_type == FIX::ExecType_REJECTED
-					&& report.ord_status == FIX::OrdStatus_REJECTED
-					&& report.cl_ord_id == expected_ord_id;
-				auto done = is_cancel || is_reject;
-				if (done) {
-					target_report = std::optional<ExecReport>(report);
-				}
-				return done;
-			}, timeout
-		);
-		log::debug<dl2, true>("pop_exec_report_cancel: report found={}", target_report.has_value());
-		return target_report;
-	}
-
-	template<class R, class P>
-	std::optional<ExecReport> pop_exec_report_cancel_replace(const std::string& expected_ord_id, const std::chrono::duration<R, P>& timeout) {
-		log::debug<dl2, true>("pop_exec_report_cancel_replace: expected_ord_id={}", expected_ord_id);
-		std::optional<ExecReport> target_report = std::optional<ExecReport>();
-		auto success = exec_report_queue.pop_until(
-			[&](const ExecReport& report) {
-				order_tracker.process(report);
-				auto is_replace = report.exec_type == FIX::ExecType_REPLACED
-					&& report.ord_status == FIX::OrdStatus_REPLACED
-					&& report.ord_id == expected_ord_id;
-				auto is_reject = report.exec_type == FIX::ExecType_REJECTED
-					&& report.ord_status == FIX::OrdStatus_REJECTED
-					&& report.cl_ord_id == expected_ord_id;
-				auto done = is_replace || is_reject;
-				if (done) {
-					target_report = std::optional<ExecReport>(report);
-				}
-				return done;
-			}, timeout
-		);
-		log::debug<dl2, true>("pop_exec_report_cancel_replace: report found={}", target_report.has_value());
-		return target_report;
+	std::optional<ExecReport> wait_exec_report(const std::string& cl_ord_id, std::future<ExecReport>& pending, const std::chrono::duration<R, P>& timeout) {
+		if (pending.wait_for(timeout) != std::future_status::ready && fix_service->client().remove_pending_request(cl_ord_id)) {
+			pop_exec_reports();
+			log::debug<dl2, true>("wait_exec_report: no report for cl_ord_id={}", cl_ord_id);
+			return std::optional<ExecReport>();
+		}
+		auto report = pending.get();
+		pop_exec_reports();
+		log::debug<dl2, true>("wait_exec_report: cl_ord_id={} report={}", cl_ord_id, report.to_string());
+		return std::optional<ExecReport>(report);
 	}
 
 	template<class R, class P>
@@ -586,10 +519,15 @@ namespace zorro {
 		auto from_str = zorro_date_to_string(from);
 		auto to_str = zorro_date_to_string(to);
 		auto request = std::format("/bars?symbol={}&timeframe={}&from={}&to={}", Asset, timeframe, from_str, to_str);
-		auto res = rest_client.Get(request);
+		auto res = rest_client.Get(request, rest_accept_columnar);
 		if (res->status == httplib::StatusCode::OK_200) {
-			auto j = json::parse(res->body);
-			from_json(j, bars);
+			if (common::columnar::is_columnar(res->get_header_value("Content-Type"))) {
+				from_columnar(res->body, bars);
+			}
+			else {
+				auto j = json::parse(res->body);
+				from_json(j, bars);
+			}
 
 			log::debug<4, true>(
 				"get_historical_bars: Asset={} from={} to={} num bars={}",
@@ -600,6 +538,108 @@ namespace zorro {
 		return res->status;
 	}
 
+	// the bar cache of the asset and time frame, opened on first use, null if it cannot be opened
+	BarCache* get_bar_cache(const std::string& asset, const std::string& timeframe) {
+		auto key = std::format("{}_{}", asset, timeframe);
+		auto it = bar_caches.find(key);
+		if (it != bar_caches.end()) {
+			return it->second.get();
+		}
+		std::unique_ptr<BarCache> cache;
+		try {
+			std::filesystem::create_directories(bar_cache_dir);
+			auto name = key;
+			std::replace_if(name.begin(), name.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)) && c != '_'; }, '_');
+			cache = std::make_unique<BarCache>(std::format("{}/{}.bars", bar_cache_dir, name));
+			log::debug<dl2, true>(
+				"get_bar_cache: opened {} with {} bars covering {} to {}",
+				cache->get_filename(), cache->size(), zorro_date_to_string(cache->covered_from()), zorro_date_to_string(cache->covered_to())
+			);
+		}
+		catch (const std::exception& e) {
+			log::error<true>("get_bar_cache: cannot open bar cache for {}: {}", key, e.what());
+		}
+		return bar_caches.emplace(key, std::move(cache)).first->second.get();
+	}
+
+	/*
+	 * Historical bars served from the local bar cache, only the bars outside of the cached range
+	 * are requested from the market data server. Complete bars, i.e. bars which started at least
+	 * one bar period t_bar before now, are added to the cache.
+	 */
+	int get_cached_historical_bars(const char* Asset, const std::string& timeframe, DATE t_bar, DATE from, DATE to, std::vector<BidAskBar<DATE>>& bars) {
+		auto cache = use_bar_cache ? get_bar_cache(Asset, timeframe) : nullptr;
+		if (cache == nullptr) {
+			return get_historical_bars(Asset, timeframe, from, to, bars);
+		}
+
+		auto now = convert_time_chrono(common::get_current_system_clock());
+		auto complete_to = std::min(to, now - t_bar);
+		auto is_complete = [complete_to](const BidAskBar<DATE>& bar) { return bar.timestamp < complete_to; };
+		auto covered_from = cache->covered_from();
+		auto covered_to = cache->covered_to();
+
+		try {
+			// no overlap with the cached range, recent data replaces the cache, older data is not cached
+			if (cache->empty() || from > covered_to || to < covered_from) {
+				auto status = get_historical_bars(Asset, timeframe, from, to, bars);
+				if (status == httplib::StatusCode::OK_200 && (cache->empty() || from > covered_to) && from < complete_to) {
+					std::vector<BidAskBar<DATE>> complete;
+					std::copy_if(bars.begin(), bars.end(), std::back_inserter(complete), is_complete);
+					cache->reset(complete, from, complete_to);
+				}
+				return status;
+			}
+
+			std::vector<BidAskBar<DATE>> head, tail;
+			if (from < covered_from) {
+				auto status = get_historical_bars(Asset, timeframe, from, covered_from, head);
+				if (status != httplib::StatusCode::OK_200) {
+					return status;
+				}
+				std::erase_if(head, [covered_from](const BidAskBar<DATE>& bar) { return bar.timestamp >= covered_from; });
+			}
+			if (to >= covered_to) {
+				auto status = get_historical_bars(Asset, timeframe, covered_to, to, tail);
+				if (status != httplib::StatusCode::OK_200) {
+					return status;
+				}
+				auto last = cache->last_timestamp();
+				std::erase_if(tail, [covered_to, last](const BidAskBar<DATE>& bar) { return bar.timestamp < covered_to || bar.timestamp <= last; });
+			}
+
+			bars.clear();
+			bars.reserve(head.size() + cache->size() + tail.size());
+			bars.insert(bars.end(), head.begin(), head.end());
+			auto num_cached = cache->read(from, to, bars);
+			bars.insert(bars.end(), tail.begin(), tail.end());
+
+			if (from < covered_from) {
+				std::vector<BidAskBar<DATE>> all(head);
+				cache->read(covered_from, covered_to, all);
+				cache->reset(all, from, covered_to);
+			}
+			if (complete_to > covered_to) {
+				std::vector<BidAskBar<DATE>> complete;
+				std::copy_if(tail.begin(), tail.end(), std::back_inserter(complete), is_complete);
+				cache->append(complete, complete_to);
+			}
+
+			log::debug<dl2, true>(
+				"get_cached_historical_bars: Asset={} timeframe={} from={} to={} num bars={} cached={} head={} tail={}",
+				Asset, timeframe, zorro_date_to_string(from), zorro_date_to_string(to), bars.size(), num_cached, head.size(), tail.size()
+			);
+
+			return httplib::StatusCode::OK_200;
+		}
+		catch (const std::exception& e) {
+			log::error<true>("get_cached_historical_bars: bar cache {} failed, disabled: {}", cache->get_filename(), e.what());
+			bar_caches[std::format("{}_{}", Asset, timeframe)].reset();
+			bars.clear();
+			return get_historical_bars(Asset, timeframe, from, to, bars);
+		}
+	}
+
 	// get historical data - note time is in UTC
 	// http://localhost:8080/ticks?symbol=EUR/USD&from=2024-06-27 00:00:00 
 	// http://localhost:8080/ticks?symbol=EUR/USD&count=1000 
@@ -617,18 +657,160 @@ namespace zorro {
 		if (count > 0) {
 			ss << "&count=" << count;
 		}
-		auto res = rest_client.Get(ss.str());
-		if (res->status == httplib::StatusCode::OK_200) {
-			auto j = json::parse(res->body);
-			from_json(j, quotes);
+		// a columnar response is streamed in chunks and decoded as they arrive, JSON is buffered,
+		// a stream cut off in the middle is requested again and never returned as partial ticks
+		constexpr int max_attempts = 2;
+		for (int attempt = 1; attempt <= max_attempts; ++attempt) {
+			bool columnar = false;
+			std::string body;
+			common::columnar::StreamDecoder decoder;
+			quotes.clear();
+			auto res = rest_client.Get(
+				ss.str(),
+				rest_accept_columnar,
+				[&columnar](const httplib::Response& response) {
+					columnar = response.status == httplib::StatusCode::OK_200
+						&& common::columnar::is_columnar(response.get_header_value("Content-Type"));
+					return true;
+				},
+				[&](const char* data, size_t length) {
+					if (columnar) {
+						decoder.feed(data, length, [&quotes](const common::columnar::View& view) { append_columnar(view, quotes); });
+					}
+					else {
+						body.append(data, length);
+					}
+					return true;
+				}
+			);
+			if (!res || (columnar && !decoder.complete())) {
+				log::error<true>(
+					"get_historical_ticks: Asset={} truncated tick stream after {} ticks, attempt {} of {} error={}",
+					Asset, quotes.size(), attempt, max_attempts, res ? "incomplete message" : httplib::to_string(res.error())
+				);
+				continue;
+			}
+			if (res->status == httplib::StatusCode::OK_200) {
+				if (!columnar) {
+					auto j = json::parse(body);
+					from_json(j, quotes);
+				}
 
-			log::debug<4, true>(
-				"get_historical_bars: Asset={} from={} to={} count={} num ticks={}",
-				Asset, from, to, count, quotes.size()
+				log::debug<4, true>(
+					"get_historical_ticks: Asset={} from={} to={} count={} num ticks={}",
+					Asset, from, to, count, quotes.size()
+				);
+			}
+
+			return res->status;
+		}
+
+		quotes.clear();
+		return httplib::StatusCode::BadGateway_502;
+	}
+
+	// the tick store of the asset, opened on first use, null if it cannot be opened
+	TickStore* get_tick_store(const std::string& asset) {
+		auto it = tick_stores.find(asset);
+		if (it != tick_stores.end()) {
+			return it->second.get();
+		}
+		std::unique_ptr<TickStore> store;
+		try {
+			std::filesystem::create_directories(tick_store_dir);
+			auto name = asset;
+			std::replace_if(name.begin(), name.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)); }, '_');
+			store = std::make_unique<TickStore>(std::format("{}/{}.ticks", tick_store_dir, name));
+			log::debug<dl2, true>(
+				"get_tick_store: opened {} with {} ticks covering {} to {}",
+				store->get_filename(), store->size(), zorro_date_to_string(store->covered_from()), zorro_date_to_string(store->covered_to())
 			);
 		}
+		catch (const std::exception& e) {
+			log::error<true>("get_tick_store: cannot open tick store for {}: {}", asset, e.what());
+		}
+		return tick_stores.emplace(asset, std::move(store)).first->second.get();
+	}
 
-		return res->status;
+	/*
+	 * Extends the tick store so that it holds the ticks of [t_start, t_end], or at least the n_ticks
+	 * most recent ones, requesting only the missing head or tail from the market data server. Ticks
+	 * which are too recent to be stored, or outside of a range the store can cover contiguously,
+	 * are returned in unstored. They never overlap with the stored ticks in [t_start, t_end].
+	 */
+	int update_tick_store(TickStore& store, const char* asset, DATE t_start, DATE t_end, int n_ticks, std::vector<Quote<DATE>>& unstored) {
+		auto now = convert_time_chrono(common::get_current_system_clock());
+		auto settled_to = std::min(t_end, now - tick_store_settle_time);
+		auto split_at = [](std::vector<Quote<DATE>>& quotes, DATE t, std::vector<Quote<DATE>>& after) {
+			auto it = std::lower_bound(quotes.begin(), quotes.end(), t, [](const Quote<DATE>& q, DATE t) { return q.timestamp < t; });
+			after.insert(after.end(), it, quotes.end());
+			quotes.erase(it, quotes.end());
+		};
+		// if the server truncated the result to count ticks, the range is only covered from the first one on
+		auto covered_from = [](const std::vector<Quote<DATE>>& quotes, int count, DATE from) {
+			return count > 0 && quotes.size() >= static_cast<size_t>(count) ? quotes.front().timestamp : from;
+		};
+		unstored.clear();
+
+		// well before the stored range, not worth a rewrite of the store, consecutive lookback requests
+		// end right before the oldest stored tick and extend the head below
+		if (!store.empty() && t_end < store.covered_from() - tick_store_settle_time) {
+			return get_historical_ticks(asset, t_start, t_end, n_ticks, unstored);
+		}
+
+		// the tail, without a gap to the stored range the store is extended, otherwise replaced
+		if (store.empty() || t_end >= store.covered_to()) {
+			auto reset = store.empty() || t_start > store.covered_to();
+			auto from = reset ? t_start : store.covered_to();
+			std::vector<Quote<DATE>> quotes;
+			auto status = get_historical_ticks(asset, from, t_end, n_ticks, quotes);
+			if (status != httplib::StatusCode::OK_200) {
+				return status;
+			}
+			auto truncated_from = covered_from(quotes, n_ticks, from);
+			if (!reset) {
+				std::erase_if(quotes, [&store](const Quote<DATE>& q) { return q.timestamp < store.covered_to(); });
+				reset = truncated_from > from;
+			}
+			from = truncated_from;
+			split_at(quotes, settled_to, unstored);
+			if (reset && from < settled_to) {
+				store.reset(quotes, from, settled_to);
+			}
+			else if (!reset && settled_to > store.covered_to()) {
+				store.append(quotes, settled_to);
+			}
+			else {
+				unstored.insert(unstored.begin(), quotes.begin(), quotes.end());
+			}
+		}
+
+		/*
+		 * The head, as Zorro fills the lookback with consecutive requests going back in time. Each
+		 * extension rewrites the store, so at least as many ticks as are stored are requested to keep
+		 * the rewrites amortized linear.
+		 */
+		size_t have = store.count(t_start, t_end) + unstored.size();
+		if (have < static_cast<size_t>(n_ticks) && t_start < store.covered_from() && !store.empty()) {
+			auto count = std::max(n_ticks - static_cast<int>(have), static_cast<int>(std::min<size_t>(store.size(), 500000)));
+			std::vector<Quote<DATE>> quotes;
+			auto status = get_historical_ticks(asset, t_start, store.covered_from(), count, quotes);
+			if (status != httplib::StatusCode::OK_200) {
+				return status;
+			}
+			auto from = covered_from(quotes, count, t_start);
+			std::erase_if(quotes, [&store](const Quote<DATE>& q) { return q.timestamp >= store.covered_from(); });
+			store.read(store.covered_from(), store.covered_to(), quotes);
+			store.reset(quotes, from, store.covered_to());
+		}
+
+		log::debug<dl2, true>(
+			"update_tick_store: Asset={} from={} to={} store covers {} to {} with {} ticks, {} ticks not stored",
+			asset, zorro_date_to_string(t_start), zorro_date_to_string(t_end),
+			zorro_date_to_string(store.covered_from()), zorro_date_to_string(store.covered_to()), store.size(), unstored.size()
+		);
+
+		return httplib::StatusCode::OK_200;
 	}
 
 	DLLFUNC_C void BrokerHTTP(FARPROC fp_send, FARPROC fp_status, FARPROC fp_result, FARPROC fp_free) {
@@ -698,7 +880,7 @@ namespace zorro {
 					fix_num_required_session_logins,
 					exec_report_queue,
 					status_exec_report_queue,
-					top_of_book_queue,
+					top_of_book_store,
 					service_message_queue,
 					position_report_queue,
 					position_snapshot_reports_queue,
@@ -849,7 +1031,6 @@ namespace zorro {
 			);
 		}
 
-		pop_top_of_books();
 		pop_position_reports();
 		pop_collateral_reports();
 		pop_service_message();
@@ -977,13 +1158,16 @@ namespace zorro {
 
 			// subscribe to Asset market data
 			if (!price) {  
+				// quotes up to this version are from an earlier subscription
+				auto version = top_of_book_store.version(asset);
+
 				FIX::Symbol symbol(asset);
 				client.subscribe_market_data(symbol, false);
 
 				log::info<dl1, true>("BrokerAsset: subscription request sent for symbol {}", asset);
 
 				TopOfBook top;
-				bool success = top_of_book_queue.pop(top, fix_waiting_time);
+				bool success = top_of_book_store.wait(asset, version, top, fix_waiting_time);
 				if (!success) {
 					throw std::runtime_error(std::format("failed to get snapshot in {}ms", fix_waiting_time));
 				}
@@ -1001,10 +1185,8 @@ namespace zorro {
 				return 1;
 			}
 			else {
-				pop_top_of_books();
-				auto it = top_of_books.find(asset);
-				if (it != top_of_books.end()) {
-					const auto& top = it->second;
+				TopOfBook top;
+				if (top_of_book_store.get(asset, top)) {
 					if (price) *price = top.mid();
 					if (spread) *spread = top.spread();
 
@@ -1124,7 +1306,7 @@ namespace zorro {
 			log::debug<dl2, true>("BrokerHistory2: t_start={}, t_start2={}, t_end={}, now_zorro={}", t_start, t_start2, t_end, now_zorro);
 
 			std::vector<BidAskBar<DATE>> bars;
-			auto status = get_historical_bars(asset, timeframe, t_start2, t_end, bars);
+			auto status = get_cached_historical_bars(asset, timeframe, t_bar, t_start2, t_end, bars);
 			auto success = status == httplib::StatusCode::OK_200;
 
 			if (!success) {
@@ -1180,8 +1362,57 @@ namespace zorro {
 			return count;
 		}
 		else {
-			log::error<true>("BrokerHistory2: called with n_tick_minutes=0 but tick data aka quotes not yet integrated");
-			return 0;
+			log::debug<dl2, true>(
+				"BrokerHistory2 {}: requesting {} T1 ticks from {} to {}",
+				asset, n_ticks, zorro_date_to_string(t_start), zorro_date_to_string(t_end)
+			);
+
+			std::vector<Quote<DATE>> unstored;
+			auto store = use_tick_store ? get_tick_store(asset) : nullptr;
+			int status = 0;
+			if (store != nullptr) {
+				try {
+					status = update_tick_store(*store, asset, t_start, t_end, n_ticks, unstored);
+				}
+				catch (const std::exception& e) {
+					log::error<true>("BrokerHistory2: tick store {} failed, disabled: {}", store->get_filename(), e.what());
+					tick_stores[asset].reset();
+					store = nullptr;
+				}
+			}
+			if (store == nullptr) {
+				status = get_historical_ticks(asset, t_start, t_end, n_ticks, unstored);
+			}
+
+			if (status != httplib::StatusCode::OK_200) {
+				log::error<true>("BrokerHistory2: get_historical_ticks failed status={} Asset={} from={} to={}", status, asset, t_start, t_end);
+				return 0;
+			}
+
+			// T1 data has the same price in all fields, the spread goes to fVal
+			int count = 0;
+			auto write_tick = [&ticks, &count](const Quote<DATE>& quote) {
+				ticks->fOpen = ticks->fClose = ticks->fHigh = ticks->fLow = static_cast<float>(quote.ask);
+				ticks->fVal = static_cast<float>(quote.ask - quote.bid);
+				ticks->fVol = 0;
+				ticks->time = quote.timestamp;
+				++ticks;
+				++count;
+			};
+
+			// the ticks which are not stored are the most recent ones or the only ones
+			for (auto it = unstored.rbegin(); it != unstored.rend() && count < n_ticks; ++it) {
+				if (it->timestamp >= t_start && it->timestamp <= t_end) {
+					write_tick(*it);
+				}
+			}
+			if (store != nullptr && count < n_ticks) {
+				store->read_reverse(t_start, t_end, n_ticks - count, write_tick);
+			}
+
+			log::debug<dl2, true>("BrokerHistory2 {}: returning {} T1 ticks", asset, count);
+
+			return count;
 		}
 	}
 
@@ -1255,23 +1486,18 @@ namespace zorro {
 		auto limit_price = FIX::Price(limit);
 		auto stop_price = FIX::StopPx(stop);
 
-		auto msg = fix_service->client().new_order_single(
-			symbol, cl_ord_id, side, ord_type, time_in_force, qty, limit_price, stop_price
-		);
-
-		if (!msg.has_value()) {
-			log::debug<dl1, true>("BrokerBuy2 {}: failed to create NewOrderSingle", asset);
-			return BrokerError::OrderRejectedOrTimeout;
-		}
-
-		log::debug<dl2, true>("BrokerBuy2 {}: NewOrderSingle {}", asset, fix_string(msg.value()));
-
 		if (ord_type.getValue() == FIX::OrdType_LIMIT || ord_type.getValue() == FIX::OrdType_MARKET) {
+			auto pending = fix_service->client().submit_new_order_single(
+				symbol, cl_ord_id, side, ord_type, time_in_force, qty, limit_price, stop_price
+			);
 
-			// wait for a order status exec report NEW for limit orders and a FILL for market orders
-			auto report = ord_type == FIX::OrdType_LIMIT 
-				? pop_exec_report_new(cl_ord_id.getString(), fix_exec_report_waiting_time)
-			    : pop_exec_report_fill(cl_ord_id.getString(), fix_exec_report_waiting_time);
+			if (!pending.has_value()) {
+				log::debug<dl1, true>("BrokerBuy2 {}: failed to create NewOrderSingle", asset);
+				return BrokerError::OrderRejectedOrTimeout;
+			}
+
+			// completed by the FIX thread with the exec report NEW for limit orders and a FILL for market orders
+			auto report = wait_exec_report(cl_ord_id.getString(), pending.value(), fix_exec_report_waiting_time);
 
 			if (!report.has_value()) {
 				log::error<true>(
@@ -1330,8 +1556,7 @@ namespace zorro {
 	 *		last fill amount.
 	 */
 	DLLFUNC int BrokerTrade(int trade_id, double* open, double* close, double* cost, double* profit) {
-		// pop all the exec reports and markeet data from the queue to have up to date information
-		pop_top_of_books();
+		// pop all the exec reports from the queue to have up to date information
 		pop_exec_reports();
 
 		auto it = order_id_by_internal_order_id.find(trade_id);
@@ -1339,7 +1564,8 @@ namespace zorro {
 			auto [oit, success] = order_tracker.get_order(it->second);
 			if (success) {
 				const auto& order = oit->second;
-				auto pit = top_of_books.find(order.symbol);
+				TopOfBook top;
+				auto has_top = top_of_book_store.get(order.get_symbol(), top);
 				auto filled = static_cast<int>(order.cum_qty);
 
 				if (order.ord_status == FIX::OrdStatus_CANCELED) {
@@ -1349,15 +1575,15 @@ namespace zorro {
 				*cost = 0; // TODO
 				*open = order.avg_px;
 
-				if (pit != top_of_books.end()) {
-					*close = order.is_buy() ? pit->second.bid_price : pit->second.ask_price;
+				if (has_top) {
+					*close = order.is_buy() ? top.bid_price : top.ask_price;
 				}
 
 				// set pnl only if it can be calculated and we have a fill, otherwise set it to zero
-				if (filled && pit != top_of_books.end()) {
+				if (filled && has_top) {
 					*profit = order.is_buy()
-						? (pit->second.bid_price - order.avg_px) * order.cum_qty
-						: (order.avg_px - pit->second.ask_price) * order.cum_qty;
+						? (top.bid_price - order.avg_px) * order.cum_qty
+						: (order.avg_px - top.ask_price) * order.cum_qty;
 				}
 				else {
 					*profit = 0;
@@ -1414,7 +1640,7 @@ namespace zorro {
 					return 0;
 				}
 
-				auto symbol = FIX::Symbol(order.symbol);
+				auto symbol = FIX::Symbol(order.get_symbol());
 				auto ord_id = FIX::OrderID(order.ord_id);
 				auto cl_ord_id = FIX::ClOrdID(next_client_order_id());
 				auto orig_cl_ord_id = FIX::OrigClOrdID(order.cl_ord_id);
@@ -1434,19 +1660,17 @@ namespace zorro {
 					auto side = signed_qty > 0 ? FIX::Side(FIX::Side_BUY) : FIX::Side(FIX::Side_SELL);
 					auto qty = FIX::OrderQty(std::abs(signed_qty));
 
-					auto msg = fix_service->client().new_order_single(
+					auto pending = fix_service->client().submit_new_order_single(
 						symbol, cl_ord_id, side, ord_type, time_in_force, qty,
 						FIX::Price(0), FIX::StopPx(0), position_id
 					);
 
-					if (!msg.has_value()) {
+					if (!pending.has_value()) {
 						log::debug<dl2, true>("BrokerSell2[OrdStatus_FILLED]: failed to create NewOrderSingle");
 						return 0;
 					}
 
-					auto report = limit == 0
-						? pop_exec_report_fill(cl_ord_id.getString(), fix_exec_report_waiting_time)
-						: pop_exec_report_new(cl_ord_id.getString(), fix_exec_report_waiting_time);
+					auto report = wait_exec_report(cl_ord_id.getString(), pending.value(), fix_exec_report_waiting_time);
 
 					if (!report.has_value()) {
 						log::error<true>(
@@ -1496,16 +1720,16 @@ namespace zorro {
 					if (std::abs(amount) == order.leaves_qty) { // cancel all
 						log::debug<dl1, true>("BrokerSell2: cancel order_qty {}", order.leaves_qty);
 
-						auto msg = fix_service->client().order_cancel_request(
+						auto pending = fix_service->client().submit_order_cancel_request(
 							symbol, ord_id, orig_cl_ord_id, cl_ord_id, side, FIX::OrderQty(order.leaves_qty), position_id
 						);
 
-						if (!msg.has_value()) {
+						if (!pending.has_value()) {
 							log::error<true>("BrokerSell2: failed to create OrderCancelRequest");
 							return 0;
 						}
 
-						auto report = pop_exec_report_cancel(ord_id.getString(), fix_exec_report_waiting_time);
+						auto report = wait_exec_report(cl_ord_id.getString(), pending.value(), fix_exec_report_waiting_time);
 
 						if (!report.has_value()) {
 							log::error<true>(
@@ -1531,16 +1755,16 @@ namespace zorro {
 							order.leaves_qty, new_qty
 						);
 
-						auto msg = fix_service->client().order_cancel_replace_request(
+						auto pending = fix_service->client().submit_order_cancel_replace_request(
 							symbol, ord_id, orig_cl_ord_id, cl_ord_id, side, ord_type, FIX::OrderQty(new_qty), price, tif, position_id
 						);
 
-						if (!msg.has_value()) {
+						if (!pending.has_value()) {
 							log::error<true>("BrokerSell2: failed to create OrderCancelReplaceRequest");
 							return 0;
 						}
 
-						auto report = pop_exec_report_cancel_replace(ord_id.getString(), fix_exec_report_waiting_time);
+						auto report = wait_exec_report(cl_ord_id.getString(), pending.value(), fix_exec_report_waiting_time);
 
 						if (!report.has_value()) {
 							log::error<true>(
@@ -1558,16 +1782,16 @@ namespace zorro {
 						}
 					}
 					else { // std::abs(amount) > order.leaves_qty - Zorro bug, amount not properly forwarded to BrokerSell2
-						auto msg = fix_service->client().order_cancel_request(
+						auto pending = fix_service->client().submit_order_cancel_request(
 							symbol, ord_id, orig_cl_ord_id, cl_ord_id, side, FIX::OrderQty(order.leaves_qty), position_id
 						);
 
-						if (!msg.has_value()) {
+						if (!pending.has_value()) {
 							log::error<true>("BrokerSell2: failed to create OrderCancelRequest");
 							return 0;
 						}
 
-						auto report = pop_exec_report_cancel(ord_id.getString(), fix_exec_report_waiting_time);
+						auto report = wait_exec_report(cl_ord_id.getString(), pending.value(), fix_exec_report_waiting_time);
 
 						if (!report.has_value()) {
 							log::error<true>(
@@ -1598,19 +1822,19 @@ namespace zorro {
 						auto side = signed_qty > 0 ? FIX::Side(FIX::Side_BUY) : FIX::Side(FIX::Side_SELL);
 						auto qty = FIX::OrderQty(std::abs(signed_qty));
 
-						msg = fix_service->client().new_order_single(
-							symbol, cl_ord_id, side, ord_type, time_in_force, qty,
+						// pending orders are keyed by ClOrdID, the cancel request above already used cl_ord_id
+						auto offset_cl_ord_id = FIX::ClOrdID(next_client_order_id());
+						auto offset_pending = fix_service->client().submit_new_order_single(
+							symbol, offset_cl_ord_id, side, ord_type, time_in_force, qty,
 							FIX::Price(0), FIX::StopPx(0), position_id
 						);
 
-						if (!msg.has_value()) {
+						if (!offset_pending.has_value()) {
 							log::debug<dl2, true>("BrokerSell2: failed to create NewOrderSingle");
 							return 0;
 						}
 
-						report = limit == 0
-							? pop_exec_report_fill(cl_ord_id.getString(), fix_exec_report_waiting_time)
-							: pop_exec_report_new(cl_ord_id.getString(), fix_exec_report_waiting_time);
+						report = wait_exec_report(offset_cl_ord_id.getString(), offset_pending.value(), fix_exec_report_waiting_time);
 
 						if (!report.has_value()) {
 							log::error<true>(
@@ -1836,7 +2060,7 @@ namespace zorro {
 							return 0;
 						}
 
-						auto symbol = FIX::Symbol(order.symbol);
+						auto symbol = FIX::Symbol(order.get_symbol());
 						auto ord_id = FIX::OrderID(order.ord_id);
 						auto orig_cl_ord_id = FIX::OrigClOrdID(order.cl_ord_id);
 						auto cl_ord_id = FIX::ClOrdID(next_client_order_id());
@@ -1853,16 +2077,16 @@ namespace zorro {
 							
 							log::debug<dl0, true>("BrokerCommand[DO_CANCEL]: executing {} - cancel completely", op);
 
-							auto msg = fix_service->client().order_cancel_request(
+							auto pending = fix_service->client().submit_order_cancel_request(
 								symbol, ord_id, orig_cl_ord_id, cl_ord_id, side, FIX::OrderQty(order.leaves_qty)
 							);
 
-							if (!msg.has_value()) {
+							if (!pending.has_value()) {
 								log::error<true>("BrokerCommand[DO_CANCEL]: failed to create request for {}", op);
 								return 0;
 							}
 
-							report = pop_exec_report_cancel(order.ord_id, fix_exec_report_waiting_time);
+							report = wait_exec_report(cl_ord_id.getString(), pending.value(), fix_exec_report_waiting_time);
 						}
 						else {
 							op = "order cancel/replace";
@@ -1870,16 +2094,16 @@ namespace zorro {
 
 							log::debug<dl0, true>("BrokerCommand[DO_CANCEL]: executing {} - new_qty={}", op, new_qty);
 
-							auto msg = fix_service->client().order_cancel_replace_request(
+							auto pending = fix_service->client().submit_order_cancel_replace_request(
 								symbol, ord_id, orig_cl_ord_id, cl_ord_id, side, ord_type, FIX::OrderQty(new_qty), price, tif
 							);
 
-							if (!msg.has_value()) {
+							if (!pending.has_value()) {
 								log::error<true>("BrokerCommand[DO_CANCEL]: failed to create request for {}", op);
 								return 0;
 							}
 
-							report = pop_exec_report_cancel_replace(order.ord_id, fix_exec_report_waiting_time);
+							report = wait_exec_report(cl_ord_id.getString(), pending.value(), fix_exec_report_waiting_time);
 						}
 
 						if (!report.has_value()) {
@@ -2063,10 +2287,10 @@ namespace zorro {
 				headers << "Name, Price, Spread, RollLong, RollShort, PIP, PIPCost, MarginCost, Leverage, LotAmount, Commission, Symbol, Type, Description";
 				for (const auto& [symbol, info] : trading_session_status.security_informations) {
 					double price = 0, spread = 0, pip_cost = 0, margin_cost = 0, leverage = 0, commission = 0.6;
-					auto it = top_of_books.find(info.symbol);
-					if (it != top_of_books.end()) {
-						price = it->second.ask_price;
-						spread = it->second.ask_price - it->second.bid_price;
+					TopOfBook top;
+					if (top_of_book_store.get(info.symbol, top)) {
+						price = top.ask_price;
+						spread = top.spread();
 					}
 
 					// how should be the mapping?
@@ -2230,7 +2454,7 @@ namespace zorro {
 				c_order_tracker_order_reports.clear();
 				for (const auto& kv : order_tracker.get_orders()) {
 					COrderReport order_report;
-					strncpy_s(order_report.symbol, kv.second.symbol.c_str(), sizeof(COrderReport::symbol));
+					strncpy_s(order_report.symbol, kv.second.get_symbol().c_str(), sizeof(COrderReport::symbol));
 					strncpy_s(order_report.ord_id, kv.second.ord_id.c_str(), sizeof(COrderReport::ord_id));
 					strncpy_s(order_report.cl_ord_id, kv.second.cl_ord_id.c_str(), sizeof(COrderReport::cl_ord_id));
 					order_report.ord_type = kv.second.ord_type;
@@ -12,6 +12,7 @@
 #include "spdlog/spdlog.h"
 
 #include "common/time_utils.h"
+#include "common/fix.h"
 
 namespace zorro {
 
@@ -118,6 +119,9 @@ namespace zorro {
 			noMDEntriesGroup.get(size);
 			noMDEntriesGroup.get(price);
 
+			// market data timestamps are in simulation time which may differ from the wall clock
+			book->second.set_timestamp(common::fix::to_nanoseconds(date.getValue(), time.getValue()));
+
 			auto is_bid = type == FIX::MDEntryType_BID;
 			book->second.update_book(price, size, is_bid);
 		}
@@ -169,8 +173,8 @@ namespace zorro {
 					spdlog::error("MarketDataIncrementalRefresh: no book for {} probably not subscribed? msg={}", symbol.getString(), fix_string(message));
 					continue;
 				}
-				it->second.set_timestamp(get_current_system_clock());
 			} 
+			it->second.set_timestamp(common::fix::to_nanoseconds(date.getValue(), time.getValue()));
 
 			assert(it != books.end());
 			
@@ -188,65 +192,17 @@ namespace zorro {
 
 	void Application::onMessage(const FIX44::ExecutionReport& message, const FIX::SessionID&) 
 	{
-		FIX::Symbol symbol;
-		FIX::ExecID exec_id;
-		FIX::ExecType exec_type;
-		FIX::OrderID ord_id;
-		FIX::ClOrdID cl_ord_id;
-		FIX::OrdStatus ord_status;
-		FIX::OrdType ord_type;
-		FIX::Side side;
-		FIX::TimeInForce tif;
-		FIX::Price price;
-		FIX::OrderQty order_qty;
-		FIX::LastQty last_qty;
-		FIX::LastPx last_px;
-		FIX::LeavesQty leaves_qty;
-		FIX::CumQty cum_qty;
-		FIX::AvgPx avg_px;
-		FIX::Text text;
+		const auto& fields = exec_report_decoder.decode(message);
+		if (!fields.has(fix::ExecReportFields::required_order_fields | fix::ExecReportFields::has_ord_type)) {
+			spdlog::error("Application::onMessage[ExecutionReport]: missing fields {}", fix_string(message));
+			return;
+		}
 
-		message.get(symbol);
-		message.get(exec_id);
-		message.get(exec_type);
-		message.get(ord_id);
-		message.get(cl_ord_id);
-		message.get(ord_status);
-		message.get(ord_type);
-		message.get(side);
-		message.get(tif);
-		message.get(price);
-		message.get(avg_px);
-		message.get(order_qty);
-		message.get(last_qty);
-		message.get(leaves_qty);
-		message.get(last_px);
-		message.get(cum_qty);
-		message.get(text);
-
-		ExecReport report(
-			symbol.getString(),
-			ord_id.getString(),
-			cl_ord_id.getString(),
-			exec_id.getString(),
-			exec_type.getValue(),
-			ord_type.getValue(),
-			ord_status.getValue(),
-			side.getValue(),
-			tif.getValue(),
-			price.getValue(),
-			avg_px.getValue(),
-			order_qty.getValue(),
-			last_qty.getValue(),
-			last_px.getValue(),
-			cum_qty.getValue(),
-			leaves_qty.getValue(),
-			text.getString()
-		);
+		fields.assign(decoded_exec_report);
 
-		order_tracker.process(report); // we update a local tracker too, which is actually not needed
+		order_tracker.process(decoded_exec_report); // we update a local tracker too, which is actually not needed
 
-		exec_report_queue.push(report);
+		exec_report_queue.push(decoded_exec_report);
 	}
 	
 	void Application::onMessage(const FIX44::OrderCancelReject&, const FIX::SessionID&) 
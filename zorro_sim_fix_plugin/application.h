@@ -23,6 +23,7 @@
 #include "common/market_data.h"
 #include "common/order_tracker.h"
 #include "common/book.h"
+#include "common/exec_report_decoder.h"
 
 namespace zorro
 {
@@ -89,6 +90,8 @@ namespace zorro
 		IDGenerator id_generator;
 		std::unordered_map<std::string, Book> books;
 		OrderTracker order_tracker;
+		fix::ExecReportDecoder exec_report_decoder;
+		ExecReport decoded_exec_report;
 
 		// should not be used anymore, use the top_of_book_queue
 		bool has_book(const std::string& symbol);
@@ -10,6 +10,7 @@
 #include "common/exec_report.h"
 #include "common/blocking_queue.h"
 #include "common/json.h"
+#include "common/columnar.h"
 #include "common/time_utils.h"
 
 #include "zorro_common/log.h"
@@ -38,6 +39,7 @@ namespace zorro {
 	std::string rest_host = "http://localhost";
 	int rest_port = 8080;
 	httplib::Client rest_client(std::format("{}:{}", rest_host, rest_port));
+	httplib::Headers rest_accept_columnar = { { "Accept", std::format("{}, application/json", common::columnar::content_type) } };
 
 	int max_snaphsot_waiting_iterations = 10; 
 	std::chrono::milliseconds fix_exec_report_waiting_time = 500ms;
@@ -61,7 +63,7 @@ namespace zorro {
 
 	std::shared_ptr<spdlog::logger> spd_logger = nullptr;
 	std::unique_ptr<FixThread> fix_thread = nullptr;
-	BlockingTimeoutQueue<ExecReport> exec_report_queue;
+	BlockingTimeoutQueue<ExecReport> exec_report_queue(WaitStrategy::spin_then_park); // BrokerBuy2 waits for the reply
 	BlockingTimeoutQueue<TopOfBook> top_of_book_queue;  
 	std::unordered_map<int, std::string> order_id_by_internal_order_id;
 	std::unordered_map<std::string, TopOfBook> top_of_books;
@@ -124,10 +126,15 @@ namespace zorro {
 		auto from_str = zorro_date_to_string(from);
 		auto to_str = zorro_date_to_string(to);
 		auto request = std::format("/bars?symbol={}&from={}&to={}", Asset, from_str, to_str);
-		auto res = rest_client.Get(request);
+		auto res = rest_client.Get(request, rest_accept_columnar);
 		if (res->status == httplib::StatusCode::OK_200) {
-			auto j = json::parse(res->body);
-			from_json(j, bars);
+			if (common::columnar::is_columnar(res->get_header_value("Content-Type"))) {
+				from_columnar(res->body, bars);
+			}
+			else {
+				auto j = json::parse(res->body);
+				from_json(j, bars);
+			}
 
 			log::debug<4, true>(
 				"get_historical_bars: Asset={} from={} to={} num bars={}",
@@ -453,7 +460,7 @@ namespace zorro {
 			symbol, cl_ord_id, side, ord_type, time_in_force, qty, limit_price, stop_price
 		);
 
-		log::debug<2, true>("BrokerBuy2: NewOrderSingle {}", fix_string(msg));
+		log::debug<2, true>("BrokerBuy2: NewOrderSingle {}", log::lazy([&]() { return fix_string(msg); }));
 
 		ExecReport report;
 		bool success = exec_report_queue.pop(report, fix_exec_report_waiting_time);
@@ -538,7 +545,7 @@ namespace zorro {
 					*open = oit->second.avg_px;
 				}
 				if (profit) {
-					auto pit = top_of_books.find(oit->second.symbol);
+					auto pit = top_of_books.find(oit->second.get_symbol());
 					if (pit != top_of_books.end()) {
 						*profit = oit->second.side == FIX::Side_BUY 
 							? (pit->second.ask_price - oit->second.avg_px) * oit->second.cum_qty
@@ -604,7 +611,7 @@ namespace zorro {
 
 					log::debug<2, true>("BrokerSell2: closing filled order with trade in opposite direction signed_qty={}, limit={}", signed_qty, limit);
 
-					auto asset = const_cast<char*>(order.symbol.c_str());
+					auto asset = const_cast<char*>(order.get_symbol().c_str());
 					auto trade_id_close = BrokerBuy2(asset, signed_qty, 0, limit, &close_price, &close_fill);
 
 					if (trade_id_close) {
@@ -633,7 +640,7 @@ namespace zorro {
 
 				// if order is still working perform a cancel/replace here the amount should be always <= order_qty
 				if (order.ord_status == FIX::OrdStatus_PENDING_NEW || order.ord_status == FIX::OrdStatus_NEW || order.ord_status == FIX::OrdStatus_PARTIALLY_FILLED) {
-					auto symbol = FIX::Symbol(order.symbol);
+					auto symbol = FIX::Symbol(order.get_symbol());
 					auto ord_id = FIX::OrderID(order.ord_id);
 					auto orig_cl_ord_id = FIX::OrigClOrdID(order.cl_ord_id);
 					auto cl_ord_id = FIX::ClOrdID(next_client_order_id());
@@ -789,7 +796,7 @@ namespace zorro {
 							return 0;
 						}
 
-						auto symbol = FIX::Symbol(order.symbol);
+						auto symbol = FIX::Symbol(order.get_symbol());
 						auto ord_id = FIX::OrderID(order.ord_id);
 						auto orig_cl_ord_id = FIX::OrigClOrdID(order.cl_ord_id);
 						auto cl_ord_id = FIX::ClOrdID(next_client_order_id());